@@ -24,14 +24,68 @@
  */
 
 #include "ProcHandle.hpp"
+#include "XferTuning.hpp"
 #include "Context.hpp"
 #include "CommandImpl.hpp"
 #include "log.h"
 #include "veo_urpc.h"
+#include "veo_hmem_macros.h"
+#include <algorithm>
+#include <memory>
 #include <sys/types.h>
 #include <unistd.h>
 
+// stripes smaller than this are not worth an extra channel
+#define XFER_STRIPE_MIN (4 * 1024 * 1024)
+
+// VE DMA needs 4 byte aligned addresses and sizes
+#define VE_DMA_ALIGNED(a, b, size) ((((a) | (b) | (size)) & 3) == 0)
+
 namespace veo {
+namespace {
+/**
+ * @brief copy rows between a strided block and a packed buffer
+ *
+ * @param blk start of the strided block
+ * @param l layout of the block
+ * @param width row width in byte
+ * @param r0 first row to copy
+ * @param nrows number of rows to copy
+ * @param packed packed buffer
+ * @param to_blk true: copy from packed to blk, false: from blk to packed
+ */
+void copyRows(char *blk, const StridedLayout &l, size_t width, size_t r0,
+              size_t nrows, char *packed, bool to_blk)
+{
+  for (size_t i = 0; i < nrows; i++) {
+    char *b = blk + l.rowOffset(r0 + i);
+    if (to_blk)
+      memcpy(b, packed + i * width, width);
+    else
+      memcpy(packed + i * width, b, width);
+  }
+}
+
+/**
+ * @brief report a completed fragment of a transfer
+ *
+ * Fragments of a chain complete in order, thus the first done bytes
+ * of the buffer are transferred.
+ *
+ * @param p progress record of the transfer
+ * @param done bytes done, including the fragment
+ * @param total size of the transfer
+ */
+void reportXferProgress(veo_xfer_progress *p, size_t done, size_t total)
+{
+  uint64_t prev = __atomic_exchange_n(&p->done, done, __ATOMIC_RELEASE);
+  if (p->cb == nullptr)
+    return;
+  if (p->step == 0 || done == total || done / p->step > prev / p->step)
+    p->cb(p->arg, done, total);
+}
+} // namespace
+
 /**
  * @brief Asynchronous SENDBUFF call
  *
@@ -40,10 +94,14 @@ namespace veo {
  * @param size size of transfer
  * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
  *             if there is no previous req this one depends on
+ * @param prog progress record of the whole transfer, or nullptr
+ * @param done bytes of the whole transfer done with this request
+ * @param total size of the whole transfer
  * @return request ID
  */
 uint64_t
-Context::sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev)
+Context::sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev,
+                       veo_xfer_progress *prog, size_t done, size_t total)
 {
   VEO_TRACE("enter...");
   if (!this->is_alive())
@@ -76,7 +134,8 @@ Context::sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev)
   //
   // result function, called when response has arrived from URPC
   //
-  auto u = [this, id, prev] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
+  auto u = [this, id, prev, prog, done, total] (Command *cmd, urpc_mb_t *m,
+                                                void *payload, size_t plen)
            {
              //VEO_TRACE("[request #%d] reply ACK (cmd=%d)...", id, m->c.cmd);
              uint64_t result = 0;
@@ -94,6 +153,8 @@ Context::sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev)
                cmd->setResult(-URPC_CMD_SENDBUFF, VEO_COMMAND_EXCEPTION);
                return (int)-URPC_CMD_SENDBUFF;
              }
+             if (prog != nullptr && status == VEO_COMMAND_OK)
+               reportXferProgress(prog, done, total);
              cmd->setResult(result, status);
              return 0;
            };
@@ -115,10 +176,14 @@ Context::sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev)
  * @param size size of transfer
  * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
  *             if there is no previous req this one depends on
+ * @param prog progress record of the whole transfer, or nullptr
+ * @param done bytes of the whole transfer done with this request
+ * @param total size of the whole transfer
  * @return request ID
  */
 uint64_t
-Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev)
+Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev,
+                       veo_xfer_progress *prog, size_t done, size_t total)
 {
   VEO_TRACE("recvbuffAsync enter...");
   if (!this->is_alive())
@@ -151,8 +216,8 @@ Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev)
   //
   // result function, called when response has arrived from URPC
   //
-  auto u = [this, src, dst, size, id, prev] (Command *cmd, urpc_mb_t *m,
-                                             void *payload, size_t plen)
+  auto u = [this, src, dst, size, id, prev, prog, done, total]
+           (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
            {
              //VEO_DEBUG("[request #%d] reply received (cmd=%d)...", id, m->c.cmd);
              uint64_t sent_dst;
@@ -172,7 +237,179 @@ Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev)
                cmd->setResult(-URPC_CMD_RECVBUFF, VEO_COMMAND_EXCEPTION);
                return -1;
              }
-             memcpy((void *)dst, buff, buffsz);
+             // called after the copy, the data is in place
+             auto finish = [this, prev, prog, done, total] (Command *cmd)
+                           {
+                             uint64_t result = 0;
+                             int status = VEO_COMMAND_OK;
+                             if (prev != VEO_REQUEST_ID_INVALID) {
+                               auto rc = this->_peekResult(prev, &result);
+                               if (rc != VEO_COMMAND_OK) {
+                                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                                           prev, rc);
+                                 // TODO: handle this
+                                 status = rc;
+                               }
+                             }
+                             if (prog != nullptr && status == VEO_COMMAND_OK)
+                               reportXferProgress(prog, done, total);
+                             cmd->setResult(result, status);
+                           };
+             // large copies are done by the copy workers, if enabled
+             if (this->deferCopy(dst, buff, buffsz, finish))
+               return VEO_REPLY_DEFERRED;
+             this->proc->copyPool()->copyInline((void *)dst, buff, buffsz);
+             finish(cmd);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  return id;
+}
+
+/**
+ * @brief Asynchronous DMA_SENDBUFF / DMA_RECVBUFF call
+ *
+ * The VE moves the data with VE DMA between VE memory and a VH
+ * buffer registered by ProcHandle::registerHostMem(). No data is
+ * carried in the URPC payload.
+ *
+ * @param urpc_cmd URPC_CMD_DMA_SENDBUFF (VH to VE) or URPC_CMD_DMA_RECVBUFF
+ * @param veaddr VE address
+ * @param vehva VEHVA of the registered VH buffer
+ * @param size size of transfer
+ * @return request ID
+ */
+uint64_t
+Context::dmaBuffAsync(int urpc_cmd, uint64_t veaddr, uint64_t vehva, size_t size)
+{
+  VEO_TRACE("enter...");
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, urpc_cmd, veaddr, vehva, size, id] (Command *cmd)
+           {
+             VEO_TRACE("dmaBuffAsync [request #%d] start...", id);
+             int req = urpc_generic_send(this->up, urpc_cmd, (char *)"LLL",
+                                         veaddr, vehva, size);
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [this, urpc_cmd, id] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
+           {
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-urpc_cmd, VEO_COMMAND_EXCEPTION);
+               return -urpc_cmd;
+             }
+             int64_t rc = 0;
+             urpc_unpack_payload(payload, plen, (char *)"L", &rc);
+             if (rc != 0) {
+               VEO_ERROR("[request #%d] VE DMA failed, rc=%ld", id, rc);
+               cmd->setResult(rc, VEO_COMMAND_ERROR);
+               return 0;
+             }
+             cmd->setResult(0, VEO_COMMAND_OK);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief Asynchronous SENDSTRIDED call
+ *
+ * Rows r0 .. r0 + nrows - 1 of the source block are packed into the
+ * URPC payload when the request is issued, the VE scatters them into
+ * the destination block.
+ *
+ * @param dst VE address of the destination block
+ * @param dl layout of the destination block
+ * @param src VH address of the source block
+ * @param sl layout of the source block
+ * @param width row width in byte
+ * @param r0 first row
+ * @param nrows number of rows, nrows * width must fit into one URPC transfer
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
+ * @return request ID
+ */
+uint64_t
+Context::sendStridedAsync(uint64_t dst, const StridedLayout &dl,
+                          const char *src, const StridedLayout &sl,
+                          size_t width, size_t r0, size_t nrows, uint64_t prev)
+{
+  VEO_TRACE("enter...");
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, dst, dl, src, sl, width, r0, nrows, id] (Command *cmd)
+           {
+             VEO_TRACE("sendStridedAsync [request #%d] start...", id);
+             bool packed;
+             char *buf = this->stageBuffer(id, width * nrows, packed);
+             if (buf == nullptr) {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               return -1;
+             }
+             if (!packed)
+               copyRows((char *)src, sl, width, r0, nrows, buf, false);
+             int req = urpc_generic_send(this->up, URPC_CMD_SENDSTRIDED,
+                                         (char *)"LLLLLLP", dst, dl.pitch,
+                                         dl.slice, dl.height, width, r0,
+                                         (void *)buf, width * nrows);
+             if (req >= 0) {
+               this->stageDone();
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [this, id, prev] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
+           {
              uint64_t result = 0;
              int status = VEO_COMMAND_OK;
              if (prev != VEO_REQUEST_ID_INVALID) {
@@ -180,10 +417,13 @@ Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev)
                if (rc != VEO_COMMAND_OK) {
                  VEO_ERROR("request #%ld in chain has unexpected status %d",
                            prev, rc);
-                 // TODO: handle this
                  status = rc;
                }
              }
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_SENDSTRIDED, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_SENDSTRIDED;
+             }
              cmd->setResult(result, status);
              return 0;
            };
@@ -198,95 +438,360 @@ Context::recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev)
 }
 
 /**
- * @brief asynchronously read data from VE memory
+ * @brief Asynchronous RECVSTRIDED call
  *
- * @param[out] dst buffer to store data
- * @param src VEMVA to read
- * @param size size to transfer in byte
- * @param sub This function is called as a sub-part of a request
+ * The VE packs rows r0 .. r0 + nrows - 1 of the source block into its
+ * reply, they are scattered into the destination block on arrival.
+ *
+ * @param dst VH address of the destination block
+ * @param dl layout of the destination block
+ * @param src VE address of the source block
+ * @param sl layout of the source block
+ * @param width row width in byte
+ * @param r0 first row
+ * @param nrows number of rows, nrows * width must fit into one URPC transfer
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
  * @return request ID
  */
-uint64_t Context::asyncReadMem(void *dst, uint64_t src, size_t size)
+uint64_t
+Context::recvStridedAsync(char *dst, const StridedLayout &dl,
+                          uint64_t src, const StridedLayout &sl,
+                          size_t width, size_t r0, size_t nrows, uint64_t prev)
 {
-  VEO_TRACE("asyncReadMem enter...");
-  if(!this->is_alive())
+  VEO_TRACE("enter...");
+  if (!this->is_alive())
     return VEO_REQUEST_ID_INVALID;
 
-  if (size == 0) {
-    auto id = this->issueRequestID();
-    auto f = [id] (Command *cmd)
-             {
-               VEO_TRACE("[request #%d] start...", id);
-               cmd->setResult(0, VEO_COMMAND_OK);
-               return 0;
-             };
-    CmdPtr req(new internal::CommandImpl(id, f));
-    {
-      std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
-      if(this->comq.pushRequest(std::move(req)))
-        return VEO_REQUEST_ID_INVALID;
-    }
-    this->comq.notifyAll();
-    VEO_TRACE("asyncWriteMem leave...\n");
-    return id;
-  }
-
-  const char* env_p = std::getenv("VEO_RECVFRAG");
-  const char* cut_p = std::getenv("VEO_RECVCUT");
-  size_t maxfrag = PART_SENDFRAG;
-  size_t cutsz = 2 * 1024 * 1024;
+  auto id = this->issueRequestID();
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, dst, src, sl, width, r0, nrows, id] (Command *cmd)
+           {
+             VEO_TRACE("recvStridedAsync [request #%d] start...", id);
+             int req = urpc_generic_send(this->up, URPC_CMD_RECVSTRIDED,
+                                         (char *)"LLLLLLLL", src, sl.pitch,
+                                         sl.slice, sl.height, width, r0,
+                                         nrows, (uint64_t)dst);
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
 
-  if (urpc_max_send_cmd_size(this->up) < 2 * maxfrag)
-    maxfrag = 1 * 1024 * 1024;
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [this, dst, dl, width, r0, nrows, id, prev] (Command *cmd,
+                                                      urpc_mb_t *m,
+                                                      void *payload, size_t plen)
+           {
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_RECVSTRIDED, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_RECVSTRIDED;
+             }
+             if (m->c.cmd != URPC_CMD_SENDBUFF) {
+               int64_t rc = 0;
+               urpc_unpack_payload(payload, plen, (char *)"L", &rc);
+               VEO_ERROR("[request #%d] VE failed to pack rows, rc=%ld", id, rc);
+               cmd->setResult(rc, VEO_COMMAND_ERROR);
+               return 0;
+             }
+             uint64_t sent_dst;
+             void *buff;
+             size_t buffsz;
 
-  if (env_p)
-    maxfrag = atoi(env_p);
-  if (cut_p)
-    cutsz = atoi(cut_p);
-  if (size < 5 * maxfrag)
-    if (size > cutsz)
-      maxfrag = ALIGN8B(size / 5);
-    else if (size > cutsz / 2)
-      maxfrag = ALIGN8B(size / 4);
-    else if (size > cutsz / 3)
-      maxfrag = ALIGN8B(size / 2);
-    else
-      maxfrag = ALIGN8B(size);
+             urpc_unpack_payload(payload, plen, (char *)"LP", &sent_dst, &buff, &buffsz);
+             if ((uint64_t)dst != sent_dst || buffsz != width * nrows) {
+               VEO_ERROR("mismatch: dst=%lx sent_dst=%lx size=%lu sent_size=%lu",
+                         (uint64_t)dst, sent_dst, width * nrows, buffsz);
+               cmd->setResult(-URPC_CMD_RECVSTRIDED, VEO_COMMAND_EXCEPTION);
+               return -1;
+             }
+             copyRows(dst, dl, width, r0, nrows, (char *)buff, true);
+             uint64_t result = 0;
+             int status = VEO_COMMAND_OK;
+             if (prev != VEO_REQUEST_ID_INVALID) {
+               auto rc = this->_peekResult(prev, &result);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                           prev, rc);
+                 status = rc;
+               }
+             }
+             cmd->setResult(result, status);
+             return 0;
+           };
 
-  size_t psz;
-  size_t rsize = size;
-  char *s = (char *)src;
-  char *d = (char *)dst;
-  uint64_t prev = VEO_REQUEST_ID_INVALID;
-  bool flg = false;
-  while (rsize > 0) {
-    psz = rsize <= maxfrag ? rsize : maxfrag;
-    auto req = recvBuffAsync((void *)d, (uint64_t)s, psz, prev);
-    if (req == VEO_REQUEST_ID_INVALID) {
-      VEO_ERROR("req chain submission failed! Aborting.");
-      // TODO: abort chain? How?
-      return req;
-    }
-    prev = req;
-    rsize -= psz;
-    s += psz;
-    d += psz;
-    if (flg == false) {
-      this->progress();
-      flg = true;
-    }
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
   }
-  this->comq.notifyAll();
-  return prev;
+  return id;
 }
 
 /**
- * @brief asynchronously write data to VE memory
+ * @brief Asynchronous SENDV call
  *
- * @param dst VEMVA destination address
- * @param src VH buffer source address
- * @param size size to transfer in byte
- * @param sub This function is called as a sub-part of a request
+ * The descriptors and the data of all buffers are packed into one
+ * URPC payload when the request is issued.
+ *
+ * @param iov buffers, header and data must fit into one URPC transfer
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
+ * @return request ID
+ */
+uint64_t Context::sendVAsync(std::vector<veo_iovec> &&iov, uint64_t prev)
+{
+  VEO_TRACE("enter...");
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  auto iovp = std::make_shared<std::vector<veo_iovec>>(std::move(iov));
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, iovp, id] (Command *cmd)
+           {
+             VEO_TRACE("sendVAsync [request #%d] start...", id);
+             auto &iov = *iovp;
+             size_t hdrsz = (1 + 2 * iov.size()) * sizeof(uint64_t);
+             size_t size = hdrsz;
+             for (auto &v : iov)
+               size += v.size;
+             bool packed;
+             char *buf = this->stageBuffer(id, size, packed);
+             if (buf == nullptr) {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               return -1;
+             }
+             if (!packed) {
+               uint64_t *hdr = (uint64_t *)buf;
+               char *data = buf + hdrsz;
+               hdr[0] = iov.size();
+               for (size_t i = 0; i < iov.size(); i++) {
+                 hdr[1 + 2 * i] = iov[i].veaddr;
+                 hdr[2 + 2 * i] = iov[i].size;
+                 memcpy(data, iov[i].vhaddr, iov[i].size);
+                 data += iov[i].size;
+               }
+             }
+             int req = urpc_generic_send(this->up, URPC_CMD_SENDV, (char *)"P",
+                                         (void *)buf, size);
+             if (req >= 0) {
+               this->stageDone();
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [this, id, prev] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
+           {
+             uint64_t result = 0;
+             int status = VEO_COMMAND_OK;
+             if (prev != VEO_REQUEST_ID_INVALID) {
+               auto rc = this->_peekResult(prev, &result);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                           prev, rc);
+                 status = rc;
+               }
+             }
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_SENDV, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_SENDV;
+             }
+             cmd->setResult(result, status);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  return id;
+}
+
+/**
+ * @brief Asynchronous RECVV call
+ *
+ * The VE packs the data of all buffers into its reply, it is copied
+ * to the VH buffers on arrival.
+ *
+ * @param iov buffers, the data must fit into one URPC transfer
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
+ * @return request ID
+ */
+uint64_t Context::recvVAsync(std::vector<veo_iovec> &&iov, uint64_t prev)
+{
+  VEO_TRACE("enter...");
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  auto iovp = std::make_shared<std::vector<veo_iovec>>(std::move(iov));
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, iovp, id] (Command *cmd)
+           {
+             VEO_TRACE("recvVAsync [request #%d] start...", id);
+             std::vector<uint64_t> hdr(1 + 2 * iovp->size());
+             hdr[0] = iovp->size();
+             for (size_t i = 0; i < iovp->size(); i++) {
+               hdr[1 + 2 * i] = (*iovp)[i].veaddr;
+               hdr[2 + 2 * i] = (*iovp)[i].size;
+             }
+             int req = urpc_generic_send(this->up, URPC_CMD_RECVV, (char *)"P",
+                                         (void *)hdr.data(),
+                                         hdr.size() * sizeof(uint64_t));
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [this, iovp, id, prev] (Command *cmd, urpc_mb_t *m,
+                                   void *payload, size_t plen)
+           {
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_RECVV, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_RECVV;
+             }
+             if (m->c.cmd != URPC_CMD_SENDBUFF) {
+               int64_t rc = 0;
+               urpc_unpack_payload(payload, plen, (char *)"L", &rc);
+               VEO_ERROR("[request #%d] VE failed to pack buffers, rc=%ld", id, rc);
+               cmd->setResult(rc, VEO_COMMAND_ERROR);
+               return 0;
+             }
+             uint64_t sent_size;
+             void *buff;
+             size_t buffsz;
+
+             urpc_unpack_payload(payload, plen, (char *)"LP", &sent_size, &buff, &buffsz);
+             size_t size = 0;
+             for (auto &v : *iovp)
+               size += v.size;
+             if (sent_size != size || buffsz != size) {
+               VEO_ERROR("mismatch: size=%lu sent_size=%lu", size, buffsz);
+               cmd->setResult(-URPC_CMD_RECVV, VEO_COMMAND_EXCEPTION);
+               return -1;
+             }
+             char *data = (char *)buff;
+             for (auto &v : *iovp) {
+               this->proc->copyPool()->copyInline(v.vhaddr, data, v.size);
+               data += v.size;
+             }
+             uint64_t result = 0;
+             int status = VEO_COMMAND_OK;
+             if (prev != VEO_REQUEST_ID_INVALID) {
+               auto rc = this->_peekResult(prev, &result);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                           prev, rc);
+                 status = rc;
+               }
+             }
+             cmd->setResult(result, status);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  return id;
+}
+
+/**
+ * @brief asynchronously read data from VE memory
+ *
+ * @param[out] dst buffer to store data
+ * @param src VEMVA to read
+ * @param size size to transfer in byte
+ * @param sub This function is called as a sub-part of a request
+ * @return request ID
+ */
+uint64_t Context::asyncReadMem(void *dst, uint64_t src, size_t size)
+{
+  VEO_TRACE("asyncReadMem enter...");
+  if(!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  if (size == 0) {
+    auto id = this->issueRequestID();
+    auto f = [id] (Command *cmd)
+             {
+               VEO_TRACE("[request #%d] start...", id);
+               cmd->setResult(0, VEO_COMMAND_OK);
+               return 0;
+             };
+    CmdPtr req(new internal::CommandImpl(id, f));
+    {
+      std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+      if(this->comq.pushRequest(std::move(req)))
+        return VEO_REQUEST_ID_INVALID;
+    }
+    this->comq.notifyAll();
+    VEO_TRACE("asyncWriteMem leave...\n");
+    return id;
+  }
+
+  uint64_t vehva;
+  if (VE_DMA_ALIGNED(src, (uint64_t)dst, size) &&
+      this->proc->findHostMem(dst, size, &vehva))
+    return this->dmaBuffAsync(URPC_CMD_DMA_RECVBUFF, src, vehva, size);
+
+  if (size >= 2 * XFER_STRIPE_MIN && this->proc->numXferChannels() > 1)
+    return this->asyncXferStriped(false, dst, src, size);
+
+  return this->asyncReadMemFrag(dst, src, size, this->recvFragSize(size));
+}
+
+/**
+ * @brief asynchronously write data to VE memory
+ *
+ * @param dst VEMVA destination address
+ * @param src VH buffer source address
+ * @param size size to transfer in byte
+ * @param sub This function is called as a sub-part of a request
  * @return request ID
  */
 uint64_t Context::asyncWriteMem(uint64_t dst, const void *src,
@@ -315,15 +820,228 @@ uint64_t Context::asyncWriteMem(uint64_t dst, const void *src,
     return id;
   }
 
+  uint64_t vehva;
+  if (VE_DMA_ALIGNED(dst, (uint64_t)src, size) &&
+      this->proc->findHostMem(src, size, &vehva))
+    return this->dmaBuffAsync(URPC_CMD_DMA_SENDBUFF, dst, vehva, size);
+
+  if (size >= 2 * XFER_STRIPE_MIN && this->proc->numXferChannels() > 1)
+    return this->asyncXferStriped(true, (void *)src, dst, size);
+
+  return this->asyncWriteMemFrag(dst, src, size, this->sendFragSize(size));
+}
+
+/**
+ * @brief asynchronously read VE memory, reporting partial progress
+ *
+ * The transfer always goes through a chain of RECVBUFF fragments on
+ * this context, so the fragments complete in order. The counter of
+ * prog is set to the number of leading bytes in place after each
+ * fragment, its callback is called from the progress thread.
+ *
+ * @param[out] dst buffer to store data
+ * @param src VEMVA to read
+ * @param size size to transfer in byte
+ * @param prog progress record, must stay valid until the request is done
+ * @return request ID
+ */
+uint64_t Context::asyncReadMemProgress(void *dst, uint64_t src, size_t size,
+                                       veo_xfer_progress *prog)
+{
+  if (prog == nullptr || size == 0)
+    return this->asyncReadMem(dst, src, size);
+  __atomic_store_n(&prog->done, 0, __ATOMIC_RELEASE);
+  return this->asyncReadMemFrag(dst, src, size, this->recvFragSize(size), prog);
+}
+
+/**
+ * @brief asynchronously write VE memory, reporting partial progress
+ *
+ * Like asyncReadMemProgress(), the counter of prog tells how many
+ * leading bytes of the destination were written.
+ *
+ * @param dst VEMVA destination address
+ * @param src VH buffer source address
+ * @param size size to transfer in byte
+ * @param prog progress record, must stay valid until the request is done
+ * @return request ID
+ */
+uint64_t Context::asyncWriteMemProgress(uint64_t dst, const void *src,
+                                        size_t size, veo_xfer_progress *prog)
+{
+  if (prog == nullptr || size == 0)
+    return this->asyncWriteMem(dst, src, size);
+  __atomic_store_n(&prog->done, 0, __ATOMIC_RELEASE);
+  return this->asyncWriteMemFrag(dst, src, size, this->sendFragSize(size), prog);
+}
+
+/**
+ * @brief asynchronously transfer memory striped over transfer channels
+ *
+ * The transfer is cut into page aligned stripes. The first stripe is
+ * transferred by this context, the others by the hidden transfer
+ * contexts of the proc, each with its own VE-URPC channel, progress
+ * thread and VE handler thread. Three requests are queued in this
+ * context: a launcher which submits the stripes to the transfer
+ * contexts once all earlier requests of this context are done, the
+ * first stripe and a collector whose request ID is returned. The
+ * collector completes when all stripes are done, thus the ordering
+ * of requests in this context is preserved.
+ *
+ * @param write true for VH to VE, false for VE to VH
+ * @param vh VH buffer address
+ * @param ve VEMVA
+ * @param size size to transfer in byte
+ * @return request ID
+ */
+uint64_t Context::asyncXferStriped(bool write, void *vh, uint64_t ve,
+                                   size_t size)
+{
+  VEO_TRACE("write=%d vh=%p ve=%lx size=%lu", write, vh, ve, size);
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto chans = this->proc->xferContexts();
+  size_t n = std::min(chans.size() + 1, size / XFER_STRIPE_MIN);
+  if (n <= 1)
+    return write ? this->asyncWriteMemFrag(ve, vh, size, this->sendFragSize(size))
+                 : this->asyncReadMemFrag(vh, ve, size, this->recvFragSize(size));
+  size_t stripe = ((size + n - 1) / n + 4095) & ~4095UL;
+  using StripeReq = std::pair<std::shared_ptr<Context>, uint64_t>;
+  auto stripes = std::make_shared<std::vector<StripeReq>>();
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  //
+  // launcher: runs when all previous requests of this context are done
+  //
+  auto lid = this->issueRequestID();
+  auto l = [write, vh, ve, size, stripe, chans, stripes, lid] (Command *cmd)
+           {
+             VEO_TRACE("[request #%lu] launching stripes", lid);
+             size_t off = stripe;
+             for (auto &c : chans) {
+               if (off >= size)
+                 break;
+               size_t len = std::min(stripe, size - off);
+               uint64_t r = write
+                 ? c->asyncWriteMemFrag(ve + off, (char *)vh + off, len,
+                                        c->sendFragSize(len))
+                 : c->asyncReadMemFrag((char *)vh + off, ve + off, len,
+                                       c->recvFragSize(len));
+               stripes->push_back(std::make_pair(c, r));
+               off += stripe;
+             }
+             cmd->setResult(0, VEO_COMMAND_OK);
+             return 0;
+           };
+  CmdPtr lreq(new internal::CommandImpl(lid, l));
+  if (this->comq.pushRequest(std::move(lreq)))
+    return VEO_REQUEST_ID_INVALID;
+
+  uint64_t own = write
+    ? this->asyncWriteMemFrag(ve, vh, stripe, this->sendFragSize(stripe))
+    : this->asyncReadMemFrag(vh, ve, stripe, this->recvFragSize(stripe));
+
+  //
+  // collector: waits for the stripes of the transfer contexts
+  //
+  auto id = this->issueRequestID();
+  auto f = [this, lid, own, stripes, id] (Command *cmd)
+           {
+             VEO_TRACE("[request #%lu] collecting %lu stripes", id,
+                       stripes->size() + 1);
+             uint64_t dummy;
+             int status = this->_peekResult(lid, &dummy);
+             if (own == VEO_REQUEST_ID_INVALID)
+               status = VEO_COMMAND_ERROR;
+             else if (this->_peekResult(own, &dummy) != VEO_COMMAND_OK)
+               status = VEO_COMMAND_ERROR;
+             for (auto &r : *stripes) {
+               int rc = VEO_COMMAND_ERROR;
+               if (r.second != VEO_REQUEST_ID_INVALID)
+                 rc = r.first->callWaitResult(r.second, &dummy);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("[request #%lu] stripe failed with status %d", id, rc);
+                 status = VEO_COMMAND_ERROR;
+               }
+             }
+             cmd->setResult(0, status);
+             return 0;
+           };
+  CmdPtr req(new internal::CommandImpl(id, f));
+  if (this->comq.pushRequest(std::move(req)))
+    return VEO_REQUEST_ID_INVALID;
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief fragment size for reading from VE memory
+ *
+ * VEO_RECVFRAG / VEO_RECVCUT take precedence, then the calibrated
+ * table of the proc (if any), then the built-in heuristics.
+ *
+ * @param size size of the whole transfer
+ * @return maximum size of one RECVBUFF request
+ */
+size_t Context::recvFragSize(size_t size)
+{
+  const char* env_p = std::getenv("VEO_RECVFRAG");
+  const char* cut_p = std::getenv("VEO_RECVCUT");
+  size_t maxfrag = PART_SENDFRAG;
+  size_t cutsz = 2 * 1024 * 1024;
+
+  if (env_p == nullptr && cut_p == nullptr) {
+    size_t frag = this->proc->xferTuning()->fragSize(XferTuning::XFER_RECV, size);
+    if (frag)
+      return frag;
+  }
+
+  if (urpc_max_send_cmd_size(this->up) < 2 * maxfrag)
+    maxfrag = 1 * 1024 * 1024;
+
+  if (env_p)
+    maxfrag = atoi(env_p);
+  if (cut_p)
+    cutsz = atoi(cut_p);
+  if (size < 5 * maxfrag)
+    if (size > cutsz)
+      maxfrag = ALIGN8B(size / 5);
+    else if (size > cutsz / 2)
+      maxfrag = ALIGN8B(size / 4);
+    else if (size > cutsz / 3)
+      maxfrag = ALIGN8B(size / 2);
+    else
+      maxfrag = ALIGN8B(size);
+
+  return maxfrag;
+}
+
+/**
+ * @brief fragment size for writing to VE memory
+ *
+ * VEO_SENDFRAG / VEO_SENDCUT take precedence, then the calibrated
+ * table of the proc (if any), then the built-in heuristics.
+ *
+ * @param size size of the whole transfer
+ * @return maximum size of one SENDBUFF request
+ */
+size_t Context::sendFragSize(size_t size)
+{
   const char* env_p = std::getenv("VEO_SENDFRAG");
   const char* cut_p = std::getenv("VEO_SENDCUT");
   size_t maxfrag = PART_SENDFRAG;
   size_t cutsz = 2 * 1024 * 1024;
 
+  if (env_p == nullptr && cut_p == nullptr) {
+    size_t frag = this->proc->xferTuning()->fragSize(XferTuning::XFER_SEND, size);
+    if (frag)
+      return frag;
+  }
+
   if (urpc_max_send_cmd_size(this->up) < 2 * maxfrag)
     maxfrag = 1 * 1024 * 1024;
 
-  bool flg = false;
   if (env_p)
     maxfrag = atoi(env_p);
   if (cut_p)
@@ -338,7 +1056,65 @@ uint64_t Context::asyncWriteMem(uint64_t dst, const void *src,
     else
       maxfrag = ALIGN8B(size);
 
+  return maxfrag;
+}
+
+/**
+ * @brief asynchronously read VE memory as a chain of RECVBUFF requests
+ *
+ * @param[out] dst buffer to store data
+ * @param src VEMVA to read
+ * @param size size to transfer in byte
+ * @param maxfrag maximum size of one request
+ * @param prog progress record updated per fragment, or nullptr
+ * @return request ID of the last request in the chain
+ */
+uint64_t Context::asyncReadMemFrag(void *dst, uint64_t src, size_t size,
+                                   size_t maxfrag, veo_xfer_progress *prog)
+{
+  size_t psz;
+  size_t rsize = size;
+  char *s = (char *)src;
+  char *d = (char *)dst;
+  uint64_t prev = VEO_REQUEST_ID_INVALID;
+  bool flg = false;
+  while (rsize > 0) {
+    psz = rsize <= maxfrag ? rsize : maxfrag;
+    auto req = recvBuffAsync((void *)d, (uint64_t)s, psz, prev,
+                             prog, size - rsize + psz, size);
+    if (req == VEO_REQUEST_ID_INVALID) {
+      VEO_ERROR("req chain submission failed! Aborting.");
+      // TODO: abort chain? How?
+      return req;
+    }
+    prev = req;
+    rsize -= psz;
+    s += psz;
+    d += psz;
+    if (flg == false) {
+      this->progress();
+      flg = true;
+    }
+  }
+  this->comq.notifyAll();
+  return prev;
+}
+
+/**
+ * @brief asynchronously write VE memory as a chain of SENDBUFF requests
+ *
+ * @param dst VEMVA destination address
+ * @param src VH buffer source address
+ * @param size size to transfer in byte
+ * @param maxfrag maximum size of one request
+ * @param prog progress record updated per fragment, or nullptr
+ * @return request ID of the last request in the chain
+ */
+uint64_t Context::asyncWriteMemFrag(uint64_t dst, const void *src, size_t size,
+                                    size_t maxfrag, veo_xfer_progress *prog)
+{
   size_t psz;
+  bool flg = false;
   size_t rsize = size;
   char *s = (char *)src;
   uint64_t d = dst;
@@ -346,7 +1122,8 @@ uint64_t Context::asyncWriteMem(uint64_t dst, const void *src,
 
   while (rsize > 0) {
     psz = rsize <= maxfrag ? rsize : maxfrag;
-    auto req = this->sendBuffAsync(d, s, psz, prev);
+    auto req = this->sendBuffAsync(d, s, psz, prev,
+                                   prog, size - rsize + psz, size);
     if (req == VEO_REQUEST_ID_INVALID) {
       VEO_ERROR("req chain submission failed! Aborting.");
       // TODO: abort chain? How?
@@ -364,4 +1141,471 @@ uint64_t Context::asyncWriteMem(uint64_t dst, const void *src,
   this->comq.notifyAll();
   return prev;
 }
+
+/**
+ * @brief asynchronously write a strided 2D or 3D block to VE memory
+ *
+ * As many rows as fit into one fragment are packed into one
+ * SENDSTRIDED request, the requests are chained and the ID of the
+ * last one is returned. Rows wider than a fragment are sent as
+ * contiguous fragments, row by row.
+ *
+ * @param dst VE address of the destination block
+ * @param dl layout of the destination block
+ * @param src VH address of the source block
+ * @param sl layout of the source block
+ * @param width row width in byte
+ * @param nrows number of rows of the block, summed over all slices
+ * @return request ID
+ */
+uint64_t Context::asyncWriteMemStrided(uint64_t dst, const StridedLayout &dl,
+                                       const void *src, const StridedLayout &sl,
+                                       size_t width, size_t nrows)
+{
+  VEO_TRACE("dst=%lx src=%p width=%lu nrows=%lu", dst, src, width, nrows);
+  if (width == 0 || nrows == 0)
+    return this->asyncWriteMem(dst, src, 0);
+  if (dl.pitch < width || sl.pitch < width || dl.height == 0 || sl.height == 0) {
+    VEO_ERROR("invalid layout: width=%lu dpitch=%lu spitch=%lu", width,
+              dl.pitch, sl.pitch);
+    return VEO_REQUEST_ID_INVALID;
+  }
+  // contiguous blocks take the normal path
+  if (dl.pitch == width && sl.pitch == width &&
+      dl.slice == dl.height * width && sl.slice == sl.height * width)
+    return this->asyncWriteMem(dst, src, width * nrows);
+  size_t maxfrag = this->sendFragSize(width * nrows);
+  uint64_t prev = VEO_REQUEST_ID_INVALID;
+  bool flg = false;
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  if (width > maxfrag) {
+    for (size_t r = 0; r < nrows; r++) {
+      char *s = (char *)src + sl.rowOffset(r);
+      uint64_t d = dst + dl.rowOffset(r);
+      for (size_t off = 0; off < width; off += maxfrag) {
+        size_t psz = std::min(maxfrag, width - off);
+        prev = this->sendBuffAsync(d + off, s + off, psz, prev);
+        if (prev == VEO_REQUEST_ID_INVALID) {
+          VEO_ERROR("req chain submission failed! Aborting.");
+          return prev;
+        }
+      }
+      if (flg == false) {
+        this->progress();
+        flg = true;
+      }
+    }
+  } else {
+    size_t rows_per_frag = maxfrag / width;
+    for (size_t r = 0; r < nrows; r += rows_per_frag) {
+      size_t n = std::min(rows_per_frag, nrows - r);
+      prev = this->sendStridedAsync(dst, dl, (const char *)src, sl, width,
+                                    r, n, prev);
+      if (prev == VEO_REQUEST_ID_INVALID) {
+        VEO_ERROR("req chain submission failed! Aborting.");
+        return prev;
+      }
+      if (flg == false) {
+        this->progress();
+        flg = true;
+      }
+    }
+  }
+  this->comq.notifyAll();
+  return prev;
+}
+
+/**
+ * @brief asynchronously read a strided 2D or 3D block from VE memory
+ *
+ * Counterpart of asyncWriteMemStrided(), the VE packs the rows of
+ * each fragment into one reply.
+ *
+ * @param[out] dst VH address of the destination block
+ * @param dl layout of the destination block
+ * @param src VE address of the source block
+ * @param sl layout of the source block
+ * @param width row width in byte
+ * @param nrows number of rows of the block, summed over all slices
+ * @return request ID
+ */
+uint64_t Context::asyncReadMemStrided(void *dst, const StridedLayout &dl,
+                                      uint64_t src, const StridedLayout &sl,
+                                      size_t width, size_t nrows)
+{
+  VEO_TRACE("dst=%p src=%lx width=%lu nrows=%lu", dst, src, width, nrows);
+  if (width == 0 || nrows == 0)
+    return this->asyncReadMem(dst, src, 0);
+  if (dl.pitch < width || sl.pitch < width || dl.height == 0 || sl.height == 0) {
+    VEO_ERROR("invalid layout: width=%lu dpitch=%lu spitch=%lu", width,
+              dl.pitch, sl.pitch);
+    return VEO_REQUEST_ID_INVALID;
+  }
+  // contiguous blocks take the normal path
+  if (dl.pitch == width && sl.pitch == width &&
+      dl.slice == dl.height * width && sl.slice == sl.height * width)
+    return this->asyncReadMem(dst, src, width * nrows);
+  size_t maxfrag = this->recvFragSize(width * nrows);
+  uint64_t prev = VEO_REQUEST_ID_INVALID;
+  bool flg = false;
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  if (width > maxfrag) {
+    for (size_t r = 0; r < nrows; r++) {
+      char *d = (char *)dst + dl.rowOffset(r);
+      uint64_t s = src + sl.rowOffset(r);
+      for (size_t off = 0; off < width; off += maxfrag) {
+        size_t psz = std::min(maxfrag, width - off);
+        prev = this->recvBuffAsync(d + off, s + off, psz, prev);
+        if (prev == VEO_REQUEST_ID_INVALID) {
+          VEO_ERROR("req chain submission failed! Aborting.");
+          return prev;
+        }
+      }
+      if (flg == false) {
+        this->progress();
+        flg = true;
+      }
+    }
+  } else {
+    size_t rows_per_frag = maxfrag / width;
+    for (size_t r = 0; r < nrows; r += rows_per_frag) {
+      size_t n = std::min(rows_per_frag, nrows - r);
+      prev = this->recvStridedAsync((char *)dst, dl, src, sl, width, r, n, prev);
+      if (prev == VEO_REQUEST_ID_INVALID) {
+        VEO_ERROR("req chain submission failed! Aborting.");
+        return prev;
+      }
+      if (flg == false) {
+        this->progress();
+        flg = true;
+      }
+    }
+  }
+  this->comq.notifyAll();
+  return prev;
+}
+
+/**
+ * @brief asynchronously write several VH buffers to VE memory
+ *
+ * Buffers are collected into SENDV requests as long as descriptors
+ * and data fit into one fragment. Buffers too large for that are sent
+ * in contiguous fragments. All requests are chained, the ID of the
+ * last one is returned.
+ *
+ * @param iov buffers to write
+ * @param n number of buffers
+ * @return request ID
+ */
+uint64_t Context::asyncWriteV(const veo_iovec *iov, int n)
+{
+  VEO_TRACE("iov=%p n=%d", iov, n);
+  if (n < 0 || (n > 0 && iov == nullptr))
+    return VEO_REQUEST_ID_INVALID;
+  size_t total = 0;
+  for (int i = 0; i < n; i++)
+    total += iov[i].size;
+  if (total == 0)
+    return this->asyncWriteMem(0, nullptr, 0);
+
+  size_t maxfrag = this->sendFragSize(total);
+  uint64_t prev = VEO_REQUEST_ID_INVALID;
+  bool flg = false, ok = true;
+  std::vector<veo_iovec> grp;
+  size_t grpsz = sizeof(uint64_t);
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  auto flush = [&] () {
+    if (grp.empty())
+      return true;
+    prev = this->sendVAsync(std::move(grp), prev);
+    grp.clear();
+    grpsz = sizeof(uint64_t);
+    if (prev == VEO_REQUEST_ID_INVALID)
+      return false;
+    if (flg == false) {
+      this->progress();
+      flg = true;
+    }
+    return true;
+  };
+  for (int i = 0; i < n; i++) {
+    if (iov[i].size == 0)
+      continue;
+    size_t need = 2 * sizeof(uint64_t) + iov[i].size;
+    if (sizeof(uint64_t) + need > maxfrag) {
+      if (!(ok = flush()))
+        break;
+      char *s = (char *)iov[i].vhaddr;
+      for (size_t off = 0; off < iov[i].size; off += maxfrag) {
+        size_t psz = std::min(maxfrag, iov[i].size - off);
+        prev = this->sendBuffAsync(iov[i].veaddr + off, s + off, psz, prev);
+        if (prev == VEO_REQUEST_ID_INVALID)
+          break;
+      }
+      if (prev == VEO_REQUEST_ID_INVALID) {
+        ok = false;
+        break;
+      }
+      continue;
+    }
+    if (grpsz + need > maxfrag && !(ok = flush()))
+      break;
+    grp.push_back(iov[i]);
+    grpsz += need;
+  }
+  if (ok)
+    ok = flush();
+  if (!ok) {
+    VEO_ERROR("req chain submission failed! Aborting.");
+    return VEO_REQUEST_ID_INVALID;
+  }
+  this->comq.notifyAll();
+  return prev;
+}
+
+/**
+ * @brief asynchronously read VE memory into several VH buffers
+ *
+ * Counterpart of asyncWriteV(), the VE packs the data of the buffers
+ * of each RECVV request into one reply.
+ *
+ * @param iov buffers to read
+ * @param n number of buffers
+ * @return request ID
+ */
+uint64_t Context::asyncReadV(const veo_iovec *iov, int n)
+{
+  VEO_TRACE("iov=%p n=%d", iov, n);
+  if (n < 0 || (n > 0 && iov == nullptr))
+    return VEO_REQUEST_ID_INVALID;
+  size_t total = 0;
+  for (int i = 0; i < n; i++)
+    total += iov[i].size;
+  if (total == 0)
+    return this->asyncReadMem(nullptr, 0, 0);
+
+  size_t maxfrag = this->recvFragSize(total);
+  // the request carries the descriptors, limit their number too
+  size_t maxdesc = (maxfrag - sizeof(uint64_t)) / (2 * sizeof(uint64_t));
+  uint64_t prev = VEO_REQUEST_ID_INVALID;
+  bool flg = false, ok = true;
+  std::vector<veo_iovec> grp;
+  size_t grpsz = 0;
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  auto flush = [&] () {
+    if (grp.empty())
+      return true;
+    prev = this->recvVAsync(std::move(grp), prev);
+    grp.clear();
+    grpsz = 0;
+    if (prev == VEO_REQUEST_ID_INVALID)
+      return false;
+    if (flg == false) {
+      this->progress();
+      flg = true;
+    }
+    return true;
+  };
+  for (int i = 0; i < n; i++) {
+    if (iov[i].size == 0)
+      continue;
+    if (iov[i].size > maxfrag) {
+      if (!(ok = flush()))
+        break;
+      char *d = (char *)iov[i].vhaddr;
+      for (size_t off = 0; off < iov[i].size; off += maxfrag) {
+        size_t psz = std::min(maxfrag, iov[i].size - off);
+        prev = this->recvBuffAsync(d + off, iov[i].veaddr + off, psz, prev);
+        if (prev == VEO_REQUEST_ID_INVALID)
+          break;
+      }
+      if (prev == VEO_REQUEST_ID_INVALID) {
+        ok = false;
+        break;
+      }
+      continue;
+    }
+    if ((grpsz + iov[i].size > maxfrag || grp.size() == maxdesc) &&
+        !(ok = flush()))
+      break;
+    grp.push_back(iov[i]);
+    grpsz += iov[i].size;
+  }
+  if (ok)
+    ok = flush();
+  if (!ok) {
+    VEO_ERROR("req chain submission failed! Aborting.");
+    return VEO_REQUEST_ID_INVALID;
+  }
+  this->comq.notifyAll();
+  return prev;
+}
+
+/**
+ * @brief asynchronously fill VE memory with a pattern
+ *
+ * The VE stores the pattern itself, no data is transferred.
+ *
+ * @param dst VE address, aligned to the pattern size
+ * @param pattern pattern in the low psize bytes
+ * @param psize pattern size in byte: 1, 4 or 8
+ * @param count number of patterns to store
+ * @return request ID
+ */
+uint64_t Context::asyncFillMem(uint64_t dst, uint64_t pattern, size_t psize,
+                               size_t count)
+{
+  VEO_TRACE("dst=%lx pattern=%lx psize=%lu count=%lu", dst, pattern, psize, count);
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+  if ((psize != 1 && psize != 4 && psize != 8) || (dst & (psize - 1)) != 0) {
+    VEO_ERROR("invalid pattern size %lu or unaligned address %lx", psize, dst);
+    return VEO_REQUEST_ID_INVALID;
+  }
+
+  auto id = this->issueRequestID();
+  //
+  // submit function, called when cmd is issued to URPC
+  //
+  auto f = [this, dst, pattern, psize, count, id] (Command *cmd)
+           {
+             VEO_TRACE("asyncFillMem [request #%d] start...", id);
+             int req = urpc_generic_send(this->up, URPC_CMD_FILL, (char *)"LLLL",
+                                         dst, pattern, psize, count);
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+
+  //
+  // result function, called when response has arrived from URPC
+  //
+  auto u = [id] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
+           {
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_FILL, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_FILL;
+             }
+             int64_t rc = 0;
+             urpc_unpack_payload(payload, plen, (char *)"L", &rc);
+             if (rc != 0) {
+               VEO_ERROR("[request #%d] VE fill failed, rc=%ld", id, rc);
+               cmd->setResult(rc, VEO_COMMAND_ERROR);
+               return 0;
+             }
+             cmd->setResult(0, VEO_COMMAND_OK);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief asynchronously copy a batch of HMEM buffers
+ *
+ * The direction of each copy is decoded once. VH to VE copies are
+ * sent as one writev, VE to VE copies are done by the VE, VE to VH
+ * copies are read with one readv and VH to VH copies are done by the
+ * VH command collecting the results. The copies of a batch are not
+ * ordered against each other, the buffers must not overlap.
+ *
+ * @param d copies, VE memory must belong to the proc of this context
+ * @param n number of copies
+ * @return request ID
+ */
+uint64_t Context::asyncHmemcpy(const veo_hmemcpy_desc *d, int n)
+{
+  VEO_TRACE("d=%p n=%d", d, n);
+  if (n < 0 || (n > 0 && d == nullptr) || !this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  int ident = this->proc->getProcIdentifier();
+  std::vector<veo_iovec> in, out;
+  std::vector<veo_hmemcpy_desc> ve2ve;
+  auto vh2vh = std::make_shared<std::vector<veo_hmemcpy_desc>>();
+  for (int i = 0; i < n; i++) {
+    if (d[i].size == 0)
+      continue;
+    bool dve = IS_VE(d[i].dst) != 0, sve = IS_VE(d[i].src) != 0;
+    if ((dve && GET_PROC_IDENT(d[i].dst) != (uint64_t)ident) ||
+        (sve && GET_PROC_IDENT(d[i].src) != (uint64_t)ident)) {
+      VEO_ERROR("copy #%d: memory of another proc, use veo_hmemcpy()", i);
+      return VEO_REQUEST_ID_INVALID;
+    }
+    if (dve && sve) {
+      veo_hmemcpy_desc c = { (void *)VIRT_ADDR_VE(d[i].dst),
+                             (const void *)VIRT_ADDR_VE(d[i].src), d[i].size };
+      ve2ve.push_back(c);
+    } else if (dve) {
+      veo_iovec v = { (void *)d[i].src, VIRT_ADDR_VE(d[i].dst), d[i].size };
+      in.push_back(v);
+    } else if (sve) {
+      veo_iovec v = { d[i].dst, VIRT_ADDR_VE(d[i].src), d[i].size };
+      out.push_back(v);
+    } else {
+      vh2vh->push_back(d[i]);
+    }
+  }
+
+  std::vector<uint64_t> reqs;
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  if (!in.empty())
+    reqs.push_back(this->asyncWriteV(in.data(), in.size()));
+  for (auto &c : ve2ve)
+    reqs.push_back(this->genericAsyncReq(URPC_CMD_MEMCPY, (char *)"LLL",
+                                         (uint64_t)c.dst, (uint64_t)c.src,
+                                         (uint64_t)c.size));
+  if (!out.empty())
+    reqs.push_back(this->asyncReadV(out.data(), out.size()));
+  bool failed = std::find(reqs.begin(), reqs.end(),
+                          VEO_REQUEST_ID_INVALID) != reqs.end();
+  if (!failed && reqs.size() == 1 && vh2vh->empty())
+    return reqs[0];
+
+  auto id = this->issueRequestID();
+  auto f = [this, reqs, vh2vh, failed] (Command *cmd)
+           {
+             int status = failed ? VEO_COMMAND_ERROR : VEO_COMMAND_OK;
+             for (auto &c : *vh2vh)
+               memcpy(c.dst, c.src, c.size);
+             for (auto r : reqs) {
+               uint64_t dummy;
+               if (r == VEO_REQUEST_ID_INVALID)
+                 continue;
+               int rc = this->_peekResult(r, &dummy);
+               if (rc != VEO_COMMAND_OK && status == VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%lu of hmem batch failed, status %d", r, rc);
+                 status = rc;
+               }
+             }
+             cmd->setResult(0, status);
+             return 0;
+           };
+  CmdPtr req(new internal::CommandImpl(id, f));
+  if(this->comq.pushRequest(std::move(req)))
+    return VEO_REQUEST_ID_INVALID;
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
 } // namespace veo
@@ -23,10 +23,11 @@
  * Copyright (c) 2020-2021 Erich Focht
  */
 #include "CallArgs.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
-#include <numeric>
-#include <string>
+#include "ManagedMem.hpp"
 #include "log.h"
 
 namespace veo{
@@ -49,186 +50,65 @@ namespace internal {
  * -------------------
  * ******************* */
 
-template<typename T> void set_value(std::string &str, size_t offset, T value)
+/**
+ * @brief store a value into a slot
+ *
+ * Integers are sign or zero extended in the register, the stack image
+ * holds their sizeof(T) bytes padded with zeros.
+ */
+template<typename T> void set_value(ArgSlot &s, T val)
 {
-  // assume little endian
-  static_assert(std::is_fundamental<T>::value, "T must be fundamental");
-  union {
-    T value_;
-    char image_[sizeof(T)];
-  } data;
-  data.value_ = value;
-  // extend if necessary
-  if (str.size() < offset) {
-    str.resize(offset);
-  }
-  // put
-  str.replace(offset, sizeof(T), data.image_, sizeof(T));
-  // pad for 8 byte-aligned
-  if (sizeof(T) % 8 > 0) {
-    auto padsize = 8 - (sizeof(T) % 8);
-    str.replace(offset + sizeof(T), padsize, padsize, '\0');
-  }
-}
-
-template<typename T> class ArgType: public ArgBase {
-  static_assert(std::is_fundamental<T>::value, "not fundamental type.");
   static_assert(std::is_integral<T>::value, "integer types are supported");
-  T value_;
-public:
-  explicit ArgType(const T arg): value_(arg) {}
-
-  /**
-   * @brief a value on register
-   * @return a value to be set to on a register
-   */
-  int64_t getRegVal() const {
-    return static_cast<int64_t>(this->value_);
-  }
-
-  void setStackImage(uint64_t sp, std::string &stack, int n,
-                     bool &in, bool &out) {
-    VEO_TRACE("%s(%#lx, _, %d)", __func__, sp, n);
-    out = false;
-    in = false;
-    if (n < NUM_ARGS_ON_REGISTER)
-      return;// do nothing
-    in = true;
-    static_assert(std::is_fundamental<T>::value && sizeof(T) <= 8,
-      "template parameter T must be fundamental");
-    auto pos = PARAM_AREA_OFFSET + n * 8;
-    set_value(stack, pos, this->value_);
-  }
-
-  size_t sizeOnStack() const { return 0;}
-  std::function<void(void *)> copyoutFromStackImage(uint64_t sp){ return 0; } // nothing
-};
-
-template<> class ArgType<double>: public ArgBase {
-  union u {
-    double d_;
-    int64_t i64_;
-    u(double d): d_(d) {}
-  } u_;
-public:
-  explicit ArgType(const double d): u_(d) {}
-  int64_t getRegVal() const {
-    return this->u_.i64_;
-  }
-  void setStackImage(uint64_t sp, std::string &stack, int n,
-                     bool &in, bool &out) {
-    VEO_TRACE("%s(%#lx, _, %d)", __func__, sp, n);
-    out = false;
-    in = false;
-    if (n < NUM_ARGS_ON_REGISTER)
-      return;// do nothing
-    in = true;
-    auto pos = PARAM_AREA_OFFSET + n * 8;
-    set_value(stack, pos, this->u_.i64_);
-  }
-  size_t sizeOnStack() const { return 0;}
-  std::function<void(void *)> copyoutFromStackImage(uint64_t sp){ return 0; } // nothing
-};
-
-template<> class ArgType<float>: public ArgBase {
-  union u {
-    float f_[2];
-    int64_t i64_;
-    u(float f): f_{0.0, f} {}
-  } u_;
-public:
-  explicit ArgType(const float f): u_(f) {}
-  int64_t getRegVal() const {
-    return this->u_.i64_;
-  }
-  void setStackImage(uint64_t sp, std::string &stack, int n,
-                     bool &in, bool &out) {
-    VEO_TRACE("%s(%#lx, _, %d)", __func__, sp, n);
-    out = false;
-    in = false;
-    if (n < NUM_ARGS_ON_REGISTER)
-      return;// do nothing
-    in = true;
-    auto pos = PARAM_AREA_OFFSET + n * 8;
-    set_value(stack, pos, this->u_.i64_);
-  }
-
-  size_t sizeOnStack() const { return 0;}
-  std::function<void(void *)> copyoutFromStackImage(uint64_t sp){ return 0; } // nothing
-};
+  s.val = static_cast<uint64_t>(static_cast<int64_t>(val));
+  s.size = sizeof(T);
+}
 
-class ArgOnStack: public ArgBase {
-  char *buff_;
-  size_t len_;
-  bool in_;// copy in from VH memory to VE stack
-  bool out_;// copy out to VH memory from VE stack
-  uint64_t vemva_;
-public:
-  ArgOnStack(char *buff, size_t len, bool in, bool out): buff_(buff),
-    len_(len), in_(in), out_(out) {}
+void set_value(ArgSlot &s, double val)
+{
+  memcpy(&s.val, &val, sizeof(val));
+  s.size = 8;
+}
 
-  /**
-   * @brief a value on register
-   * @return a value to be set to on a register
-   */
-  int64_t getRegVal() const {
-    return this->vemva_;
-  }
+// a float is passed in the upper half of the register
+void set_value(ArgSlot &s, float val)
+{
+  uint32_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  s.val = (uint64_t)bits << 32;
+  s.size = 8;
+}
 
-  void setStackImage(uint64_t sp, std::string &stack, int n,
-                     bool &in, bool &out) {
-    VEO_TRACE("%s(%#lx, _, %d)", __func__, sp, n);
-    auto oldlen = stack.size();
-    this->vemva_ = sp + oldlen;
-    in = this->in_;
-    out = this->out_;
-    if (this->in_) {
-      stack.append(this->buff_, this->len_);
-    } else {
-      stack.append(this->len_, '\0');
-    }
-    // padding for 8 byte-aligned
-    if (this->len_ % 8 > 0) {
-      auto n_pad = 8 - (this->len_ % 8);
-      stack.append(n_pad, '\0');
-    }
-    // point the image
-    if (n >= NUM_ARGS_ON_REGISTER) {
-      set_value(stack, PARAM_AREA_OFFSET + 8 * n, this->vemva_);
-    }
-  }
+size_t size_on_stack(const ArgSlot &s)
+{
+  return s.kind == ArgSlot::STACK ? (s.len + 7) & ~(size_t)7 : 0;
+}
+} // namespace internal
 
-  size_t sizeOnStack() const {
-    size_t rv = this->len_;
-    if (this->len_ % 8 > 0) {
-      rv += 8 - (this->len_ % 8);
-    }
-    return rv;
-  }
-  std::function<void(void *)> copyoutFromStackImage(uint64_t stack_top) {
-    if (!this->out_) {
-      auto f = [](void *_dummy) -> void {};
-      return f;
-    }
-    auto buff = this->buff_;
-    auto len = this->len_;
-    auto vemva = this->vemva_;
-    VEO_TRACE("copyoutFromStackImage buff=%p len=%ld vemva=%lx stack_top=%lx", (void*)buff, len, vemva, stack_top);
-    auto f = [stack_top, buff, len, vemva](void *stack_payload) {
-               VEO_DEBUG("copy out to VH: offset %#lx -> %p, size = %d", vemva - stack_top, buff, len);
-               std::memcpy(buff, (void *)((uint64_t)stack_payload + vemva - stack_top), len);
-             };
-    return f;
+/**
+ * @brief slot of an argument, arguments up to it are added as needed
+ * @param argnum argument number
+ */
+internal::ArgSlot &CallArgs::extend_(int argnum) {
+  if (argnum < 0)
+    throw VEOException("CallArgs: negative argument number.", EINVAL);
+  if (argnum >= NUM_INLINE_ARGS &&
+      this->more_args.size() < (size_t)(argnum + 1 - NUM_INLINE_ARGS))
+    this->more_args.resize(argnum + 1 - NUM_INLINE_ARGS);
+  for (; this->nargs <= argnum; this->nargs++) {
+    auto &s = this->slot_(this->nargs);
+    s.kind = internal::ArgSlot::NONE;
+    s.val = 0;
+    s.size = 8;
   }
-};
-} // namespace internal
+  return this->slot_(argnum);
+}
 
 /**
  * @brief push, add at the last, an argument
  * @param val argument value
  */
 template <typename T> void CallArgs::push_(T val) {
-  this->arguments.push_back(std::unique_ptr<internal::ArgBase>(new internal::ArgType<T>(val)));
+  this->set_(this->nargs, val);
 }
 
 /**
@@ -237,11 +117,9 @@ template <typename T> void CallArgs::push_(T val) {
  * @param val argument value
  */
 template <typename T> void CallArgs::set_(int argnum, T val) {
-  if (this->arguments.size() < argnum + 1) {
-    //extend
-    this->arguments.resize(argnum + 1);
-  }
-  this->arguments[argnum] = std::unique_ptr<internal::ArgBase>(new internal::ArgType<T>(val));
+  auto &s = this->extend_(argnum);
+  s.kind = internal::ArgSlot::VALUE;
+  internal::set_value(s, val);
 }
 
 // force instantiation
@@ -266,76 +144,166 @@ template void CallArgs::set_<float>(int, float);
  */
 void CallArgs::setOnStack(enum veo_args_intent inout, int argnum,
                                char *buff, size_t len) {
-  bool copiedin = (inout == VEO_INTENT_IN || inout == VEO_INTENT_INOUT);
-  bool copiedout = (inout == VEO_INTENT_OUT || inout == VEO_INTENT_INOUT);
-  if (this->arguments.size() < argnum + 1) {
-    //extend
-    this->arguments.resize(argnum + 1);
-  }
-  this->arguments[argnum] = std::unique_ptr<internal::ArgBase>(new internal::ArgOnStack(buff, len, copiedin, copiedout));
+  auto &s = this->extend_(argnum);
+  s.kind = internal::ArgSlot::STACK;
+  s.val = 0;
+  s.size = 8;
+  s.buff = buff;
+  s.len = len;
+  s.in = (inout == VEO_INTENT_IN || inout == VEO_INTENT_INOUT);
+  s.out = (inout == VEO_INTENT_OUT || inout == VEO_INTENT_INOUT);
 }
 
 /**
- * @brief get a value on register
- * @param sp stack pointer
- * @return registar arguments
+ * @brief set an argument from its register image
+ * @param argnum argument number
+ * @param val register image
+ * @param size bytes of the value in the stack image, 1 to 8
  */
-std::vector<uint64_t> CallArgs::getRegVal() {
-  std::vector<uint64_t> rv;
-  int count = 0;
-  for (auto &arg: this->arguments) {
-    rv.push_back(arg->getRegVal());
-    if (++count >= NUM_ARGS_ON_REGISTER)
-      break;
+void CallArgs::setImage(int argnum, uint64_t val, size_t size) {
+  if (size == 0 || size > 8)
+    throw VEOException("CallArgs: invalid size of an argument value.", EINVAL);
+  auto &s = this->extend_(argnum);
+  s.kind = internal::ArgSlot::VALUE;
+  s.val = val;
+  s.size = size;
+}
+
+/**
+ * @brief set an argument to the VE address of a managed buffer
+ *
+ * The dirty pages of the buffer are uploaded before each call with
+ * these arguments, a range written by the VE function is read back
+ * after it. The reference keeps the buffer object, calls after the
+ * buffer was freed fail.
+ *
+ * @param argnum argument number
+ * @param m managed buffer
+ * @param off offset of the range written by the VE function
+ * @param len length of the range, 0 for none
+ */
+void CallArgs::setManaged(int argnum, std::shared_ptr<ManagedMem> m,
+                          size_t off, size_t len) {
+  if (off > m->bufSize() || len > m->bufSize() - off)
+    throw VEOException("CallArgs: range outside of the managed buffer.", EINVAL);
+  this->set_(argnum, m->veAddr());
+  for (auto &a: this->managed) {
+    if (a.argnum == argnum) {
+      a.mem = std::move(m);
+      a.off = off;
+      a.len = len;
+      return;
+    }
   }
-  return rv;
+  this->managed.push_back(internal::ManagedArg{argnum, std::move(m), off, len});
 }
 
 /**
- * @brief get the stack image
- * @param[in,out] sp reference to stack pointer
- * @return stack image
+ * @brief queue the upload of the managed buffer arguments
+ *
+ * @param ctx context the call is queued on after the uploads
+ * @param[out] ups queued writes are appended
+ * @return zero upon success; negative upon failure.
  */
-std::string CallArgs::getStackImage(uint64_t sp) {
-  VEO_TRACE("getStackImage(%#lx)", sp);
-  // allocate stack
-  size_t stack_size = PARAM_AREA_OFFSET + 8 * this->numArgs()
-    + std::accumulate(this->arguments.begin(), this->arguments.end(), 0,
-                      [](size_t s, decltype(this->arguments)::reference arg) {
-                        return s + arg->sizeOnStack();
-                      });
-  // 16 byte align
-  stack_size = ((stack_size + 15) / 16) * 16;
-  VEO_TRACE("stack size = %lu", stack_size);
-  this->stack_size = stack_size;
-  this->stack_top = sp - stack_size;
-  std::string stack(PARAM_AREA_OFFSET + 8 * this->numArgs(), '\0');
+int CallArgs::uploadManaged(Context *ctx, std::vector<ManagedMem::Upload> &ups) {
+  for (auto &a: this->managed) {
+    if (a.mem->queueUpload(ctx, ups) != 0) {
+      VEO_ERROR("failed to upload managed buffer argument %d", a.argnum);
+      return -1;
+    }
+  }
+  return 0;
+}
 
-  int n = 0;
-  this->copied_in = false;
-  this->copied_out = false;
-  for (const auto &arg: this->arguments) {
-    bool i, o;
-    arg->setStackImage(this->stack_top, stack, n++, i, o);
-    this->copied_in = this->copied_in || i;
-    this->copied_out = this->copied_out || o;
+/**
+ * @brief queue the read back of the ranges written by the VE function
+ *
+ * @param ctx context the call was queued on before the reads
+ * @param[out] downs queued reads are appended
+ * @return zero upon success; negative upon failure.
+ */
+int CallArgs::downloadManaged(Context *ctx, std::vector<ManagedMem::Download> &downs) {
+  for (auto &a: this->managed) {
+    if (a.len > 0 && a.mem->queueDownload(ctx, a.off, a.len, downs) != 0) {
+      VEO_ERROR("failed to read back managed buffer argument %d", a.argnum);
+      return -1;
+    }
   }
-  int grow = ((stack.size() + 15) / 16) * 16 - stack.size();
-  if (grow)
-    stack.append(grow, '\0');
-  return stack;
+  return 0;
 }
 
+/**
+ * @brief get the values on registers
+ * @return registar arguments
+ */
+CallRegs CallArgs::getRegVal() {
+  CallRegs rv;
+  rv.num = std::min(this->nargs, NUM_ARGS_ON_REGISTER);
+  for (int i = 0; i < rv.num; i++)
+    rv.val[i] = this->slot_(i).val;
+  return rv;
+}
+
+/**
+ * @brief lay out the stack and build the stack image
+ *
+ * Buffers on stack get their VEMVA. The image is allocated only if
+ * data has to be copied to or from the VE stack, its ownership passes
+ * to the call command.
+ *
+ * @param sp stack pointer
+ */
 void CallArgs::setup(uint64_t sp)
 {
   VEO_TRACE("setup CallArgs (sp = %#lx)...", sp);
-  auto img = this->getStackImage(sp);
-  VEO_ASSERT(this->stack_size == img.size());
-  auto buf = new char[this->stack_size];
-  memcpy(buf, img.c_str(), this->stack_size);
-  //this->stack_buf.reset(buf);
+  size_t hdr = PARAM_AREA_OFFSET + 8 * this->nargs;
+  size_t data = 0;
+  this->copied_in = false;
+  this->copied_out = false;
+  for (int i = 0; i < this->nargs; i++) {
+    auto &s = this->slot_(i);
+    if (s.kind == internal::ArgSlot::STACK) {
+      data += internal::size_on_stack(s);
+      this->copied_in = this->copied_in || s.in;
+      this->copied_out = this->copied_out || s.out;
+    } else if (i >= NUM_ARGS_ON_REGISTER) {
+      this->copied_in = true;
+    }
+  }
+  // 16 byte align
+  this->stack_size = ((hdr + data + 15) / 16) * 16;
+  this->stack_top = sp - this->stack_size;
+  VEO_TRACE("stack size = %lu", this->stack_size);
+
+  size_t off = hdr;
+  for (int i = 0; i < this->nargs; i++) {
+    auto &s = this->slot_(i);
+    if (s.kind == internal::ArgSlot::STACK) {
+      s.val = this->stack_top + off;
+      off += internal::size_on_stack(s);
+    }
+  }
+
   if (this->stack_buf != nullptr)
     deleteBuffer();
+  if (!(this->copied_in || this->copied_out))
+    return;
+  char *buf = new char[this->stack_size];
+  memset(buf, 0, hdr);
+  for (int i = 0; i < this->nargs; i++) {
+    auto &s = this->slot_(i);
+    if (s.kind == internal::ArgSlot::STACK) {
+      char *d = buf + (s.val - this->stack_top);
+      if (s.in)
+        memcpy(d, s.buff, s.len);
+      else
+        memset(d, 0, s.len);
+      memset(d + s.len, 0, internal::size_on_stack(s) - s.len);
+    }
+    if (i >= NUM_ARGS_ON_REGISTER)
+      memcpy(buf + PARAM_AREA_OFFSET + 8 * i, &s.val, s.size);
+  }
+  memset(buf + off, 0, this->stack_size - off);
   this->stack_buf = buf;
 }
 
@@ -344,24 +312,28 @@ void CallArgs::setup(uint64_t sp)
 // external: a newly allocated stack buffer
 std::function<void(void *)> CallArgs::copyout()
 {
-  if (this->copied_out) {
-    auto stack_size = this->stack_size;
-    auto stack_top = this->stack_top;
-    std::vector<std::function<void(void *)> > funcs;
-    for (auto &arg: this->arguments) {
-      if (typeid(*(arg.get())) == typeid(internal::ArgOnStack)) {
-        funcs.emplace_back(arg->copyoutFromStackImage(stack_top));
-      }
-    }
-    auto f = [funcs, stack_size](void *stack_payload) -> void {
-               for (auto &g: funcs) {
-                 g(stack_payload);
-               }
-             };
-    return f;
-  } else {
+  if (!this->copied_out) {
     auto f = [](void *_dummy) -> void {};
     return f;
   }
+  struct Out {
+    char *buff;
+    size_t len;
+    uint64_t offset;	// in the stack image
+  };
+  std::vector<Out> outs;
+  for (int i = 0; i < this->nargs; i++) {
+    auto &s = this->slot_(i);
+    if (s.kind == internal::ArgSlot::STACK && s.out)
+      outs.push_back(Out{s.buff, s.len, s.val - this->stack_top});
+  }
+  auto f = [outs](void *stack_payload) -> void {
+             for (auto &o: outs) {
+               VEO_DEBUG("copy out to VH: offset %#lx -> %p, size = %d",
+                         o.offset, (void *)o.buff, o.len);
+               std::memcpy(o.buff, (char *)stack_payload + o.offset, o.len);
+             }
+           };
+  return f;
 }
 } // namespace veo
@@ -26,31 +26,60 @@
  * 
  * Copyright (c) 2018-2021 NEC Corporation
  */
+#include <cstdint>
 #include <functional>
-#include <memory>
-#include <string>
+#include <utility>
 #include <vector>
 #include <type_traits>
 #include <initializer_list>
 #include "ve_offload.h"
 #include "VEOException.hpp"
+#include "ManagedMem.hpp"
 
 namespace veo {
+class Context;
 constexpr int NUM_ARGS_ON_REGISTER = 8;
 constexpr int PARAM_AREA_OFFSET = 176;
 namespace internal {
 /**
- * Base abstract class of an argument
+ * @brief one argument
+ *
+ * Values are kept as the 8 byte image of their register, buffers on
+ * the stack refer to the VH buffer and get their VEMVA in setup().
  */
-struct ArgBase {
-  virtual ~ArgBase() = default;
-  virtual int64_t getRegVal() const = 0;
-  virtual size_t sizeOnStack() const = 0;
-  virtual void setStackImage(uint64_t, std::string &, int, bool &, bool &) = 0;
-  virtual std::function<void(void *)> copyoutFromStackImage(uint64_t) = 0;
+struct ArgSlot {
+  enum Kind : uint8_t { NONE, VALUE, STACK };
+  uint64_t val;		//!< register image; VEMVA of a stack buffer
+  char *buff;		//!< VH buffer of a stack argument
+  size_t len;		//!< length of the stack buffer
+  Kind kind;
+  uint8_t size;		//!< bytes of a value in the stack image
+  bool in;		//!< copy the stack buffer in
+  bool out;		//!< copy the stack buffer out
+};
+
+/**
+ * @brief managed buffer argument
+ *
+ * The dirty pages are uploaded before the call, the range written by
+ * the VE function is read back after it.
+ */
+struct ManagedArg {
+  int argnum;
+  std::shared_ptr<ManagedMem> mem;
+  size_t off;		//!< offset of the range written by the VE
+  size_t len;		//!< length of the range, 0 for none
 };
 } // namespace internal
 
+/**
+ * @brief register arguments of a call
+ */
+struct CallRegs {
+  uint64_t val[NUM_ARGS_ON_REGISTER];
+  int num;
+};
+
 #if 0
 /**
  * @brief Arguments structure used in submitting a command
@@ -73,29 +102,40 @@ struct SendArgs {
 
 /**
  * @brief Class used for constructing the arguments of a call
+ *
+ * Arguments live in an inline array of slots, only calls with more
+ * than NUM_INLINE_ARGS arguments use the heap for them. The stack
+ * image is built by setup() only if arguments are passed on the stack.
  */
 class CallArgs {
-  std::vector<std::unique_ptr<internal::ArgBase> > arguments;
+  static constexpr int NUM_INLINE_ARGS = 16;
+  internal::ArgSlot inline_args[NUM_INLINE_ARGS];
+  std::vector<internal::ArgSlot> more_args;	// beyond NUM_INLINE_ARGS
+  int nargs;
+  std::vector<internal::ManagedArg> managed;
   template<typename T> void push_(T val);
   template<typename T> void set_(int argnum, T val);
 
-  std::string getStackImage(uint64_t);
+  internal::ArgSlot &slot_(int argnum) {
+    return argnum < NUM_INLINE_ARGS ? this->inline_args[argnum]
+                                    : this->more_args[argnum - NUM_INLINE_ARGS];
+  }
+  internal::ArgSlot &extend_(int argnum);
 
 public:
   uint64_t stack_top;
   size_t stack_size;
-  //std::unique_ptr<char[]> stack_buf;
   char *stack_buf;
 
   bool copied_in;// necessary to copy stack image to VE
   bool copied_out;// necessary to copy stack image out from VE
 
-  CallArgs(): arguments(0), stack_top(0), stack_size(0), stack_buf(0) {}
-  CallArgs(std::initializer_list<int64_t> args) {
+  CallArgs(): nargs(0), stack_top(0), stack_size(0), stack_buf(nullptr),
+              copied_in(false), copied_out(false) {}
+  CallArgs(std::initializer_list<int64_t> args): CallArgs() {
     for (auto a: args)
       this->push_(a);
   }
-  //~CallArgs() = default;
   ~CallArgs() {
     delete[] stack_buf;
   }
@@ -110,43 +150,40 @@ public:
    * @brief clear all arguments
    */
   void clear() {
-    this->arguments.clear();
+    this->nargs = 0;
+    this->more_args.clear();
+    this->managed.clear();
   }
 
   /**
    * @brief set an argument for VEO function
    * @param argnum argument number
    * @param val argument value
-   * TODO: support more types
    */
   template <typename T> void set(int argnum, T val) {
-    // TODO: trace
     this->set_(argnum, val);
   }
 
   void setOnStack(enum veo_args_intent inout, int argnum,
                   char *buff, size_t len);
+  void setImage(int argnum, uint64_t val, size_t size);
+  void setManaged(int argnum, std::shared_ptr<ManagedMem>, size_t off = 0,
+                  size_t len = 0);
+  bool hasManaged() const { return !this->managed.empty(); }
+  int uploadManaged(Context *, std::vector<ManagedMem::Upload> &);
+  int downloadManaged(Context *, std::vector<ManagedMem::Download> &);
 
   /**
    * @brief number of arguments for VEO function
    */
   int numArgs() const {
-    return this->arguments.size();
+    return this->nargs;
   }
 
-  std::vector<uint64_t> getRegVal();
+  CallRegs getRegVal();
 
   void setup(uint64_t);
 
-  /*
-  SendArgs *send_args() {
-    SendArgs sa(this->stack_top, this->stack_size,
-                this->copied_in, this->copied_out);
-    sa.regs = this->getRegVal();
-    sa.stack_buf = std::move(this->stack_buf);
-    return &sa;
-  }
-  */
   /**
    * @brief create lambda functions for copying stack passed data out
    */
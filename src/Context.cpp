@@ -26,6 +26,8 @@
 
 #include <pthread.h>
 #include <cerrno>
+#include <cstring>
+#include <sched.h>
 #include <semaphore.h>
 #include <signal.h>
 #include <unistd.h>
@@ -74,7 +76,8 @@ unsigned long synchronize_func(void *arg)
 
 Context::Context(ProcHandle *p, urpc_peer_t *up, bool is_main):
   proc(p), up(up), state(VEO_STATE_UNKNOWN), is_main(is_main), seq_no(0),
-  count(0)
+  count(0), numa_node(-1), stage(nullptr), stage_len(0),
+  stage_id(VEO_REQUEST_ID_INVALID)
 {
   progress_thread = (pthread_t)-1;
 }
@@ -92,6 +95,12 @@ int Context::close()
   VEO_TRACE("ctx=%p", this);
   // Progress thread terminates.
   this->progressTerminate();
+  // copy workers may still read from the receive buffers
+  for (auto &d : this->deferred) {
+    while (d.job != nullptr && !d.job->done())
+      sched_yield();
+  }
+  this->deferred.clear();
   if (!this->is_alive())
     return 0;
   this->state = VEO_STATE_EXIT;
@@ -143,6 +152,94 @@ void Context::progress()
   //VEO_TRACE("end");
 }
 
+/**
+ * @brief release the slot of a reply and complete its command
+ *
+ * @param req URPC request ID of the reply
+ * @param m mailbox entry of the reply
+ * @param cmd command the reply belongs to
+ * @param rv return value of the result function
+ * @return 0 upon success; -1 if the result function failed.
+ */
+int Context::_completeReply(int64_t req, urpc_mb_t *m, CmdPtr cmd, int rv)
+{
+  urpc_slot_done(this->up->recv.tq, REQ2SLOT(req), m);
+
+  // If cmd is URPC_CMD_ACCS_PCIRCVSYC,
+  // it is flagged not to save the result to the completion queue.
+  if (!cmd->getNowaitFlag())
+    this->comq.pushCompletion(std::move(cmd));
+  if (rv < 0) {
+    this->state = VEO_STATE_EXIT;
+    this->comq.cancelAll();
+    VEO_ERROR("Internal error on executing a command(%d)", rv);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief complete deferred replies in order of arrival
+ *
+ * Stops at the first reply whose copy is still running.
+ *
+ * @return number of completed replies; -1 upon failure.
+ */
+int Context::_reapDeferred()
+{
+  int n = 0;
+  while (!this->deferred.empty()) {
+    auto &d = this->deferred.front();
+    int rv = 0;
+    if (d.job == nullptr) {
+      auto cmd = this->comq.popInFlight(d.req);
+      rv = (*cmd)(&d.m, d.payload, d.plen);
+      if (rv == VEO_REPLY_DEFERRED) {
+        d.job = std::move(this->defer_job);
+        d.finish = std::move(this->defer_finish);
+        this->comq.pushInFlight(std::move(cmd));
+        return n;
+      }
+      if (this->_completeReply(d.req, &d.m, std::move(cmd), rv) < 0)
+        return -1;
+    } else {
+      if (!d.job->done())
+        return n;
+      auto cmd = this->comq.popInFlight(d.req);
+      d.finish(cmd.get());
+      if (this->_completeReply(d.req, &d.m, std::move(cmd), 0) < 0)
+        return -1;
+    }
+    this->deferred.pop_front();
+    ++n;
+  }
+  return n;
+}
+
+/**
+ * @brief hand the copy of received data to the copy workers
+ *
+ * Called by a result function on the progress thread. If the copy is
+ * handed off, the result function must return VEO_REPLY_DEFERRED and
+ * finish is called on the progress thread once the copy is done.
+ *
+ * @param dst destination
+ * @param src received data
+ * @param size size in byte
+ * @param finish sets the result of the command
+ * @return true if the copy was handed off, false if the caller must copy
+ */
+bool Context::deferCopy(void *dst, const void *src, size_t size,
+                        std::function<void(Command *)> finish)
+{
+  auto pool = this->proc->copyPool();
+  if (pool->numThreads() == 0 || size < pool->minSize())
+    return false;
+  this->defer_job = pool->copy(dst, src, size);
+  this->defer_finish = std::move(finish);
+  return true;
+}
+
 /**
  * @brief worker function for progress
  *
@@ -174,26 +271,36 @@ int Context::_progress_nolock(bool execVH)
         throw VEOException("URPC req without corresponding cmd!?", req);
       }
       set_recv_payload(uc, &m, &payload, &plen);
+      if (!this->deferred.empty()) {
+        // keep the order of replies behind a pending copy
+        DeferredReply d = { req, m, payload, plen, nullptr, nullptr };
+        this->deferred.push_back(std::move(d));
+        this->comq.pushInFlight(std::move(cmd));
+        continue;
+      }
       //
       // call command "result function"
       //
       auto rv = (*cmd)(&m, payload, plen);
-      urpc_slot_done(tq, REQ2SLOT(req), &m);
-
-      // If cmd is URPC_CMD_ACCS_PCIRCVSYC,
-      // it is flagged not to save the result to the completion queue.
-      if (!cmd->getNowaitFlag())
-        this->comq.pushCompletion(std::move(cmd));
-      if (rv < 0) {
-        this->state = VEO_STATE_EXIT;
-        this->comq.cancelAll();
-        VEO_ERROR("Internal error on executing a command(%d)", rv);
-        return -1;
+      if (rv == VEO_REPLY_DEFERRED) {
+        DeferredReply d = { req, m, payload, plen, std::move(this->defer_job),
+                            std::move(this->defer_finish) };
+        this->deferred.push_back(std::move(d));
+        this->comq.pushInFlight(std::move(cmd));
+        continue;
       }
+      if (this->_completeReply(req, &m, std::move(cmd), rv) < 0)
+        return -1;
       // continue receiving replies
       // We need this until we can manage buffer memory pressure
       continue;
     } 
+    if (!this->deferred.empty()) {
+      auto rc = this->_reapDeferred();
+      if (rc < 0)
+        return -1;
+      recvd += rc;
+    }
     //
     // try to submit a new command
     //
@@ -369,8 +476,13 @@ int Context::callSync(uint64_t addr, CallArgs &args, uint64_t *result)
   if (!this->is_alive())
     return -1;
 
-  args.setup(this->ve_sp - RESERVED_STACK_SIZE);
-  auto req = this->doCallAsync(addr, args);
+  uint64_t req;
+  if (args.hasManaged()) {
+    req = this->doCallManagedAsync(addr, args);
+  } else {
+    args.setup(this->ve_sp - RESERVED_STACK_SIZE);
+    req = this->doCallAsync(addr, args);
+  }
   if (req == VEO_REQUEST_ID_INVALID) {
     VEO_ERROR("failed! Aborting.");
     return -1;
@@ -383,11 +495,122 @@ int Context::callSync(uint64_t addr, CallArgs &args, uint64_t *result)
   return rv;
 }
 
+namespace internal {
+namespace {
+// freed CallCommands, never destroyed: commands may be freed at exit
+std::mutex call_pool_mtx;
+std::vector<void *> *call_pool = new std::vector<void *>();
+constexpr size_t CALL_POOL_MAX = 256;
+} // namespace
+
+/**
+ * @brief command calling a VE function
+ *
+ * The call parameters are members instead of captures of std::function
+ * objects and freed commands are reused, so a call with register
+ * arguments only does not allocate its command on the heap.
+ */
+class CallCommand: public Command {
+  Context *ctx;
+  uint64_t addr;
+  CallRegs regs;
+  uint64_t stack_top;
+  size_t stack_size;
+  bool copyin;
+  bool copyout;
+  void *stack;			//!< stack image, freed after the reply
+  void *stack_;			//!< buffer for the returned stack, or null
+  std::function<void(void *)> copyout_func;
+public:
+  CallCommand(uint64_t id, Context *c, uint64_t addr, const CallRegs &regs,
+              uint64_t stack_top, size_t stack_size, bool copyin,
+              bool copyout, void *stack, void *stack_,
+              std::function<void(void *)> &&copyout_func):
+    Command(id), ctx(c), addr(addr), regs(regs), stack_top(stack_top),
+    stack_size(stack_size), copyin(copyin), copyout(copyout), stack(stack),
+    stack_(stack_), copyout_func(std::move(copyout_func)) {}
+  int operator()();
+  int operator()(urpc_mb_t *m, void *payload, size_t plen);
+  bool isVH() { return false; }
+
+  static void *operator new(size_t sz) {
+    {
+      std::lock_guard<std::mutex> lock(call_pool_mtx);
+      if (!call_pool->empty()) {
+        void *p = call_pool->back();
+        call_pool->pop_back();
+        return p;
+      }
+    }
+    return ::operator new(sz);
+  }
+  static void operator delete(void *p) {
+    {
+      std::lock_guard<std::mutex> lock(call_pool_mtx);
+      if (call_pool->capacity() == 0)
+        call_pool->reserve(CALL_POOL_MAX);
+      if (call_pool->size() < CALL_POOL_MAX) {
+        call_pool->push_back(p);
+        return;
+      }
+    }
+    ::operator delete(p);
+  }
+};
+
+/**
+ * @brief submit function, called when the command is issued to URPC
+ */
+int CallCommand::operator()()
+{
+  VEO_TRACE("[request #%d] start...", this->getID());
+  int64_t req = send_call_nolock(this->ctx->up, this->ctx->ve_sp, this->addr,
+                                 this->regs, this->stack_top, this->stack_size,
+                                 this->copyin, this->copyout, this->stack);
+  VEO_TRACE("[request #%d] VE-URPC req ID = %ld", this->getID(), req);
+  if (req >= 0) {
+    this->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+  } else if (req == -EAGAIN) {
+    VEO_TRACE("[request #%d] error return...", this->getID());
+    return -EAGAIN;
+  } else {
+    // TODO: anything more meaningful into result?
+    this->setResult(0, VEO_COMMAND_ERROR);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief result function, called when response has arrived from URPC
+ */
+int CallCommand::operator()(urpc_mb_t *m, void *payload, size_t plen)
+{
+  VEO_TRACE("[request #%d] reply sendbuff received (cmd=%d)...", this->getID(),
+            m->c.cmd);
+  uint64_t result;
+  int rv = unpack_call_result(m, this->copyout_func, payload, plen, &result,
+                              this->stack_);
+  VEO_TRACE("[request #%d] unpacked", this->getID());
+  if (!this->stack_) {
+    delete[] (char *)this->stack;
+    this->stack = nullptr;
+  }
+  if (rv < 0) {
+    this->setResult(result, VEO_COMMAND_EXCEPTION);
+    this->ctx->state = VEO_STATE_EXIT;
+    return rv;
+  }
+  this->setResult(result, VEO_COMMAND_OK);
+  return 0;
+}
+} // namespace internal
+
 /**
  * @brief call a VE function asynchronously
  *
  * @param addr VEMVA of VE function to call
- * @param regs
+ * @param regs register arguments
  * @param stack_top
  * @param stack_size
  * @param copyin
@@ -400,7 +623,7 @@ int Context::callSync(uint64_t addr, CallArgs &args, uint64_t *result)
  * @note the size of args need to be less than or equal to max_args_size
  * @note The caller must invoke args.setup()
  */
-uint64_t Context::simpleCallAsync(uint64_t addr, std::vector<uint64_t> regs, uint64_t stack_top, size_t stack_size,
+uint64_t Context::simpleCallAsync(uint64_t addr, const CallRegs &regs, uint64_t stack_top, size_t stack_size,
                                   bool copyin, bool copyout, void *stack, void *stack_, std::function<void(void*)> copyout_func)
 {
   VEO_TRACE("VE function %lx", addr);
@@ -408,52 +631,9 @@ uint64_t Context::simpleCallAsync(uint64_t addr, std::vector<uint64_t> regs, uin
     return VEO_REQUEST_ID_INVALID;
   
   auto id = this->issueRequestID();
-
-  //
-  // submit function, called when cmd is issued to URPC
-  //
-  auto f = [regs, stack_top, stack_size, copyin, copyout,
-            stack, this, addr, id] (Command *cmd)
-           {
-             VEO_TRACE("[request #%d] start...", id);
-             int64_t req = send_call_nolock(this->up, this->ve_sp, addr, regs,
-                                            stack_top, stack_size,
-                                            copyin, copyout, stack);
-             VEO_TRACE("[request #%d] VE-URPC req ID = %ld", id, req);
-             if (req >= 0) {
-               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
-             } else if (req == -EAGAIN) {
-               VEO_TRACE("[request #%d] error return...", id);
-               return -EAGAIN;
-             } else {
-               // TODO: anything more meaningful into result?
-               cmd->setResult(0, VEO_COMMAND_ERROR);
-               return -1;
-             }
-             return 0;
-           };
-
-  //
-  // result function, called when response has arrived from URPC
-  //
-  auto u = [copyout_func, this, id, stack, stack_] (Command *cmd, urpc_mb_t *m, void *payload, size_t plen)
-           {
-             VEO_TRACE("[request #%d] reply sendbuff received (cmd=%d)...", id, m->c.cmd);
-             uint64_t result;
-             int rv = unpack_call_result(m, copyout_func, payload, plen, &result, stack_);
-             VEO_TRACE("[request #%d] unpacked", id);
-             if (!stack_)
-               delete[] (char *)stack;
-             if (rv < 0) {
-               cmd->setResult(result, VEO_COMMAND_EXCEPTION);
-               this->state = VEO_STATE_EXIT;
-               return rv;
-             }
-             cmd->setResult(result, VEO_COMMAND_OK);
-             return 0;
-           };
-
-  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  CmdPtr cmd(new internal::CallCommand(id, this, addr, regs, stack_top,
+                                       stack_size, copyin, copyout, stack,
+                                       stack_, std::move(copyout_func)));
   {
     std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
     if(this->comq.pushRequest(std::move(cmd)))
@@ -511,7 +691,8 @@ uint64_t Context::doCallAsync(uint64_t addr, CallArgs &args)
     // alive check and addr check was done before.
     // stack is freed by the result function of simpleCallAsync().
     return this->simpleCallAsync(addr, regs, stack_top, stack_size,
-                                 copyin, copyout, stack, nullptr, copyout_func);
+                                 copyin, copyout, stack, nullptr,
+                                 std::move(copyout_func));
   }
 
   //VEO_TRACE("callAsync large arguments");
@@ -606,12 +787,241 @@ uint64_t Context::callAsync(uint64_t addr, CallArgs &args)
   VEO_TRACE("callAsync");
   if ( addr == 0 || !this->is_alive())
     return VEO_REQUEST_ID_INVALID;
+  if (args.hasManaged())
+    return this->doCallManagedAsync(addr, args);
 
   args.setup(this->ve_sp - RESERVED_STACK_SIZE);
 
   return doCallAsync(addr, args);
 }
 
+/**
+ * @brief upload the managed buffer arguments and call a VE function
+ *
+ * The writes of the dirty pages are queued right before the call and
+ * the reads of the ranges written by the function right after it, the
+ * VE handler thread executes them in order. One VH command collects
+ * the results at the end.
+ *
+ * @param addr VEMVA of VE function to call
+ * @param args arguments of the function, with managed buffers
+ * @return request ID, its result is the return value of the function
+ */
+uint64_t Context::doCallManagedAsync(uint64_t addr, CallArgs &args)
+{
+  std::vector<ManagedMem::Upload> ups;
+  std::vector<ManagedMem::Download> downs;
+  uint64_t callreq = VEO_REQUEST_ID_INVALID;
+  int downrc = 0;
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  if (args.uploadManaged(this, ups) == 0) {
+    args.setup(this->ve_sp - RESERVED_STACK_SIZE);
+    callreq = this->doCallAsync(addr, args);
+    if (callreq == VEO_REQUEST_ID_INVALID)
+      VEO_ERROR("Calling a function failed!");
+    else
+      downrc = args.downloadManaged(this, downs);
+  }
+
+  auto id = this->issueRequestID();
+  auto upsp = std::make_shared<std::vector<ManagedMem::Upload>>(std::move(ups));
+  auto downsp = std::make_shared<std::vector<ManagedMem::Download>>(std::move(downs));
+  auto f = [this, upsp, callreq, downsp, downrc] (Command *cmd)
+           {
+             uint64_t result = 0;
+             int upstat = this->_peekUploads(*upsp);
+             int callstat = VEO_COMMAND_ERROR;
+             if (callreq != VEO_REQUEST_ID_INVALID)
+               callstat = this->_peekResult(callreq, &result);
+             int downstat = this->_peekDownloads(*downsp);
+             if (downrc != 0)
+               downstat = VEO_COMMAND_ERROR;
+
+             if (upstat != VEO_COMMAND_OK) {
+               VEO_ERROR("status = %d. managed buffer upload failed.(VH -> VE)", upstat);
+               cmd->setResult(result, upstat);
+             } else if (callstat != VEO_COMMAND_OK) {
+               cmd->setResult(result, callstat);
+             } else if (downstat != VEO_COMMAND_OK) {
+               VEO_ERROR("status = %d. managed buffer read back failed.(VE -> VH)", downstat);
+               cmd->setResult(result, downstat);
+             } else {
+               cmd->setResult(result, VEO_COMMAND_OK);
+             }
+             return 0;
+           };
+  CmdPtr req(new internal::CommandImpl(id, f));
+  if(this->comq.pushRequest(std::move(req))) {
+    // nobody collects the transfers, do not let the buffers wait for them
+    for (auto &up : *upsp)
+      up.mem->uploadDone(up, false);
+    for (auto &d : *downsp)
+      d.mem->downloadDone(d, false);
+    return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief collect the results of managed buffer uploads
+ *
+ * Pages of failed uploads are marked dirty again.
+ *
+ * @param ups writes queued by CallArgs::uploadManaged()
+ * @return VEO_COMMAND_OK or the status of a failed upload
+ */
+int Context::_peekUploads(std::vector<ManagedMem::Upload> &ups)
+{
+  int status = VEO_COMMAND_OK;
+  for (auto &up : ups) {
+    uint64_t dummy = 0;
+    int rc = this->_peekResult(up.req, &dummy);
+    up.mem->uploadDone(up, rc == VEO_COMMAND_OK);
+    if (rc != VEO_COMMAND_OK)
+      status = rc;
+  }
+  return status;
+}
+
+/**
+ * @brief collect the results of managed buffer read backs
+ *
+ * @param downs reads queued by CallArgs::downloadManaged()
+ * @return VEO_COMMAND_OK or the status of a failed read
+ */
+int Context::_peekDownloads(std::vector<ManagedMem::Download> &downs)
+{
+  int status = VEO_COMMAND_OK;
+  for (auto &d : downs) {
+    uint64_t dummy = 0;
+    int rc = this->_peekResult(d.req, &dummy);
+    d.mem->downloadDone(d, rc == VEO_COMMAND_OK);
+    if (rc != VEO_COMMAND_OK)
+      status = rc;
+  }
+  return status;
+}
+
+/**
+ * @brief write inputs, call a VE function and read outputs
+ *
+ * The input transfers, the call and the output transfers are submitted
+ * back to back as VE commands, the VE handler thread executes them in
+ * order without waiting for the VH in between. One VH command collects
+ * the results at the end.
+ *
+ * @param addr VEMVA of VE function to call
+ * @param args arguments of the function
+ * @param in buffers written to VE memory before the call
+ * @param nin number of input buffers
+ * @param out buffers read from VE memory after the call
+ * @param nout number of output buffers
+ * @return request ID, its result is the return value of the function
+ */
+uint64_t Context::callAsyncWithIO(uint64_t addr, CallArgs &args,
+                                  const veo_iovec *in, int nin,
+                                  const veo_iovec *out, int nout)
+{
+  VEO_TRACE("callAsyncWithIO");
+  if ( addr == 0 || !this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+  if (nin < 0 || nout < 0 || (nin > 0 && in == nullptr) ||
+      (nout > 0 && out == nullptr))
+    return VEO_REQUEST_ID_INVALID;
+  auto nonempty = [] (const veo_iovec *iov, int n) {
+    for (int i = 0; i < n; i++)
+      if (iov[i].size > 0)
+        return true;
+    return false;
+  };
+
+  uint64_t writereq = VEO_REQUEST_ID_INVALID;
+  uint64_t callreq = VEO_REQUEST_ID_INVALID;
+  uint64_t readreq = VEO_REQUEST_ID_INVALID;
+  bool writing = nonempty(in, nin);
+  bool reading = nonempty(out, nout);
+  std::vector<ManagedMem::Upload> ups;
+  std::vector<ManagedMem::Download> downs;
+  int downrc = 0;
+
+  std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+  if (writing) {
+    writereq = this->asyncWriteV(in, nin);
+    if (writereq == VEO_REQUEST_ID_INVALID) {
+      VEO_ERROR("Writing input buffers failed!");
+      return VEO_REQUEST_ID_INVALID;
+    }
+  }
+  if (args.uploadManaged(this, ups) == 0) {
+    args.setup(this->ve_sp - RESERVED_STACK_SIZE);
+    callreq = this->doCallAsync(addr, args);
+    if (callreq == VEO_REQUEST_ID_INVALID)
+      VEO_ERROR("Calling a function failed!");
+  }
+  if (reading && callreq != VEO_REQUEST_ID_INVALID) {
+    readreq = this->asyncReadV(out, nout);
+    if (readreq == VEO_REQUEST_ID_INVALID)
+      VEO_ERROR("Reading output buffers failed!");
+  }
+  if (callreq != VEO_REQUEST_ID_INVALID)
+    downrc = args.downloadManaged(this, downs);
+
+  auto id = this->issueRequestID();
+  auto upsp = std::make_shared<std::vector<ManagedMem::Upload>>(std::move(ups));
+  auto downsp = std::make_shared<std::vector<ManagedMem::Download>>(std::move(downs));
+  auto f = [this, writereq, upsp, callreq, readreq, reading, downsp,
+            downrc] (Command *cmd)
+           {
+             int writestat = VEO_COMMAND_OK;
+             int callstat = VEO_COMMAND_ERROR;
+             int readstat = reading ? VEO_COMMAND_ERROR : VEO_COMMAND_OK;
+             uint64_t result = 0;
+             uint64_t dummy = 0;
+             if (writereq != VEO_REQUEST_ID_INVALID)
+               writestat = this->_peekResult(writereq, &dummy);
+             int upstat = this->_peekUploads(*upsp);
+             if (writestat == VEO_COMMAND_OK)
+               writestat = upstat;
+             if (callreq != VEO_REQUEST_ID_INVALID)
+               callstat = this->_peekResult(callreq, &result);
+             if (readreq != VEO_REQUEST_ID_INVALID)
+               readstat = this->_peekResult(readreq, &dummy);
+             int downstat = this->_peekDownloads(*downsp);
+             if (downrc != 0)
+               downstat = VEO_COMMAND_ERROR;
+             if (readstat == VEO_COMMAND_OK)
+               readstat = downstat;
+
+             if (writestat != VEO_COMMAND_OK) {
+               VEO_ERROR("status = %d. input transfer failed.(VH -> VE)", writestat);
+               cmd->setResult(result, writestat);
+             } else if (callstat != VEO_COMMAND_OK) {
+               cmd->setResult(result, callstat);
+             } else if (readstat != VEO_COMMAND_OK) {
+               VEO_ERROR("status = %d. output transfer failed.(VE -> VH)", readstat);
+               cmd->setResult(result, readstat);
+             } else {
+               cmd->setResult(result, VEO_COMMAND_OK);
+             }
+             return 0;
+           };
+  CmdPtr req(new internal::CommandImpl(id, f));
+  if(this->comq.pushRequest(std::move(req))) {
+    // nobody collects the transfers, do not let the buffers wait for them
+    for (auto &up : *upsp)
+      up.mem->uploadDone(up, false);
+    for (auto &d : *downsp)
+      d.mem->downloadDone(d, false);
+    return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
 /**
  * @brief call a VE function specified by symbol name asynchronously
  *
@@ -748,6 +1158,7 @@ int Context::callWaitResult(uint64_t reqid, uint64_t *retp)
 ThreadContextAttr::ThreadContextAttr()
 {
   this->stacksize = VEO_DEFAULT_STACKSIZE;
+  this->numa_node = VEO_NUMA_NODE_AUTO;
 }
 
 void ThreadContextAttr::setStacksize(size_t stack_sz)
@@ -759,6 +1170,249 @@ void ThreadContextAttr::setStacksize(size_t stack_sz)
  this->stacksize = stack_sz;
 }
 
+void ThreadContextAttr::setNumaNode(int node)
+{
+  if (node < VEO_NUMA_NODE_NONE) {
+    VEO_ERROR("invalid NUMA node %d", node);
+    throw VEOException("invalid NUMA node of VEO context", EINVAL);
+  }
+  this->numa_node = node;
+}
+
+/**
+ * @brief allocate a VE buffer
+ *
+ * Like an ALLOC request of genericAsyncReq(), the buffer is accounted
+ * in the memory statistics of the proc when the reply arrives.
+ *
+ * @param size size in byte
+ * @return request ID, its result is the VEMVA of the buffer
+ */
+uint64_t Context::allocMemAsync(size_t size)
+{
+  VEO_TRACE("size=%lu", size);
+  if (!this->is_alive())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  auto f = [this, size, id] (Command *cmd)
+           {
+             int req = urpc_generic_send(this->up, URPC_CMD_ALLOC, (char *)"L",
+                                         size);
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+  auto u = [this, size, id] (Command *cmd, urpc_mb_t *m, void *payload,
+                             size_t plen)
+           {
+             uint64_t result;
+             int rv = unpack_call_result(m, nullptr, payload, plen, &result, nullptr);
+             if (rv < 0) {
+               cmd->setResult(result, VEO_COMMAND_EXCEPTION);
+               this->state = VEO_STATE_EXIT;
+               return rv;
+             }
+             this->proc->memStats()->add(result, size);
+             cmd->setResult(result, VEO_COMMAND_OK);
+             VEO_TRACE("[request #%d] result end...", id);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief maximum number of buffers in one ALLOCV or FREEV request
+ *
+ * The sizes of the request and the addresses of the reply each have
+ * to fit into one URPC command, both directions have the same size.
+ *
+ * @return number of buffers
+ */
+size_t Context::maxAllocV()
+{
+  size_t cmdsz = urpc_max_send_cmd_size(this->up);
+  if (cmdsz <= ALLOCV_CMD_SIZE_WITHOUT_DATA + sizeof(uint64_t))
+    return 1;
+  return (cmdsz - ALLOCV_CMD_SIZE_WITHOUT_DATA) / sizeof(uint64_t);
+}
+
+/**
+ * @brief allocate several VE buffers with one request
+ *
+ * The addresses are stored into addrs when the VE reply arrives. If
+ * one allocation fails the VE frees the others and the request fails.
+ *
+ * @param sizes buffer sizes, at most maxAllocV()
+ * @param[out] addrs VEMVAs of the buffers, must stay valid until
+ *             the request has finished
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
+ * @return request ID
+ */
+uint64_t Context::allocMultiAsync(std::vector<uint64_t> &&sizes,
+                                  uint64_t *addrs, uint64_t prev)
+{
+  VEO_TRACE("n=%lu", sizes.size());
+  if (!this->is_alive() || sizes.empty() || sizes.size() > this->maxAllocV())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  auto sizesp = std::make_shared<std::vector<uint64_t>>(std::move(sizes));
+  auto f = [this, sizesp, id] (Command *cmd)
+           {
+             VEO_TRACE("allocMultiAsync [request #%d] start...", id);
+             int req = urpc_generic_send(this->up, URPC_CMD_ALLOCV, (char *)"P",
+                                         (void *)sizesp->data(),
+                                         sizesp->size() * sizeof(uint64_t));
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+  auto u = [this, sizesp, addrs, id, prev] (Command *cmd, urpc_mb_t *m,
+                                            void *payload, size_t plen)
+           {
+             if (m->c.cmd == URPC_CMD_EXCEPTION) {
+               cmd->setResult(-URPC_CMD_ALLOCV, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_ALLOCV;
+             }
+             if (m->c.cmd != URPC_CMD_SENDBUFF) {
+               int64_t rc = 0;
+               urpc_unpack_payload(payload, plen, (char *)"L", &rc);
+               VEO_ERROR("[request #%d] VE failed to allocate %lu buffers, rc=%ld",
+                         id, sizesp->size(), rc);
+               cmd->setResult(rc, VEO_COMMAND_ERROR);
+               return 0;
+             }
+             uint64_t n;
+             void *buff;
+             size_t buffsz;
+             urpc_unpack_payload(payload, plen, (char *)"LP", &n, &buff, &buffsz);
+             if (n != sizesp->size() || buffsz != n * sizeof(uint64_t)) {
+               VEO_ERROR("mismatch: n=%lu replied=%lu", sizesp->size(), n);
+               cmd->setResult(-URPC_CMD_ALLOCV, VEO_COMMAND_EXCEPTION);
+               return -1;
+             }
+             memcpy(addrs, buff, buffsz);
+             for (size_t i = 0; i < n; i++)
+               this->proc->memStats()->add(addrs[i], (*sizesp)[i]);
+             uint64_t result = 0;
+             int status = VEO_COMMAND_OK;
+             if (prev != VEO_REQUEST_ID_INVALID) {
+               auto rc = this->_peekResult(prev, &result);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                           prev, rc);
+                 status = rc;
+               }
+             }
+             cmd->setResult(result, status);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
+/**
+ * @brief free several VE buffers with one request
+ *
+ * @param addrs VEMVAs of the buffers, at most maxAllocV()
+ * @param prev previous request in chain, VEO_REQUEST_ID_INVALID
+ *             if there is no previous req this one depends on
+ * @return request ID
+ */
+uint64_t Context::freeMultiAsync(std::vector<uint64_t> &&addrs, uint64_t prev)
+{
+  VEO_TRACE("n=%lu", addrs.size());
+  if (!this->is_alive() || addrs.empty() || addrs.size() > this->maxAllocV())
+    return VEO_REQUEST_ID_INVALID;
+
+  auto id = this->issueRequestID();
+  auto addrsp = std::make_shared<std::vector<uint64_t>>(std::move(addrs));
+  auto f = [this, addrsp, id] (Command *cmd)
+           {
+             VEO_TRACE("freeMultiAsync [request #%d] start...", id);
+             int req = urpc_generic_send(this->up, URPC_CMD_FREEV, (char *)"P",
+                                         (void *)addrsp->data(),
+                                         addrsp->size() * sizeof(uint64_t));
+             if (req >= 0) {
+               cmd->setURPCReq(req, VEO_COMMAND_UNFINISHED);
+             } else if (req == -EAGAIN) {
+               VEO_TRACE("[request #%d] error return...", id);
+               return -EAGAIN;
+             } else {
+               cmd->setResult(0, VEO_COMMAND_ERROR);
+               VEO_TRACE("[request #%d] error return...", id);
+               return -1;
+             }
+             return 0;
+           };
+  auto u = [this, id, prev] (Command *cmd, urpc_mb_t *m,
+                             void *payload, size_t plen)
+           {
+             if (m->c.cmd != URPC_CMD_ACK) {
+               VEO_ERROR("[request #%d] unexpected reply cmd=%d", id, m->c.cmd);
+               cmd->setResult(-URPC_CMD_FREEV, VEO_COMMAND_EXCEPTION);
+               return (int)-URPC_CMD_FREEV;
+             }
+             uint64_t result = 0;
+             int status = VEO_COMMAND_OK;
+             if (prev != VEO_REQUEST_ID_INVALID) {
+               auto rc = this->_peekResult(prev, &result);
+               if (rc != VEO_COMMAND_OK) {
+                 VEO_ERROR("request #%ld in chain has unexpected status %d",
+                           prev, rc);
+                 status = rc;
+               }
+             }
+             cmd->setResult(result, status);
+             return 0;
+           };
+
+  CmdPtr cmd(new internal::CommandImpl(id, f, u));
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->submit_mtx);
+    if(this->comq.pushRequest(std::move(cmd)))
+      return VEO_REQUEST_ID_INVALID;
+  }
+  this->progress();
+  this->comq.notifyAll();
+  return id;
+}
+
 /**
  * @brief read data from VE memory
  * @param[out] dst buffer to store the data
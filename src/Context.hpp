@@ -28,7 +28,9 @@
 #include "Command.hpp"
 #include "CommandImpl.hpp"
 #include <mutex>
+#include <deque>
 #include <unordered_set>
+#include <vector>
 #include <utility>
 #include <tuple>
 #include <functional>
@@ -36,6 +38,8 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+#include "CopyPool.hpp"
+#include "ManagedMem.hpp"
 #include "log.h"
 #include <urpc.h>
 #include "veo_urpc.h"
@@ -47,13 +51,40 @@ namespace veo {
 
 class ProcHandle;
 class CallArgs;
+struct CallRegs;
 class ThreadContextAttr;
+namespace internal { class CallCommand; }
+
+// VH staging buffers bound to a NUMA node, see ProcHandle.cpp
+void *allocOnNode(size_t, int);
+void freeOnNode(void *, size_t);
+
+// returned by a result function which handed its copy to a CopyPool
+#define VEO_REPLY_DEFERRED 1
+
+/**
+ * @brief layout of the rows of a strided 2D or 3D block in memory
+ *
+ * Rows are numbered consecutively through all slices of the block.
+ */
+struct StridedLayout {
+  size_t pitch;		//!< distance of consecutive rows in byte
+  size_t slice;		//!< distance of consecutive slices in byte
+  size_t height;	//!< number of rows per slice of the block
+  /**
+   * @brief offset of row r from the start of the block
+   */
+  size_t rowOffset(size_t r) const {
+    return (r / this->height) * this->slice + (r % this->height) * this->pitch;
+  }
+};
 
 /**
  * @brief VEO thread context
  */
 class Context {
   friend class ProcHandle;// ProcHandle controls the main thread directly.
+  friend class internal::CallCommand;
 private:
   CommQueue comq;
   veo_context_state state;
@@ -68,8 +99,65 @@ private:
   std::recursive_mutex prog_mtx;
   void progress();
   int _progress_nolock(bool);
+  /**
+   * @brief reply whose completion waits for a copy worker
+   *
+   * The command stays in the in-flight queue and its VE-URPC slot is
+   * kept until the reply is completed.
+   */
+  struct DeferredReply {
+    int64_t req;			//!< URPC request ID
+    urpc_mb_t m;			//!< mailbox entry of the reply
+    void *payload;
+    size_t plen;
+    std::shared_ptr<CopyJob> job;	//!< copy to wait for, null if the
+					//!< result function was not called yet
+    std::function<void(Command *)> finish; //!< completes the command
+  };
+  std::deque<DeferredReply> deferred;	//!< in order of arrival
+  std::shared_ptr<CopyJob> defer_job;	//!< set by deferCopy()
+  std::function<void(Command *)> defer_finish;
+  int _completeReply(int64_t, urpc_mb_t *, CmdPtr, int);
+  int _reapDeferred();
   pthread_t progress_thread;
   uint64_t count;
+  int numa_node;		//!< NUMA node of VH buffers, -1: not bound
+  char *stage;			//!< packing buffer of the submit functions
+  size_t stage_len;		//!< size of the mapping of stage
+  uint64_t stage_id;		//!< request whose payload is packed in stage
+  /**
+   * @brief get the packing buffer for the payload of a request
+   *
+   * Submit functions run one at a time under prog_mtx, so one buffer
+   * per context is enough. It keeps its capacity, fragments of large
+   * transfers do not allocate, and a request resubmitted after -EAGAIN
+   * finds its payload still packed. The buffer is allocated on the
+   * NUMA node of the context.
+   *
+   * @param id request ID
+   * @param size payload size
+   * @param[out] packed true if stage already holds the payload of id
+   * @return pointer to the buffer; nullptr upon failure.
+   */
+  char *stageBuffer(uint64_t id, size_t size, bool &packed) {
+    packed = (this->stage_id == id);
+    if (!packed) {
+      if (this->stage_len < size) {
+        freeOnNode(this->stage, this->stage_len);
+        this->stage_len = 0;
+        this->stage = static_cast<char *>(allocOnNode(size, this->numa_node));
+        if (this->stage == nullptr)
+          return nullptr;
+        this->stage_len = size;
+      }
+      this->stage_id = id;
+    }
+    return this->stage;
+  }
+  /**
+   * @brief release the packing buffer after the payload was sent
+   */
+  void stageDone() { this->stage_id = VEO_REQUEST_ID_INVALID; }
   /**
    * @brief Issue a new request ID
    * @return a request ID, 64 bit integer, to identify a command
@@ -103,8 +191,11 @@ private:
     return true;
   }
 
-  uint64_t simpleCallAsync(uint64_t, std::vector<uint64_t>, uint64_t, size_t, bool, bool, void *, void *, std::function<void(void*)>);
+  uint64_t simpleCallAsync(uint64_t, const CallRegs &, uint64_t, size_t, bool, bool, void *, void *, std::function<void(void*)>);
   uint64_t doCallAsync(uint64_t, CallArgs &);
+  uint64_t doCallManagedAsync(uint64_t, CallArgs &);
+  int _peekUploads(std::vector<ManagedMem::Upload> &);
+  int _peekDownloads(std::vector<ManagedMem::Download> &);
 
   // handlers for commands
   int _readMem(void *, uint64_t, size_t);
@@ -116,7 +207,7 @@ private:
 public:
   Context(ProcHandle *, urpc_peer_t *up, bool is_main);
   Context(ProcHandle *);
-  ~Context() {}
+  ~Context() { freeOnNode(this->stage, this->stage_len); }
   Context(const Context &) = delete;//non-copyable
   void getStackPointer(uint64_t *sp);
   veo_context_state getState() { return this->state; }
@@ -125,6 +216,8 @@ public:
   int callSync(uint64_t addr, CallArgs &arg, uint64_t *result);
   uint64_t callAsync(uint64_t, CallArgs &);
   uint64_t callAsyncByName(uint64_t, const char *, CallArgs &);
+  uint64_t callAsyncWithIO(uint64_t, CallArgs &, const veo_iovec *, int,
+                           const veo_iovec *, int);
   uint64_t callVHAsync(uint64_t (*)(void *), void *);
   int callWaitResult(uint64_t, uint64_t *);
   int callPeekResult(uint64_t, uint64_t *);
@@ -135,11 +228,52 @@ public:
   void progressExec();
   bool waitProgress();
 
-  uint64_t sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev);
-  uint64_t recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev);
+  bool deferCopy(void *dst, const void *src, size_t size,
+                 std::function<void(Command *)> finish);
+  uint64_t sendBuffAsync(uint64_t dst, void *src, size_t size, uint64_t prev,
+                         veo_xfer_progress *prog = nullptr, size_t done = 0,
+                         size_t total = 0);
+  uint64_t recvBuffAsync(void *dst, uint64_t src, size_t size, uint64_t prev,
+                         veo_xfer_progress *prog = nullptr, size_t done = 0,
+                         size_t total = 0);
+  uint64_t dmaBuffAsync(int urpc_cmd, uint64_t veaddr, uint64_t vehva, size_t size);
+  uint64_t sendStridedAsync(uint64_t dst, const StridedLayout &dl,
+                            const char *src, const StridedLayout &sl,
+                            size_t width, size_t r0, size_t nrows, uint64_t prev);
+  uint64_t recvStridedAsync(char *dst, const StridedLayout &dl,
+                            uint64_t src, const StridedLayout &sl,
+                            size_t width, size_t r0, size_t nrows, uint64_t prev);
+  uint64_t sendVAsync(std::vector<veo_iovec> &&iov, uint64_t prev);
+  uint64_t recvVAsync(std::vector<veo_iovec> &&iov, uint64_t prev);
+  uint64_t allocMemAsync(size_t size);
+  uint64_t allocMultiAsync(std::vector<uint64_t> &&sizes, uint64_t *addrs,
+                           uint64_t prev);
+  uint64_t freeMultiAsync(std::vector<uint64_t> &&addrs, uint64_t prev);
+  size_t maxAllocV();
 
   uint64_t asyncReadMem(void *dst, uint64_t src , size_t size);
   uint64_t asyncWriteMem(uint64_t dst, const void *src, size_t size);
+  uint64_t asyncReadMemProgress(void *dst, uint64_t src, size_t size,
+                                veo_xfer_progress *prog);
+  uint64_t asyncWriteMemProgress(uint64_t dst, const void *src, size_t size,
+                                 veo_xfer_progress *prog);
+  uint64_t asyncReadMemFrag(void *dst, uint64_t src, size_t size, size_t maxfrag,
+                            veo_xfer_progress *prog = nullptr);
+  uint64_t asyncWriteMemFrag(uint64_t dst, const void *src, size_t size, size_t maxfrag,
+                             veo_xfer_progress *prog = nullptr);
+  uint64_t asyncXferStriped(bool write, void *vh, uint64_t ve, size_t size);
+  uint64_t asyncWriteMemStrided(uint64_t dst, const StridedLayout &dl,
+                                const void *src, const StridedLayout &sl,
+                                size_t width, size_t nrows);
+  uint64_t asyncReadMemStrided(void *dst, const StridedLayout &dl,
+                               uint64_t src, const StridedLayout &sl,
+                               size_t width, size_t nrows);
+  uint64_t asyncWriteV(const veo_iovec *iov, int n);
+  uint64_t asyncReadV(const veo_iovec *iov, int n);
+  uint64_t asyncFillMem(uint64_t dst, uint64_t pattern, size_t psize, size_t count);
+  uint64_t asyncHmemcpy(const veo_hmemcpy_desc *d, int n);
+  size_t recvFragSize(size_t size);
+  size_t sendFragSize(size_t size);
   int readMem(void *dst, uint64_t src , size_t size);
   int writeMem(uint64_t dst, const void *src, size_t size);
 
@@ -260,6 +394,7 @@ public:
 class ThreadContextAttr {
 private:
   size_t stacksize;
+  int numa_node;
 
 public:
   ThreadContextAttr();
@@ -267,6 +402,8 @@ public:
 
   void setStacksize(size_t);
   size_t getStacksize() { return this->stacksize;}
+  void setNumaNode(int);
+  int getNumaNode() { return this->numa_node; }
 
   veo_thr_ctxt_attr *toCHandle() {
     return reinterpret_cast<veo_thr_ctxt_attr *>(this);
@@ -0,0 +1,306 @@
+/**
+ * @file CopyPool.cpp
+ * @brief implementation of the receive copy workers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * CopyPool methods implementation.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "CopyPool.hpp"
+#include "log.h"
+
+// default for VEO_RECV_COPY_MIN
+#define COPY_MIN_SIZE_DEFAULT (256 * 1024)
+// copies are cut into chunks of this size for the workers
+#define COPY_CHUNK (256 * 1024)
+#define COPY_MAX_THREADS 64
+
+// from <numaif.h>, avoid depending on libnuma
+#define VEO_MPOL_F_NODE (1 << 0)
+#define VEO_MPOL_F_ADDR (1 << 1)
+
+namespace veo {
+
+#if defined(__x86_64__)
+//
+// memcpy with non temporal stores, the destination is not cached.
+// The tail and the unaligned head are copied by memcpy.
+//
+__attribute__((target("avx2")))
+static void *memcpy_nt_avx2(void *dst, const void *src, size_t size)
+{
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+  size_t head = std::min((size_t)(-(uintptr_t)d & 31), size);
+
+  memcpy(d, s, head);
+  d += head; s += head; size -= head;
+  for (; size >= 128; size -= 128, d += 128, s += 128) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)s);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+    __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+    _mm256_stream_si256((__m256i *)d, a);
+    _mm256_stream_si256((__m256i *)(d + 32), b);
+    _mm256_stream_si256((__m256i *)(d + 64), c);
+    _mm256_stream_si256((__m256i *)(d + 96), e);
+  }
+  _mm_sfence();
+  memcpy(d, s, size);
+  return dst;
+}
+
+__attribute__((target("avx512f")))
+static void *memcpy_nt_avx512(void *dst, const void *src, size_t size)
+{
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+  size_t head = std::min((size_t)(-(uintptr_t)d & 63), size);
+
+  memcpy(d, s, head);
+  d += head; s += head; size -= head;
+  for (; size >= 256; size -= 256, d += 256, s += 256) {
+    __m512i a = _mm512_loadu_si512((const void *)s);
+    __m512i b = _mm512_loadu_si512((const void *)(s + 64));
+    __m512i c = _mm512_loadu_si512((const void *)(s + 128));
+    __m512i e = _mm512_loadu_si512((const void *)(s + 192));
+    _mm512_stream_si512((__m512i *)d, a);
+    _mm512_stream_si512((__m512i *)(d + 64), b);
+    _mm512_stream_si512((__m512i *)(d + 128), c);
+    _mm512_stream_si512((__m512i *)(d + 192), e);
+  }
+  _mm_sfence();
+  memcpy(d, s, size);
+  return dst;
+}
+#endif
+
+/**
+ * @brief select the memcpy with non temporal stores by CPUID
+ */
+static CopyPool::memcpy_fn select_nt_memcpy(const char **name)
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    *name = "avx512";
+    return memcpy_nt_avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    *name = "avx2";
+    return memcpy_nt_avx2;
+  }
+#endif
+  *name = "memcpy";
+  return ::memcpy;
+}
+
+/**
+ * @brief NUMA node of the memory page at addr
+ *
+ * @return node number; -1 if unknown.
+ */
+int CopyPool::memNode(void *addr)
+{
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr,
+              VEO_MPOL_F_NODE | VEO_MPOL_F_ADDR) != 0)
+    return -1;
+  return node;
+}
+
+/**
+ * @brief start the workers if VEO_RECV_COPY_THREADS is set
+ *
+ * VEO_RECV_COPY_THREADS is the number of workers, VEO_RECV_COPY_MIN
+ * the minimum size of a copy handed to them, VEO_RECV_COPY_NODE
+ * overrides the NUMA node they are pinned to (-1: no pinning).
+ * VEO_RECV_COPY_NT is the minimum size of a copy done with non
+ * temporal stores, unset or 0 disables them.
+ *
+ * @param node NUMA node of the VE-URPC buffers, -1 if unknown
+ * @return number of workers started; -1 upon failure.
+ */
+int CopyPool::init(int node)
+{
+  const char *name;
+  const char *e = getenv("VEO_RECV_COPY_NT");
+  if (e != nullptr)
+    this->nt_min_size = strtoul(e, nullptr, 0);
+  if (this->nt_min_size)
+    this->nt_memcpy = select_nt_memcpy(&name);
+
+  e = getenv("VEO_RECV_COPY_THREADS");
+  if (e == nullptr)
+    return 0;
+  int n = std::min(atoi(e), COPY_MAX_THREADS);
+  if (n <= 0)
+    return 0;
+  e = getenv("VEO_RECV_COPY_MIN");
+  this->min_size = e ? strtoul(e, nullptr, 0) : COPY_MIN_SIZE_DEFAULT;
+  e = getenv("VEO_RECV_COPY_NODE");
+  this->node = e ? atoi(e) : node;
+
+  for (int i = 0; i < n; i++) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, workerMain, (void *)this) != 0) {
+      VEO_ERROR("failed to create copy worker %d", i);
+      this->finish();
+      return -1;
+    }
+    this->threads.push_back(t);
+  }
+  VEO_DEBUG("%d receive copy workers on node %d, min size %lu, nt from %lu (%s)",
+            n, this->node, this->min_size, this->nt_min_size,
+            this->nt_min_size ? name : "off");
+  return n;
+}
+
+/**
+ * @brief stop and join the workers
+ *
+ * Parts which are queued are copied before the workers exit.
+ */
+void CopyPool::finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->stop = true;
+  }
+  this->cond.notify_all();
+  for (auto t : this->threads)
+    pthread_join(t, nullptr);
+  this->threads.clear();
+}
+
+/**
+ * @brief hand a copy to the workers
+ *
+ * @param dst destination
+ * @param src source, must stay valid until the job is done
+ * @param size size in byte
+ * @return job to poll for completion
+ */
+std::shared_ptr<CopyJob> CopyPool::copy(void *dst, const void *src, size_t size)
+{
+  size_t nparts = std::max((size_t)1, (size + COPY_CHUNK / 2) / COPY_CHUNK);
+  bool nt = this->nt_min_size && size >= this->nt_min_size;
+  auto job = std::make_shared<CopyJob>(nparts);
+  {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    for (size_t off = 0, i = 0; i < nparts; i++, off += COPY_CHUNK) {
+      size_t len = i == nparts - 1 ? size - off : COPY_CHUNK;
+      Part p = { (char *)dst + off, (const char *)src + off, len, nt, job };
+      this->parts.push_back(p);
+    }
+  }
+  if (nparts == 1)
+    this->cond.notify_one();
+  else
+    this->cond.notify_all();
+  return job;
+}
+
+/**
+ * @brief copy on the calling thread
+ *
+ * Uses non temporal stores for large copies like the workers do.
+ */
+void CopyPool::copyInline(void *dst, const void *src, size_t size)
+{
+  if (this->nt_min_size && size >= this->nt_min_size)
+    this->nt_memcpy(dst, src, size);
+  else
+    memcpy(dst, src, size);
+}
+
+/**
+ * @brief pin the calling worker to the CPUs of its NUMA node
+ */
+void CopyPool::pin()
+{
+  if (this->node < 0)
+    return;
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+           this->node);
+  FILE *f = fopen(path, "r");
+  if (f == nullptr)
+    return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  int a, b;
+  char sep;
+  while (fscanf(f, "%d", &a) == 1) {
+    b = a;
+    sep = fgetc(f);
+    if (sep == '-') {
+      if (fscanf(f, "%d", &b) != 1)
+        break;
+      sep = fgetc(f);
+    }
+    for (int c = a; c <= b && c < CPU_SETSIZE; c++)
+      CPU_SET(c, &set);
+    if (sep != ',')
+      break;
+  }
+  fclose(f);
+  if (CPU_COUNT(&set) > 0 &&
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    VEO_DEBUG("failed to pin copy worker to node %d", this->node);
+}
+
+void *CopyPool::workerMain(void *arg)
+{
+  static_cast<CopyPool *>(arg)->work();
+  return nullptr;
+}
+
+void CopyPool::work()
+{
+  this->pin();
+  for (;;) {
+    Part p;
+    {
+      std::unique_lock<std::mutex> lock(this->mtx);
+      this->cond.wait(lock, [this] { return this->stop || !this->parts.empty(); });
+      if (this->parts.empty())
+        return;
+      p = std::move(this->parts.front());
+      this->parts.pop_front();
+    }
+    if (p.nt)
+      this->nt_memcpy(p.dst, p.src, p.size);
+    else
+      memcpy(p.dst, p.src, p.size);
+    p.job->partDone();
+  }
+}
+
+} // namespace veo
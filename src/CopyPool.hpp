@@ -0,0 +1,97 @@
+/**
+ * @file CopyPool.hpp
+ * @brief worker threads copying received data to user buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * CopyPool class definition.
+ */
+#ifndef _VEO_COPY_POOL_HPP_
+#define _VEO_COPY_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pthread.h>
+
+namespace veo {
+
+/**
+ * @brief completion state of a copy handed to a CopyPool
+ */
+class CopyJob {
+  std::atomic<int> pending;	//!< parts not yet copied
+public:
+  explicit CopyJob(int n) : pending(n) {}
+  void partDone() { this->pending.fetch_sub(1, std::memory_order_release); }
+  bool done() { return this->pending.load(std::memory_order_acquire) == 0; }
+};
+
+/**
+ * @brief pool of threads copying received data to user buffers
+ *
+ * Used by the progress threads of a proc to hand off the copy out of
+ * the VE-URPC receive buffers, which keeps them free for submitting
+ * and receiving. Copies are cut into cache sized chunks which are
+ * picked up by the workers. The workers are pinned to the CPUs of the
+ * NUMA node holding the VE-URPC buffers. Large copies can use non
+ * temporal stores, the implementation is selected by CPUID.
+ */
+class CopyPool {
+public:
+  typedef void *(*memcpy_fn)(void *, const void *, size_t);
+
+  CopyPool() : stop(false), min_size(0), nt_min_size(0), node(-1),
+               nt_memcpy(::memcpy) {}
+  ~CopyPool() { this->finish(); }
+  int init(int);
+  void finish();
+  int numThreads() { return this->threads.size(); }
+  size_t minSize() { return this->min_size; }
+  std::shared_ptr<CopyJob> copy(void *, const void *, size_t);
+  void copyInline(void *, const void *, size_t);
+  static int memNode(void *);
+
+private:
+  struct Part {
+    void *dst;
+    const void *src;
+    size_t size;
+    bool nt;			//!< use non temporal stores
+    std::shared_ptr<CopyJob> job;
+  };
+  std::vector<pthread_t> threads;
+  std::deque<Part> parts;	//!< parts waiting for a worker
+  std::mutex mtx;		//!< protects parts and stop
+  std::condition_variable cond;
+  bool stop;
+  size_t min_size;		//!< smaller copies are not handed off
+  size_t nt_min_size;		//!< copies from this size on use nt_memcpy, 0: never
+  int node;			//!< NUMA node the workers are pinned to, -1: none
+  memcpy_fn nt_memcpy;		//!< memcpy with non temporal stores
+  static void *workerMain(void *);
+  void work();
+  void pin();
+};
+
+} // namespace veo
+#endif
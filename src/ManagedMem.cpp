@@ -0,0 +1,508 @@
+/**
+ * @file ManagedMem.cpp
+ * @brief VH shadowed VE buffers with dirty page tracking
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * ManagedMem methods implementation.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <thread>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ManagedMem.hpp"
+#include "Context.hpp"
+#include "ProcHandle.hpp"
+#include "VEOException.hpp"
+#include "log.h"
+
+namespace veo {
+
+namespace {
+// managed buffers looked up by the fault handler, only atomic loads
+// are allowed there
+std::atomic<ManagedMem *> managed[VEO_MAX_MANAGED];
+// fault handlers between looking up a buffer and finishing with it
+std::atomic<int> handlers_active;
+// references of the API to the buffers, by slot
+std::shared_ptr<ManagedMem> owners[VEO_MAX_MANAGED];
+std::mutex owners_mtx;
+std::once_flag handler_once;
+struct sigaction old_segv;
+
+void _segvHandler(int sig, siginfo_t *si, void *uc)
+{
+  int saved_errno = errno;
+  if (si->si_code == SEGV_ACCERR && ManagedMem::onFault(si->si_addr)) {
+    errno = saved_errno;
+    return;
+  }
+  errno = saved_errno;
+  // not ours, pass on to the previous handler
+  if (old_segv.sa_flags & SA_SIGINFO) {
+    old_segv.sa_sigaction(sig, si, uc);
+  } else if (old_segv.sa_handler != SIG_DFL &&
+             old_segv.sa_handler != SIG_IGN) {
+    old_segv.sa_handler(sig);
+  } else {
+    // the faulting access is repeated and gets the default action
+    signal(SIGSEGV, SIG_DFL);
+  }
+}
+
+void _installHandler()
+{
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = _segvHandler;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGSEGV, &sa, &old_segv) != 0)
+    VEO_ERROR("failed to install the managed memory fault handler: %s",
+              strerror(errno));
+}
+} // namespace
+
+bool ManagedMem::isDirty(size_t pg) const
+{
+  return (this->dirty[pg / 64].load() >> (pg % 64)) & 1;
+}
+
+void ManagedMem::setDirty(size_t pg)
+{
+  this->dirty[pg / 64].fetch_or(1UL << (pg % 64));
+}
+
+void ManagedMem::clearDirty(size_t pg)
+{
+  this->dirty[pg / 64].fetch_and(~(1UL << (pg % 64)));
+}
+
+/**
+ * @brief constructor
+ *
+ * The VE buffer has undefined contents, all pages of the shadow start
+ * dirty and writable, so the first sync uploads everything and the
+ * initialization of the shadow does not fault.
+ *
+ * @param p proc owning the VE buffer
+ * @param size size in byte
+ */
+ManagedMem::ManagedMem(ProcHandle *p, size_t size) : proc(p), host(nullptr),
+  size(size), pgsz(sysconf(_SC_PAGESIZE)), ve_addr(0), slot(-1), transfers(0)
+{
+  if (size == 0)
+    throw VEOException("ManagedMem: zero size.", EINVAL);
+  this->len = (size + this->pgsz - 1) & ~(this->pgsz - 1);
+  std::call_once(handler_once, _installHandler);
+
+  void *h = mmap(nullptr, this->len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (h == MAP_FAILED)
+    throw VEOException("ManagedMem: failed to map the VH shadow.", errno);
+  this->host = (char *)h;
+  size_t nwords = (this->npages() + 63) / 64;
+  this->dirty.reset(new std::atomic<uint64_t>[nwords]);
+  for (size_t i = 0; i < nwords; i++)
+    this->dirty[i].store(~0UL);
+
+  this->ve_addr = this->proc->allocMem(size);
+  if (this->ve_addr == 0) {
+    munmap(this->host, this->len);
+    throw VEOException("ManagedMem: failed to allocate the VE buffer.", ENOMEM);
+  }
+  for (int i = 0; i < VEO_MAX_MANAGED; i++) {
+    ManagedMem *expected = nullptr;
+    if (managed[i].compare_exchange_strong(expected, this)) {
+      this->slot = i;
+      break;
+    }
+  }
+  if (this->slot < 0) {
+    this->proc->freeMem(this->ve_addr);
+    munmap(this->host, this->len);
+    throw VEOException("ManagedMem: too many managed buffers.", ENOMEM);
+  }
+  VEO_DEBUG("managed buffer %p -> %lx, %lu bytes", h, this->ve_addr, size);
+}
+
+ManagedMem::~ManagedMem()
+{
+  this->release();
+}
+
+/**
+ * @brief free the VE buffer and the shadow
+ *
+ * Waits for the transfers queued from or into the shadow. They are
+ * finished by VH commands of the progress threads, which do not take
+ * mtx.
+ */
+void ManagedMem::release()
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->host == nullptr)
+    return;
+  while (this->transfers.load() != 0)
+    std::this_thread::yield();
+  // a fault handler may still use this buffer, wait until it is done
+  managed[this->slot].store(nullptr);
+  while (handlers_active.load() != 0)
+    std::this_thread::yield();
+  this->proc->freeMem(this->ve_addr);
+  munmap(this->host, this->len);
+  this->host = nullptr;
+  this->ve_addr = 0;
+  this->proc = nullptr;
+}
+
+/**
+ * @brief allocate a managed buffer and enter it into the table
+ *
+ * @param p proc owning the VE buffer
+ * @param size size in byte
+ * @return the buffer
+ */
+std::shared_ptr<ManagedMem> ManagedMem::create(ProcHandle *p, size_t size)
+{
+  std::shared_ptr<ManagedMem> m(new ManagedMem(p, size));
+  std::lock_guard<std::mutex> lock(owners_mtx);
+  owners[m->slot] = m;
+  return m;
+}
+
+/**
+ * @brief look up the managed buffer containing a VH address
+ *
+ * The reference keeps the buffer valid while it is used, a concurrent
+ * free releases it after the operation in progress.
+ *
+ * @return the buffer; nullptr if the address is not managed.
+ */
+std::shared_ptr<ManagedMem> ManagedMem::get(const void *addr)
+{
+  const char *a = (const char *)addr;
+  std::lock_guard<std::mutex> lock(owners_mtx);
+  for (auto &m : owners) {
+    if (m != nullptr && a >= m->host && a < m->host + m->len)
+      return m;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief remove a managed buffer from the table and release it
+ *
+ * @param addr VH address of the buffer
+ * @return 0 upon success; -1 if addr is not a managed buffer.
+ */
+int ManagedMem::remove(void *addr)
+{
+  std::shared_ptr<ManagedMem> m;
+  {
+    std::lock_guard<std::mutex> lock(owners_mtx);
+    for (auto &o : owners) {
+      if (o != nullptr && o->host == addr) {
+        m = std::move(o);
+        o = nullptr;
+        break;
+      }
+    }
+  }
+  if (m == nullptr)
+    return -1;
+  m->release();
+  return 0;
+}
+
+/**
+ * @brief release the managed buffers of a proc which exits
+ *
+ * @param p proc
+ */
+void ManagedMem::releaseProc(ProcHandle *p)
+{
+  std::vector<std::shared_ptr<ManagedMem>> mine;
+  {
+    std::lock_guard<std::mutex> lock(owners_mtx);
+    for (auto &o : owners) {
+      if (o != nullptr && o->proc == p) {
+        mine.push_back(std::move(o));
+        o = nullptr;
+      }
+    }
+  }
+  for (auto &m : mine)
+    m->release();
+}
+
+/**
+ * @brief find the managed buffer containing a VH address
+ *
+ * Safe to call from a signal handler, does not take a reference.
+ *
+ * @return the buffer; nullptr if the address is not managed.
+ */
+ManagedMem *ManagedMem::find(const void *addr)
+{
+  const char *a = (const char *)addr;
+  for (auto &s : managed) {
+    ManagedMem *m = s.load();
+    if (m != nullptr && a >= m->host && a < m->host + m->len)
+      return m;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief handle a write fault, called from the SIGSEGV handler
+ *
+ * The page is unprotected before it is marked dirty. A concurrent
+ * queueUpload() either sees the mark or protects the page again, then
+ * the write faults once more. release() waits for handlers which may
+ * have found the buffer.
+ *
+ * @return true if the address belongs to a managed buffer.
+ */
+bool ManagedMem::onFault(void *addr)
+{
+  handlers_active.fetch_add(1);
+  bool ok = false;
+  ManagedMem *m = find(addr);
+  if (m != nullptr) {
+    size_t pg = ((char *)addr - m->host) / m->pgsz;
+    if (mprotect(m->host + pg * m->pgsz, m->pgsz, PROT_READ | PROT_WRITE) == 0) {
+      m->setDirty(pg);
+      ok = true;
+    }
+  }
+  handlers_active.fetch_sub(1);
+  return ok;
+}
+
+/**
+ * @brief queue the upload of the dirty pages to the VE buffer
+ *
+ * Runs of consecutive dirty pages are written with one request on ctx,
+ * so they are ordered before the requests queued after them. Each run
+ * is marked clean and protected before its write is queued, host
+ * writes until the transfer mark the pages dirty again. If a write
+ * can not be queued its run is dirty and writable again. The caller
+ * passes the result of each queued write to uploadDone(), also if it
+ * never waits for the write: release() waits for it.
+ *
+ * @param ctx context to queue the writes on
+ * @param[out] ups queued writes are appended
+ * @return 0 upon success; -1 upon failure or if the buffer was freed.
+ */
+int ManagedMem::queueUpload(Context *ctx, std::vector<Upload> &ups)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->host == nullptr)
+    return -1;
+  size_t n = this->npages();
+  size_t queued = 0;
+  for (size_t pg = 0; pg < n;) {
+    if (!this->isDirty(pg)) {
+      pg++;
+      continue;
+    }
+    size_t end = pg + 1;
+    while (end < n && this->isDirty(end))
+      end++;
+    for (size_t i = pg; i < end; i++)
+      this->clearDirty(i);
+    size_t off = pg * this->pgsz;
+    size_t runlen = std::min(end * this->pgsz, this->size) - off;
+    mprotect(this->host + off, (end - pg) * this->pgsz, PROT_READ);
+    uint64_t req = ctx->asyncWriteMem(this->ve_addr + off, this->host + off,
+                                      runlen);
+    if (req == VEO_REQUEST_ID_INVALID) {
+      for (size_t i = pg; i < end; i++)
+        this->setDirty(i);
+      mprotect(this->host + off, (end - pg) * this->pgsz, PROT_READ | PROT_WRITE);
+      return -1;
+    }
+    this->transfers.fetch_add(1);
+    ups.push_back(Upload{shared_from_this(), req, pg, end});
+    queued += runlen;
+    pg = end;
+  }
+  VEO_TRACE("managed buffer %p: queued %lu bytes", this->host, queued);
+  return 0;
+}
+
+/**
+ * @brief finish a write queued by queueUpload()
+ *
+ * The pages of a failed write are marked dirty again, the next upload
+ * retries them. Called by VH commands of the progress threads, so it
+ * must not take mtx.
+ *
+ * @param up queued write
+ * @param ok true if the write succeeded
+ */
+void ManagedMem::uploadDone(const Upload &up, bool ok)
+{
+  if (!ok) {
+    VEO_ERROR("managed buffer %p: upload of pages %lu..%lu failed",
+              this->host, up.first, up.end - 1);
+    for (size_t i = up.first; i < up.end; i++)
+      this->setDirty(i);
+  }
+  this->transfers.fetch_sub(1);
+}
+
+/**
+ * @brief upload the dirty pages to the VE buffer and wait
+ *
+ * The writes go through the main context of the proc.
+ *
+ * @return 0 upon success; -1 upon failure.
+ */
+int ManagedMem::syncToVE()
+{
+  Context *ctx;
+  {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    if (this->proc == nullptr)
+      return -1;
+    ctx = this->proc->mainContext();
+  }
+  std::vector<Upload> ups;
+  int rc = this->queueUpload(ctx, ups);
+  for (auto &up : ups) {
+    uint64_t dummy;
+    bool ok = ctx->callWaitResult(up.req, &dummy) == VEO_COMMAND_OK;
+    this->uploadDone(up, ok);
+    if (!ok)
+      rc = -1;
+  }
+  return rc;
+}
+
+/**
+ * @brief queue the read of a range written by VE code into the shadow
+ *
+ * The pages of the range are writable until the read is done, the
+ * host must not write them meanwhile. The caller passes the result of
+ * the read to downloadDone().
+ *
+ * @param ctx context to queue the read on
+ * @param off offset in the buffer
+ * @param len length in byte, not 0
+ * @param[out] downs the queued read is appended
+ * @return 0 upon success; -1 upon failure or if the buffer was freed.
+ */
+int ManagedMem::queueDownload(Context *ctx, size_t off, size_t len,
+                              std::vector<Download> &downs)
+{
+  if (off > this->size || len == 0 || len > this->size - off)
+    return -1;
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->host == nullptr)
+    return -1;
+  size_t first = off / this->pgsz;
+  size_t last = (off + len - 1) / this->pgsz;
+  mprotect(this->host + first * this->pgsz, (last - first + 1) * this->pgsz,
+           PROT_READ | PROT_WRITE);
+  uint64_t req = ctx->asyncReadMem(this->host + off, this->ve_addr + off, len);
+  this->transfers.fetch_add(1);
+  Download d{shared_from_this(), req, off, len};
+  if (req == VEO_REQUEST_ID_INVALID) {
+    this->downloadDone(d, false);
+    return -1;
+  }
+  downs.push_back(std::move(d));
+  return 0;
+}
+
+/**
+ * @brief finish a read queued by queueDownload()
+ *
+ * Pages fully inside the range lose their host modifications,
+ * partially covered dirty pages stay dirty, clean pages are protected
+ * again. Upon failure the contents of the range are undefined. Called
+ * by VH commands of the progress threads, so it must not take mtx.
+ *
+ * @param d queued read
+ * @param ok true if the read succeeded
+ */
+void ManagedMem::downloadDone(const Download &d, bool ok)
+{
+  size_t first = d.off / this->pgsz;
+  size_t last = (d.off + d.len - 1) / this->pgsz;
+  for (size_t pg = first; pg <= last; pg++) {
+    size_t pstart = pg * this->pgsz;
+    bool covered = pstart >= d.off &&
+                   std::min(pstart + this->pgsz, this->size) <= d.off + d.len;
+    if (ok && covered)
+      this->clearDirty(pg);
+    if (!this->isDirty(pg))
+      mprotect(this->host + pstart, this->pgsz, PROT_READ);
+  }
+  this->transfers.fetch_sub(1);
+}
+
+/**
+ * @brief read a range written by VE code into the shadow and wait
+ *
+ * The read goes through the main context of the proc.
+ *
+ * @param off offset in the buffer
+ * @param len length in byte
+ * @return 0 upon success; -1 upon failure.
+ */
+int ManagedMem::syncFromVE(size_t off, size_t len)
+{
+  Context *ctx;
+  {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    if (this->proc == nullptr)
+      return -1;
+    ctx = this->proc->mainContext();
+  }
+  if (len == 0)
+    return off <= this->size ? 0 : -1;
+  std::vector<Download> downs;
+  if (this->queueDownload(ctx, off, len, downs) != 0)
+    return -1;
+  uint64_t dummy;
+  bool ok = ctx->callWaitResult(downs[0].req, &dummy) == VEO_COMMAND_OK;
+  this->downloadDone(downs[0], ok);
+  return ok ? 0 : -1;
+}
+
+/**
+ * @brief bytes which the next syncToVE() uploads
+ */
+size_t ManagedMem::dirtyBytes()
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->host == nullptr)
+    return 0;
+  size_t n = 0;
+  for (size_t pg = 0; pg < this->npages(); pg++)
+    if (this->isDirty(pg))
+      n += std::min((pg + 1) * this->pgsz, this->size) - pg * this->pgsz;
+  return n;
+}
+} // namespace veo
@@ -0,0 +1,118 @@
+/**
+ * @file ManagedMem.hpp
+ * @brief VH shadowed VE buffers with dirty page tracking
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * ManagedMem class definition.
+ */
+#ifndef _VEO_MANAGED_MEM_HPP_
+#define _VEO_MANAGED_MEM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define VEO_MAX_MANAGED 1024	// managed buffers at the same time
+
+namespace veo {
+
+class ProcHandle;
+class Context;
+
+/**
+ * @brief VE buffer with a VH shadow
+ *
+ * The VH shadow is mapped anonymously and write protected while it is
+ * in sync with the VE buffer. The first write to a protected page
+ * faults, the fault handler unprotects the page and marks it dirty.
+ * queueUpload() queues writes of the runs of dirty pages on a context
+ * and protects them again, syncToVE() does the same and waits.
+ * queueDownload() queues the read of a range written by VE code into
+ * the shadow without marking it dirty, syncFromVE() waits for it.
+ *
+ * Buffers are shared: the table of the API, call arguments and queued
+ * transfers hold references. release() frees the VE buffer and the
+ * shadow once the queued transfers are done, it is called when the
+ * buffer is freed or its proc exits. Later operations fail.
+ */
+class ManagedMem : public std::enable_shared_from_this<ManagedMem> {
+  ProcHandle *proc;		//!< nullptr after release()
+  char *host;			//!< VH shadow
+  size_t size;			//!< requested size
+  size_t len;			//!< mapped size, multiple of pgsz
+  size_t pgsz;
+  uint64_t ve_addr;		//!< VE buffer
+  int slot;			//!< index in the table for the fault handler
+  std::unique_ptr<std::atomic<uint64_t>[]> dirty;	//!< bit per page
+  std::mutex mtx;		//!< serializes syncs and release()
+  std::atomic<int> transfers;	//!< queued transfers not done yet
+
+  size_t npages() const { return this->len / this->pgsz; }
+  bool isDirty(size_t) const;
+  void setDirty(size_t);
+  void clearDirty(size_t);
+  ManagedMem(ProcHandle *, size_t);
+  void release();
+
+public:
+  /**
+   * @brief queued write of a run of dirty pages
+   */
+  struct Upload {
+    std::shared_ptr<ManagedMem> mem;
+    uint64_t req;		//!< write request
+    size_t first;		//!< first page of the run
+    size_t end;			//!< page after the run
+  };
+  /**
+   * @brief queued read of a range written by VE code
+   */
+  struct Download {
+    std::shared_ptr<ManagedMem> mem;
+    uint64_t req;		//!< read request
+    size_t off;			//!< offset of the range
+    size_t len;			//!< length of the range
+  };
+
+  ~ManagedMem();
+  ManagedMem(const ManagedMem &) = delete;
+  ManagedMem &operator=(const ManagedMem &) = delete;
+
+  void *hostAddr() { return this->host; }
+  size_t bufSize() { return this->size; }
+  uint64_t veAddr() { return this->ve_addr; }
+  ProcHandle *procHandle() { return this->proc; }
+  int queueUpload(Context *, std::vector<Upload> &);
+  void uploadDone(const Upload &, bool);
+  int queueDownload(Context *, size_t, size_t, std::vector<Download> &);
+  void downloadDone(const Download &, bool);
+  int syncToVE();
+  int syncFromVE(size_t, size_t);
+  size_t dirtyBytes();
+
+  static std::shared_ptr<ManagedMem> create(ProcHandle *, size_t);
+  static std::shared_ptr<ManagedMem> get(const void *);
+  static int remove(void *);
+  static void releaseProc(ProcHandle *);
+  static ManagedMem *find(const void *);
+  static bool onFault(void *);
+};
+} // namespace veo
+#endif
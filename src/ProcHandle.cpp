@@ -23,7 +23,9 @@
  * Copyright (c) 2020-2021 Erich Focht
  */
 #include <algorithm>
+#include <stdexcept>
 #include "ProcHandle.hpp"
+#include "ProcTable.hpp"
 #include "Context.hpp"
 #include "VEOException.hpp"
 #include "CallArgs.hpp"
@@ -32,9 +34,15 @@
 #include "veo_urpc.h"
 #include "veo_urpc_vh.hpp"
 #include "veo_time.h"
+#include "veo_vhveshm.h"
+#include "veo_get_arch_info.h"
+#include "veo_hmem_macros.h"
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 #include <sys/auxv.h>
 #include <sys/ipc.h>
 #include <sys/mman.h>
@@ -45,58 +53,94 @@
 
 namespace veo {
 
-// remember active procs for the destructor
-//   This needs to be a pointer with memory allocated later, otherwise
-//   py-veo (cython?) erases the content and we have leftover VE processes
-std::vector<ProcHandle *> *__procs;
-std::mutex __procs_mtx;
+// from <numaif.h>, avoid depending on libnuma
+#define VEO_MPOL_PREFERRED 1
+#define VEO_MPOL_MF_MOVE (1 << 1)
 
 /**
- * @brief Get VE process identifier for a proc
- * @return VE process identifier upon success; negative upon failure.
+ * @brief set the preferred NUMA node of a VH memory range
+ *
+ * Pages touched already are migrated, the rest is allocated on
+ * the node when first touched.
+ *
+ * @param addr start of the range, page aligned
+ * @param len length of the range
+ * @param node NUMA node, negative for no binding
+ * @return 0 upon success; -1 upon failure or if node is negative.
  */
-int _getProcIdentifier(ProcHandle *proc)
+static int _mbindNode(void *addr, size_t len, int node)
 {
-  std::lock_guard<std::mutex> lock(veo::__procs_mtx);
-  //std::lock_guard<std::mutex> lock2(this->mctx->submit_mtx);
-
-  // Get element number of this pointer included in veo::__procs.
-  std::vector<ProcHandle *>::iterator itr;
-  itr = std::find(veo::__procs->begin(), veo::__procs->end(), proc);
-  if (itr == veo::__procs->end()) {
-    VEO_ERROR("Search failed.");
+  if (node < 0)
+    return -1;
+  unsigned long mask[16] = {0};
+  if ((size_t)node >= sizeof(mask) * 8)
+    return -1;
+  mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+  if (syscall(SYS_mbind, addr, len, VEO_MPOL_PREFERRED,
+              mask, sizeof(mask) * 8, VEO_MPOL_MF_MOVE) != 0) {
+    VEO_DEBUG("failed to bind %p to NUMA node %d: %s",
+              addr, node, strerror(errno));
     return -1;
   }
-  const int idx = std::distance(veo::__procs->begin(), itr);
-  VEO_TRACE("proc %p identifier = %d", (void *)proc, idx);
-  return idx;
+  return 0;
 }
-  
+
 /**
- * @brief Get VE process identifier for a proc with nolock
- * @return VE process identifier upon success; negative upon failure.
+ * @brief place the VE-URPC buffers of a peer on a NUMA node
+ *
+ * Must be called before the VE side attaches the segment, shared
+ * pages are not migrated.
+ *
+ * @param up VH side urpc peer
+ * @param node NUMA node, negative for no binding
  */
-int _getProcIdentifierNolock(ProcHandle *proc)
+static void _bindPeerToNode(urpc_peer_t *up, int node)
 {
-  // Get element number of this pointer included in veo::__procs.
-  std::vector<ProcHandle *>::iterator itr;
-  itr = std::find(veo::__procs->begin(), veo::__procs->end(), proc);
-  if (itr == veo::__procs->end()) {
-    VEO_ERROR("Search failed.");
-    return -1;
-  }
-  const int idx = std::distance(veo::__procs->begin(), itr);
-  VEO_TRACE("proc %p identifier = %d", (void *)proc, idx);
-  return idx;
+  if (_mbindNode(up->shm_addr, up->shm_size, node) == 0)
+    VEO_DEBUG("VE-URPC segment %p bound to NUMA node %d", up->shm_addr, node);
 }
-  
+
+/**
+ * @brief allocate a VH staging buffer on a NUMA node
+ *
+ * The buffer is mapped anonymously and bound before it is touched,
+ * so its pages come from the node. If binding fails the buffer is
+ * used unbound.
+ *
+ * @param len size in byte
+ * @param node NUMA node, negative for no binding
+ * @return pointer to the buffer; nullptr upon failure.
+ */
+void *allocOnNode(size_t len, int node)
+{
+  void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return nullptr;
+  _mbindNode(p, len, node);
+  return p;
+}
+
+/**
+ * @brief free a buffer allocated by allocOnNode()
+ *
+ * @param p pointer to the buffer, may be nullptr
+ * @param len size passed to allocOnNode()
+ */
+void freeOnNode(void *p, size_t len)
+{
+  if (p != nullptr)
+    munmap(p, len);
+}
+
 /**
  * @brief constructor
  *
  * @param venode VE node ID for running child peer
  * @param binname VE executable
  */
-ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival(false)
+ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival(false),
+                                                     proc_ident(-1)
 {
   // create vh side peer
   this->up = vh_urpc_peer_create();
@@ -104,6 +148,14 @@ ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival
     throw VEOException("ProcHandle: failed to create VH side urpc peer.");
   }
 
+  // place VE-URPC buffers on the NUMA node closest to the VE,
+  // VEO_NUMA_NODE overrides, a negative value disables binding
+  const char *numa = getenv("VEO_NUMA_NODE");
+  this->numa_node = numa ? atoi(numa) : veo_numa_node_sysfs(venode);
+  if (this->numa_node < 0)
+    this->numa_node = -1;
+  _bindPeerToNode(this->up, this->numa_node);
+
   int vecore = -1;
   const char *e = getenv("VE_CORE_NUMBER");
   if (e != nullptr) {
@@ -125,6 +177,7 @@ ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival
   this->proc_survival = true;
 
   this->mctx = new Context(this, this->up, true);
+  this->mctx->numa_node = this->numa_node;
 
   this->mctx->getStackPointer(&this->ve_sp);
   VEO_DEBUG("proc stack pointer: %p", (void *)this->ve_sp);
@@ -140,27 +193,30 @@ ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival
   this->mctx->core = vecore;
   this->ve_number = venode;
 
-  std::lock_guard<std::mutex> lock(veo::__procs_mtx);
-  if (veo::__procs == nullptr) {
-    veo::__procs = new std::vector<ProcHandle *>();
-    veo::__procs->push_back(this);
-    VEO_DEBUG("Create new std::vector<ProcHandle *>");
-    return;
-  }
+  // optional copy workers for received data (VEO_RECV_COPY_THREADS),
+  // pinned to the NUMA node of the VE-URPC buffers
+  if (this->copy_pool.init(CopyPool::memNode(this->up->shm_addr)) < 0)
+    VEO_ERROR("failed to start receive copy workers");
+
+  // optional VH side sub-allocation of VE memory (VEO_ARENA_CHUNK)
+  this->arena.init(this, 0);
 
-  // Reuse veo::__procs to identify VE processes.
-  std::vector<ProcHandle *>::iterator itr;
-  itr = std::find(veo::__procs->begin(), veo::__procs->end(), nullptr);
-  if (itr == veo::__procs->end()) {
-    veo::__procs->push_back(this);
-    VEO_DEBUG("Added new ProcHandle pointer to veo::__prcos");
-    return;
+  // optional calibration of transfer fragment sizes (VEO_XFER_CALIBRATE)
+  this->xfer_tuning.init(this->mctx, venode, urpc_max_send_cmd_size(this->up));
+
+  // optional striping of large transfers (VEO_XFER_CHANNELS)
+  e = getenv("VEO_XFER_CHANNELS");
+  if (e != nullptr && this->setXferChannels(atoi(e)) < 0)
+    VEO_ERROR("failed to set up %s transfer channels", e);
+
+  // register the proc under the lowest free VE process identifier,
+  // the table also finds the procs for the cleanup at exit
+  this->proc_ident = ProcTable::insert(this);
+  if (this->proc_ident < 0) {
+    this->exitProc();
+    throw VEOException("ProcHandle: too many procs.", EAGAIN);
   }
-  // Find the nullptr element and calculate the element number.
-  const int idx = std::distance(veo::__procs->begin(), itr);
-  VEO_DEBUG("Element number of the destroyed proc = %d", idx);
-  veo::__procs->at(idx) = this;
-  VEO_DEBUG("Added veo::__procs->at(%d) = %p", idx, veo::__procs->at(idx));
+  VEO_DEBUG("proc %p identifier = %d", (void *)this, this->proc_ident);
 }
 
 /**
@@ -169,7 +225,9 @@ ProcHandle::ProcHandle(int venode, char *binname) : ve_number(-1), proc_survival
  */
 int ProcHandle::getProcIdentifier()
 {
-  return veo::_getProcIdentifier(this);
+  if (this->proc_ident < 0)
+    VEO_ERROR("proc %p has no VE process identifier", (void *)this);
+  return this->proc_ident;
 }
 
 /**
@@ -178,33 +236,56 @@ int ProcHandle::getProcIdentifier()
  */
 int ProcHandle::numProcs()
 {
-  std::lock_guard<std::mutex> lock(veo::__procs_mtx);
-  return veo::__procs->size();
+  return ProcTable::count();
 }
 
 /**
  * @brief Get process handle
+ *
+ * Wait-free lookup in the table of VE process identifiers. Callers
+ * using the proc must hold a ProcTable::ReadGuard, so the proc is not
+ * torn down under them.
+ *
  * @return a pointer to ProcHandle upon success; nullptr upon failure.
+ * @throw std::out_of_range for an invalid identifier
  */
 ProcHandle *ProcHandle::getProcHandle(int proc_ident)
 {
-  std::lock_guard<std::mutex> lock(veo::__procs_mtx);
-  return veo::__procs->at(proc_ident);
+  if (proc_ident < 0 || proc_ident >= VEO_MAX_HMEM_PROCS)
+    throw std::out_of_range("invalid VE process identifier");
+  return ProcTable::get(proc_ident);
 }
 
 /**
  * @brief Exit a proc
  *
  * This function first closes all but the main context, then closes
- * the main context of a proc handle. Finally it removes the proc
- * pointer from the vector keeping track of procs for the final cleanup.
+ * the main context of a proc handle. The proc is removed from the proc
+ * table first, HMEM operations which found it there are finished
+ * before the teardown starts. Must not be called while holding a
+ * ProcTable::ReadGuard.
  */
 int ProcHandle::exitProc()
 {
   int rc;
-  std::lock_guard<std::mutex> procslock(__procs_mtx);
+  if (this->proc_ident >= 0) {
+    ProcTable::remove(this->proc_ident);
+    this->proc_ident = -1;
+  }
   std::lock_guard<std::mutex> ctxlock(ctx_mutex);
   VEO_TRACE("proc %p", (void *)this);
+  // managed buffers are freed while the contexts finish their uploads
+  ManagedMem::releaseProc(this);
+  this->mem_stats.report(this->getPid());
+  //
+  // close hidden transfer contexts
+  //
+  {
+    std::lock_guard<std::mutex> xlock(this->xfer_mtx);
+    for (auto &c : this->xfer_ctx)
+      c->close();
+    this->xfer_ctx.clear();
+  }
   //
   // delete all open contexts except the main one
   //
@@ -221,15 +302,12 @@ int ProcHandle::exitProc()
     VEO_ERROR("main context close failed (rc=%d)\n"
               "Please check for leftover VE procs.", rc);
   }
+  this->copy_pool.finish();
   this->ve_number = -1;
-  for (auto p = veo::__procs->begin(); p != veo::__procs->end(); p++) {
-    if (*p == this) {
-      VEO_DEBUG("erasing proc %lx", this);
-      //veo::__procs->erase(p);
-      // replace this obj pointer to nullptr
-      veo::__procs->at(_getProcIdentifierNolock(this)) = nullptr;
-      break;
-    }
+  {
+    // VHSHM attachments vanish with the VE process
+    std::lock_guard<std::mutex> hmlock(this->hostmem_mtx);
+    this->hostmem.clear();
   }
   return 0;
 }
@@ -374,6 +452,179 @@ void ProcHandle::freeBuff(const uint64_t buff)
   VEO_TRACE("end");
 }
 
+/**
+ * @brief Allocate a VE buffer for the user
+ *
+ * Small buffers come from the arena if it is enabled, without a round
+ * trip to the VE, everything else from the VE process.
+ *
+ * @param size of buffer
+ * @return VEMVA of the buffer upon success; zero upon failure.
+ */
+uint64_t ProcHandle::allocMem(const size_t size)
+{
+  uint64_t addr = this->arena.alloc(size);
+  if (addr == 0)
+    addr = this->allocBuff(size);
+  this->mem_stats.add(addr, size);
+  return addr;
+}
+
+/**
+ * @brief Allocate a VE buffer with placement requirements
+ *
+ * Plain requests are served by allocMem(), all others by the VE
+ * process.
+ *
+ * @param size of buffer
+ * @param flags VEO_ALLOC_* flags
+ * @param alignment power of 2, 0 for the default alignment
+ * @return VEMVA of the buffer upon success; zero upon failure.
+ */
+uint64_t ProcHandle::allocMemEx(const size_t size, uint64_t flags,
+                                size_t alignment)
+{
+  VEO_TRACE("size=%lu flags=%lx alignment=%lu", size, flags, alignment);
+  if (flags == 0 && alignment <= 16)
+    return this->allocMem(size);
+  uint64_t uflags = 0;
+  if (flags & VEO_ALLOC_HUGEPAGE)
+    uflags |= URPC_ALLOC_HUGEPAGE;
+  if (flags & VEO_ALLOC_PREFAULT)
+    uflags |= URPC_ALLOC_PREFAULT;
+  auto req = this->mctx->genericAsyncReq(URPC_CMD_ALLOC_EX, (char *)"LLL",
+                                         size, uflags, alignment);
+  uint64_t addr = 0;
+  auto rv = this->mctx->callWaitResult(req, &addr);
+  if (rv != VEO_COMMAND_OK) {
+    VEO_ERROR("rv=%d", rv);
+    addr = 0;
+  }
+  VEO_TRACE("returned addr 0x%lx", addr);
+  this->mem_stats.add(addr, size);
+  return addr;
+}
+
+/**
+ * @brief Free a VE buffer allocated by allocMem()
+ *
+ * @param buff VEMVA of the buffer
+ */
+void ProcHandle::freeMem(const uint64_t buff)
+{
+  this->mem_stats.remove(buff);
+  if (!this->arena.free(buff))
+    this->freeBuff(buff);
+}
+
+/**
+ * @brief Allocate several VE buffers for the user
+ *
+ * Buffers which do not come from the arena are allocated by the VE
+ * with one request per Context::maxAllocV() buffers. Upon failure no
+ * buffer stays allocated.
+ *
+ * @param n number of buffers
+ * @param sizes buffer sizes
+ * @param[out] addrs VEMVAs of the buffers
+ * @return zero upon success; -1 upon failure.
+ */
+int ProcHandle::allocMemMulti(int n, const size_t *sizes, uint64_t *addrs)
+{
+  VEO_TRACE("n=%d", n);
+  std::vector<int> idx;		// buffers to be allocated by the VE
+  for (int i = 0; i < n; i++) {
+    addrs[i] = this->arena.alloc(sizes[i]);
+    if (addrs[i] == 0)
+      idx.push_back(i);
+    else
+      this->mem_stats.add(addrs[i], sizes[i]);
+  }
+  std::vector<uint64_t> veaddrs(idx.size(), 0);
+  std::vector<uint64_t> reqs;
+  size_t maxv = this->mctx->maxAllocV();
+  for (size_t off = 0; off < idx.size(); off += maxv) {
+    size_t cnt = std::min(idx.size() - off, maxv);
+    std::vector<uint64_t> sz(cnt);
+    for (size_t j = 0; j < cnt; j++)
+      sz[j] = sizes[idx[off + j]];
+    reqs.push_back(this->mctx->allocMultiAsync(std::move(sz), &veaddrs[off],
+                                               VEO_REQUEST_ID_INVALID));
+  }
+  int rc = 0;
+  for (auto req : reqs) {
+    uint64_t dummy;
+    if (req == VEO_REQUEST_ID_INVALID ||
+        this->mctx->callWaitResult(req, &dummy) != VEO_COMMAND_OK)
+      rc = -1;
+  }
+  for (size_t j = 0; j < idx.size(); j++)
+    addrs[idx[j]] = veaddrs[j];
+  if (rc != 0) {
+    VEO_ERROR("failed to allocate %d buffers", n);
+    std::vector<uint64_t> allocated;
+    for (int i = 0; i < n; i++)
+      if (addrs[i] != 0)
+        allocated.push_back(addrs[i]);
+    this->freeMemMulti(allocated.size(), allocated.data());
+    std::fill(addrs, addrs + n, 0);
+  }
+  return rc;
+}
+
+/**
+ * @brief Free several VE buffers allocated by allocMem() or allocMemMulti()
+ *
+ * @param n number of buffers
+ * @param addrs VEMVAs of the buffers
+ * @return zero upon success; -1 upon failure.
+ */
+int ProcHandle::freeMemMulti(int n, const uint64_t *addrs)
+{
+  VEO_TRACE("n=%d", n);
+  std::vector<uint64_t> veaddrs;
+  for (int i = 0; i < n; i++) {
+    this->mem_stats.remove(addrs[i]);
+    if (addrs[i] != 0 && !this->arena.free(addrs[i]))
+      veaddrs.push_back(addrs[i]);
+  }
+  std::vector<uint64_t> reqs;
+  size_t maxv = this->mctx->maxAllocV();
+  for (size_t off = 0; off < veaddrs.size(); off += maxv) {
+    size_t cnt = std::min(veaddrs.size() - off, maxv);
+    std::vector<uint64_t> a(veaddrs.begin() + off, veaddrs.begin() + off + cnt);
+    reqs.push_back(this->mctx->freeMultiAsync(std::move(a),
+                                              VEO_REQUEST_ID_INVALID));
+  }
+  int rc = 0;
+  for (auto req : reqs) {
+    uint64_t dummy;
+    if (req == VEO_REQUEST_ID_INVALID ||
+        this->mctx->callWaitResult(req, &dummy) != VEO_COMMAND_OK)
+      rc = -1;
+  }
+  return rc;
+}
+
+/**
+ * @brief Release VE buffers cached by the VE side allocator
+ *
+ * @param keep number of bytes which may stay cached
+ * @return number of bytes released; negative upon failure.
+ */
+int64_t ProcHandle::trimMem(size_t keep)
+{
+  VEO_TRACE("keep %lu", keep);
+  auto req = this->mctx->genericAsyncReq(URPC_CMD_TRIM, (char *)"L", keep);
+  uint64_t released = 0;
+  auto rv = this->mctx->callWaitResult(req, &released);
+  if (rv != VEO_COMMAND_OK) {
+    VEO_ERROR("rv=%d", rv);
+    return -1;
+  }
+  return (int64_t)released;
+}
+
 /**
  * @brief read data from VE memory
  * @param[out] dst buffer to store the data
@@ -499,11 +750,14 @@ void ProcHandle::delContextNolock(Context *ctx)
 /**
  * @brief open a new context (VE thread)
  *
+ * @param stack_sz stack size of the VE thread
+ * @param node NUMA node of the VE-URPC buffers of the context
  * @return a new thread context created
  *
- * The first context returned is the this->mctx!
+ * The first context returned is the this->mctx! Its buffers were
+ * placed when the proc was created, node is ignored for it.
  */
-Context *ProcHandle::openContext(size_t stack_sz)
+Context *ProcHandle::openContext(size_t stack_sz, int node)
 {
   std::lock_guard<std::mutex> ctxlock(ctx_mutex);
   std::lock_guard<std::recursive_mutex> lock(this->mctx->submit_mtx);
@@ -530,11 +784,35 @@ Context *ProcHandle::openContext(size_t stack_sz)
   }
   VEO_DEBUG("core = %d, prev_core = %d, ve_omp_threads = %d", core, prev_core, ve_omp_threads);
 
+  auto new_ctx = this->_newPeerContext(core, stack_sz, node);
+  if (new_ctx == nullptr)
+    return nullptr;
+  this->ctx.push_back(std::unique_ptr<Context>(new_ctx));
+  return new_ctx;
+}
+
+/**
+ * @brief start a new VE handler thread and create its context
+ *
+ * The caller must hold the submit mutex of the main context and make
+ * sure no requests are in flight on it, since NEWPEER is sent directly.
+ *
+ * @param core VE core to pin the handler thread to, -1 for none
+ * @param stack_sz stack size of the VE thread
+ * @param node NUMA node of the VE-URPC buffers, VEO_NUMA_NODE_AUTO for
+ *        the node of the proc, VEO_NUMA_NODE_NONE for no binding
+ * @return a new thread context; nullptr upon failure.
+ */
+Context *ProcHandle::_newPeerContext(int core, size_t stack_sz, int node)
+{
   // create vh side peer
   auto new_up = vh_urpc_peer_create();
   if (new_up == nullptr) {
     throw VEOException("ProcHandle: failed to create new VH side urpc peer.");
   }
+  if (node == VEO_NUMA_NODE_AUTO)
+    node = this->numa_node;
+  _bindPeerToNode(new_up, node);
 
   // start another thread inside peer proc that attaches to the new up
   auto req = urpc_generic_send(this->up, URPC_CMD_NEWPEER, (char *)"IIL",
@@ -561,6 +839,7 @@ Context *ProcHandle::openContext(size_t stack_sz)
   }
 
   auto new_ctx = new Context(this, new_up, false);
+  new_ctx->numa_node = node < 0 ? -1 : node;
 
   new_ctx->getStackPointer(&new_ctx->ve_sp);
   VEO_DEBUG("proc stack pointer: %p", (void *)new_ctx->ve_sp);
@@ -570,12 +849,103 @@ Context *ProcHandle::openContext(size_t stack_sz)
     throw VEOException("ProcHandle: failed to initialize progress thread.");
   }
   new_ctx->core = core;
-  this->ctx.push_back(std::unique_ptr<Context>(new_ctx));
 
   new_ctx->state = VEO_STATE_RUNNING;
   return new_ctx;
 }
 
+/**
+ * @brief set the number of channels used for large transfers
+ *
+ * Transfers of at least 8MB are striped over the calling context and
+ * n - 1 hidden transfer contexts, each with its own VE-URPC channel
+ * and VE handler thread. The hidden contexts are not pinned and are
+ * not visible through getContext().
+ *
+ * Changing the number of channels while striped transfers are pending
+ * makes them fail.
+ *
+ * @param n number of channels, 1 disables striping
+ * @return the number of channels upon success; -1 upon failure.
+ */
+int ProcHandle::setXferChannels(int n)
+{
+  if (n < 1 || n > VEO_MAX_XFER_CHANNELS) {
+    VEO_ERROR("number of transfer channels must be 1..%d", VEO_MAX_XFER_CHANNELS);
+    return -1;
+  }
+  std::vector<std::shared_ptr<Context>> unused;
+  std::lock_guard<std::mutex> ctxlock(ctx_mutex);
+  {
+    std::lock_guard<std::mutex> xlock(this->xfer_mtx);
+    while (this->xfer_ctx.size() > (size_t)(n - 1)) {
+      unused.push_back(this->xfer_ctx.back());
+      this->xfer_ctx.pop_back();
+    }
+  }
+  for (auto &c : unused) {
+    c->synchronize();
+    c->close();
+  }
+  while (this->numXferChannels() < n) {
+    auto c = this->_openHiddenContext();
+    if (c == nullptr)
+      return -1;
+    std::lock_guard<std::mutex> xlock(this->xfer_mtx);
+    this->xfer_ctx.push_back(c);
+  }
+  VEO_DEBUG("proc %p uses %d transfer channels", (void *)this, n);
+  return n;
+}
+
+/**
+ * @brief open a hidden context, the caller must hold ctx_mutex
+ */
+std::shared_ptr<Context> ProcHandle::_openHiddenContext()
+{
+  Context *c;
+  {
+    std::lock_guard<std::recursive_mutex> lock(this->mctx->submit_mtx);
+    this->mctx->synchronize();
+    c = this->_newPeerContext(-1, VEO_STACK_MIN);
+  }
+  return std::shared_ptr<Context>(c);
+}
+
+/**
+ * @brief open a context not visible through getContext()
+ *
+ * The context has its own VE-URPC channel and VE handler thread. It is
+ * closed by the caller with Context::close().
+ *
+ * @return a new context; nullptr upon failure.
+ */
+std::shared_ptr<Context> ProcHandle::openHiddenContext()
+{
+  std::lock_guard<std::mutex> ctxlock(ctx_mutex);
+  return this->_openHiddenContext();
+}
+
+/**
+ * @brief number of channels used for large transfers
+ */
+int ProcHandle::numXferChannels()
+{
+  std::lock_guard<std::mutex> xlock(this->xfer_mtx);
+  return this->xfer_ctx.size() + 1;
+}
+
+/**
+ * @brief hidden transfer contexts
+ *
+ * @return copy of the list, keeps the contexts alive while in use
+ */
+std::vector<std::shared_ptr<Context>> ProcHandle::xferContexts()
+{
+  std::lock_guard<std::mutex> xlock(this->xfer_mtx);
+  return this->xfer_ctx;
+}
+
 void ProcHandle::accessPciRecvSyncRegister()
 {
   std::lock_guard<std::mutex> ctxlock(ctx_mutex);
@@ -657,6 +1027,158 @@ void* ProcHandle::veMemcpy(void *dst, const void *src, size_t size)
   }
   return 0;
 }
+
+/**
+ * @brief find the System V shm segment containing a VH address
+ *
+ * @param addr VH address
+ * @param[out] start start address of the attached segment
+ * @param[out] shmid shm identifier of the segment
+ * @return 0 if found, -1 if addr is not inside a SysV shm segment.
+ *
+ * SysV shm attachments show up in /proc/self/maps as "/SYSV<key>"
+ * mappings with the shm identifier in the inode field.
+ */
+static int _findSysvSegment(uint64_t addr, uint64_t *start, int *shmid)
+{
+  FILE *fp = fopen("/proc/self/maps", "r");
+  if (fp == nullptr)
+    return -1;
+  char line[512];
+  int rc = -1;
+  while (fgets(line, sizeof(line), fp)) {
+    uint64_t s, e, off, ino;
+    unsigned int dmaj, dmin;
+    char perms[8], path[256];
+    path[0] = '\0';
+    if (sscanf(line, "%lx-%lx %7s %lx %x:%x %lu %255s", &s, &e, perms,
+               &off, &dmaj, &dmin, &ino, path) < 7)
+      continue;
+    if (addr < s || addr >= e)
+      continue;
+    if (strncmp(path, "/SYSV", 5) == 0) {
+      *start = s - off;
+      *shmid = (int)ino;
+      rc = 0;
+    }
+    break;
+  }
+  fclose(fp);
+  return rc;
+}
+
+/**
+ * @brief find a registered VH region containing [addr, addr + size)
+ *
+ * Caller must hold hostmem_mtx.
+ */
+std::map<uint64_t, HostMemRegion>::iterator
+ProcHandle::_findHostMemNolock(uint64_t addr, size_t size)
+{
+  auto it = this->hostmem.upper_bound(addr);
+  if (it == this->hostmem.begin())
+    return this->hostmem.end();
+  --it;
+  if (addr + size <= it->first + it->second.size)
+    return it;
+  return this->hostmem.end();
+}
+
+/**
+ * @brief register VH memory for direct VE DMA transfers
+ *
+ * The memory must be inside a System V shared memory segment allocated
+ * with SHM_HUGETLB. The whole segment is attached to the VE process by
+ * VHSHM and stays attached until its last registration is dropped, so
+ * registering buffers that are reused is cheap.
+ *
+ * @param ptr VH address
+ * @param size size of the buffer
+ * @return 0 upon success; -1 upon failure.
+ */
+int ProcHandle::registerHostMem(void *ptr, size_t size)
+{
+  uint64_t addr = (uint64_t)ptr;
+  std::lock_guard<std::mutex> lock(this->hostmem_mtx);
+
+  auto it = this->_findHostMemNolock(addr, size);
+  if (it != this->hostmem.end()) {
+    it->second.refcnt++;
+    VEO_TRACE("%p already registered, refcnt=%d", ptr, it->second.refcnt);
+    return 0;
+  }
+
+  uint64_t start;
+  int shmid;
+  if (_findSysvSegment(addr, &start, &shmid) != 0) {
+    VEO_ERROR("%p is not inside a System V shm segment", ptr);
+    return -1;
+  }
+  struct shmid_ds ds;
+  if (shmctl(shmid, IPC_STAT, &ds) != 0) {
+    VEO_ERROR("shmctl(%d) failed: %s", shmid, strerror(errno));
+    return -1;
+  }
+  if (addr + size > start + ds.shm_segsz) {
+    VEO_ERROR("buffer %p size %lu exceeds shm segment", ptr, size);
+    return -1;
+  }
+  void *vehva = nullptr;
+  void *shmaddr = veo_shmat(this->toCHandle(), shmid, nullptr, 0, &vehva);
+  if (shmaddr == (void *)-1) {
+    VEO_ERROR("veo_shmat(%d) failed: %s", shmid, strerror(errno));
+    return -1;
+  }
+  HostMemRegion reg = { ds.shm_segsz, shmid, shmaddr, (uint64_t)vehva, 1 };
+  this->hostmem[start] = reg;
+  VEO_DEBUG("registered shm %d at %lx size %lu vehva %p", shmid, start,
+            ds.shm_segsz, vehva);
+  return 0;
+}
+
+/**
+ * @brief drop a registration of VH memory
+ *
+ * @param ptr VH address which was passed to registerHostMem()
+ * @return 0 upon success; -1 upon failure.
+ */
+int ProcHandle::unregisterHostMem(void *ptr)
+{
+  std::lock_guard<std::mutex> lock(this->hostmem_mtx);
+
+  auto it = this->_findHostMemNolock((uint64_t)ptr, 1);
+  if (it == this->hostmem.end()) {
+    VEO_ERROR("%p is not registered", ptr);
+    return -1;
+  }
+  if (--it->second.refcnt > 0)
+    return 0;
+  int rc = veo_shmdt(this->toCHandle(), it->second.shmaddr);
+  if (rc)
+    VEO_ERROR("veo_shmdt failed: %s", strerror(errno));
+  this->hostmem.erase(it);
+  return rc;
+}
+
+/**
+ * @brief look up registered VH memory
+ *
+ * @param ptr VH address
+ * @param size size of the buffer
+ * @param[out] vehva VEHVA corresponding to ptr
+ * @return true if the whole buffer is inside a registered region.
+ */
+bool ProcHandle::findHostMem(const void *ptr, size_t size, uint64_t *vehva)
+{
+  std::lock_guard<std::mutex> lock(this->hostmem_mtx);
+  if (this->hostmem.empty())
+    return false;
+  auto it = this->_findHostMemNolock((uint64_t)ptr, size);
+  if (it == this->hostmem.end())
+    return false;
+  *vehva = it->second.vehva + ((uint64_t)ptr - it->first);
+  return true;
+}
 } // namespace veo
 
 //
@@ -666,18 +1188,6 @@ void* ProcHandle::veMemcpy(void *dst, const void *src, size_t size)
 __attribute__((destructor))
 static void _cleanup_procs(void)
 {
-  if (!veo::__procs)
-    return;
-  for (auto it = veo::__procs->begin(); it != veo::__procs->end();) {
-    // we don't increment the iterator because erase() is actually
-    // doing the remove.
-    if (*it) {
-      (*it)->exitProc();
-      veo::__procs->erase(it);
-    } else {
-      VEO_DEBUG("proc destructor: proc pointer is NULL!");
-      it++;
-    }
-  }
-  delete veo::__procs;
+  for (auto p : veo::ProcTable::snapshot())
+    p->exitProc();
 }
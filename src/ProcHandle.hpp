@@ -25,6 +25,7 @@
 #ifndef _VEO_PROC_HANDLE_HPP_
 #define _VEO_PROC_HANDLE_HPP_
 #include <unordered_map>
+#include <map>
 #include <utility>
 #include <memory>
 #include <mutex>
@@ -34,6 +35,10 @@
 #include <ve_offload.h>
 #include "CallArgs.hpp"
 #include "Context.hpp"
+#include "XferTuning.hpp"
+#include "CopyPool.hpp"
+#include "VeArena.hpp"
+#include "VeMemStats.hpp"
 #include "VEOException.hpp"
 
 namespace std {
@@ -48,8 +53,19 @@ namespace std {
 
 namespace veo {
 
-  int _getProcIdentifier(ProcHandle *);
-  int _getProcIdentifierNolock(ProcHandle *);
+/**
+ * @brief VH memory registered for direct VE DMA
+ *
+ * A registered region is a System V shared memory segment on VH which
+ * is attached to the VE process with VHSHM (veo_shmat()).
+ */
+struct HostMemRegion {
+  size_t size;				//!< size of the shm segment
+  int shmid;				//!< shm identifier on VH
+  void *shmaddr;			//!< address returned by veo_shmat()
+  uint64_t vehva;			//!< VEHVA of the start of the segment
+  int refcnt;				//!< number of registrations
+};
 
 /**
  * @brief VEO process handle
@@ -66,8 +82,21 @@ private:
   Context *mctx;			//!< context also used for sync proc ops
   std::vector<std::unique_ptr<Context>> ctx;	//!< vector of opened contexts
   int ve_number;			//!< store the VE number
+  int numa_node;			//!< NUMA node of VE-URPC buffers, -1: not bound
   std::unordered_map<const char *, uint64_t> ve2velibh; //!< library handle for VE2VE communication
   bool proc_survival;
+  int proc_ident;			//!< VE process identifier of HMEM addresses, -1: none
+  std::map<uint64_t, HostMemRegion> hostmem; //!< registered VH memory, key is segment start
+  std::mutex hostmem_mtx;               //!< protects hostmem
+  XferTuning xfer_tuning;               //!< calibrated transfer fragmentation
+  CopyPool copy_pool;                   //!< workers copying received data
+  VeArena arena;                        //!< VH side sub-allocator of VE memory
+  VeMemStats mem_stats;                 //!< live VE buffers of the user
+  std::vector<std::shared_ptr<Context>> xfer_ctx; //!< hidden transfer contexts
+  std::mutex xfer_mtx;                  //!< protects xfer_ctx
+  Context *_newPeerContext(int, size_t, int node = VEO_NUMA_NODE_AUTO);
+  std::shared_ptr<Context> _openHiddenContext(void);
+  std::map<uint64_t, HostMemRegion>::iterator _findHostMemNolock(uint64_t, size_t);
 
 public:
   ProcHandle(int, char *);
@@ -80,6 +109,14 @@ public:
 
   uint64_t allocBuff(const size_t);
   void freeBuff(const uint64_t);
+  int64_t trimMem(size_t);
+  uint64_t allocMem(const size_t);
+  uint64_t allocMemEx(const size_t, uint64_t, size_t);
+  void freeMem(const uint64_t);
+  int allocMemMulti(int, const size_t *, uint64_t *);
+  int freeMemMulti(int, const uint64_t *);
+  VeArena *veArena() { return &this->arena; }
+  VeMemStats *memStats() { return &this->mem_stats; }
 
   int readMem(void *, uint64_t, size_t);
   int writeMem(uint64_t, const void *, size_t);
@@ -93,7 +130,9 @@ public:
   int callSync(uint64_t, CallArgs &, uint64_t *);
 
   Context *mainContext() { return this->mctx; };
-  Context *openContext(size_t stack_sz = VEO_DEFAULT_STACKSIZE);
+  Context *openContext(size_t stack_sz = VEO_DEFAULT_STACKSIZE,
+                       int node = VEO_NUMA_NODE_AUTO);
+  int numaNode() { return this->numa_node; }
   void delContext(Context *);
   void delContextNolock(Context *);
 
@@ -114,6 +153,15 @@ public:
  };
   pid_t getPid(void) { return up->child_pid; };
   void *veMemcpy(void *dst, const void *src, size_t size);
+  int registerHostMem(void *, size_t);
+  int unregisterHostMem(void *);
+  bool findHostMem(const void *, size_t, uint64_t *);
+  XferTuning *xferTuning() { return &this->xfer_tuning; }
+  CopyPool *copyPool() { return &this->copy_pool; }
+  int setXferChannels(int);
+  int numXferChannels(void);
+  std::vector<std::shared_ptr<Context>> xferContexts(void);
+  std::shared_ptr<Context> openHiddenContext(void);
   bool getProcSurvival(void) { return this->proc_survival; };
   void setProcSurvival(bool flg) { this->proc_survival = flg; };
 };
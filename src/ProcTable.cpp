@@ -0,0 +1,168 @@
+/**
+ * @file ProcTable.cpp
+ * @brief table of the open procs, indexed by VE process identifier
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * ProcTable methods implementation.
+ */
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+#include "ProcTable.hpp"
+#include "veo_hmem_macros.h"
+#include "log.h"
+
+#define PROC_TABLE_SHARDS 16
+
+namespace veo {
+
+namespace {
+// All state has static storage and trivial destructors, it stays
+// valid for the proc cleanup at program exit.
+std::atomic<ProcHandle *> table[VEO_MAX_HMEM_PROCS];
+
+// readers inside a critical section, by epoch parity and shard
+struct alignas(64) ReaderCount {
+  std::atomic<long> n;
+};
+ReaderCount readers[2][PROC_TABLE_SHARDS];
+std::atomic<uint64_t> epoch;
+std::mutex writer_mtx;		// serializes grace periods
+
+int myShard()
+{
+  static thread_local int shard = -1;
+  if (shard < 0)
+    shard = std::hash<std::thread::id>()(std::this_thread::get_id())
+            % PROC_TABLE_SHARDS;
+  return shard;
+}
+
+long readersOf(int parity)
+{
+  long n = 0;
+  for (auto &r : readers[parity])
+    n += r.n.load();
+  return n;
+}
+
+/**
+ * @brief wait until all readers which entered before have left
+ *
+ * The epoch is flipped twice: readers which picked up the old parity
+ * before a flip are waited for after it, new readers count on the
+ * other parity and cannot delay the writer forever.
+ */
+void synchronize()
+{
+  std::lock_guard<std::mutex> lock(writer_mtx);
+  for (int i = 0; i < 2; i++) {
+    int old = (int)(epoch.fetch_add(1) & 1);
+    while (readersOf(old) != 0)
+      std::this_thread::yield();
+  }
+}
+} // namespace
+
+ProcTable::ReadGuard::ReadGuard()
+{
+  this->shard = myShard();
+  this->parity = (int)(epoch.load() & 1);
+  readers[this->parity][this->shard].n.fetch_add(1);
+}
+
+ProcTable::ReadGuard::~ReadGuard()
+{
+  readers[this->parity][this->shard].n.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * @brief register a proc under the lowest free identifier
+ *
+ * @return VE process identifier; -1 if the table is full.
+ */
+int ProcTable::insert(ProcHandle *p)
+{
+  for (int i = 0; i < VEO_MAX_HMEM_PROCS; i++) {
+    ProcHandle *expected = nullptr;
+    if (table[i].compare_exchange_strong(expected, p))
+      return i;
+  }
+  VEO_ERROR("more than %d procs", VEO_MAX_HMEM_PROCS);
+  return -1;
+}
+
+/**
+ * @brief unregister a proc
+ *
+ * Returns after all readers which could have seen the proc in the
+ * table have left their critical section.
+ *
+ * @param ident VE process identifier of the proc
+ */
+void ProcTable::remove(int ident)
+{
+  if (ident < 0 || ident >= VEO_MAX_HMEM_PROCS)
+    return;
+  table[ident].store(nullptr);
+  synchronize();
+}
+
+/**
+ * @brief look up a proc, wait-free
+ *
+ * The caller must hold a ReadGuard as long as it uses the proc.
+ *
+ * @param ident VE process identifier
+ * @return the proc; nullptr if the identifier is not used.
+ */
+ProcHandle *ProcTable::get(int ident)
+{
+  if (ident < 0 || ident >= VEO_MAX_HMEM_PROCS)
+    return nullptr;
+  return table[ident].load();
+}
+
+/**
+ * @brief number of registered procs
+ */
+int ProcTable::count()
+{
+  int n = 0;
+  for (auto &t : table)
+    if (t.load(std::memory_order_relaxed) != nullptr)
+      n++;
+  return n;
+}
+
+/**
+ * @brief all registered procs
+ */
+std::vector<ProcHandle *> ProcTable::snapshot()
+{
+  std::vector<ProcHandle *> v;
+  for (auto &t : table) {
+    auto p = t.load();
+    if (p != nullptr)
+      v.push_back(p);
+  }
+  return v;
+}
+} // namespace veo
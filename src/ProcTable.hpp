@@ -0,0 +1,65 @@
+/**
+ * @file ProcTable.hpp
+ * @brief table of the open procs, indexed by VE process identifier
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * ProcTable class definition.
+ */
+#ifndef _VEO_PROC_TABLE_HPP_
+#define _VEO_PROC_TABLE_HPP_
+
+#include <vector>
+
+namespace veo {
+
+class ProcHandle;
+
+/**
+ * @brief registry of all procs
+ *
+ * A fixed array of atomic proc pointers indexed by the VE process
+ * identifier of HMEM addresses. Lookups are wait-free. Readers which
+ * use a proc found in the table hold a ReadGuard; remove() clears the
+ * slot and waits until all readers which might still see the old
+ * pointer have left, like an SRCU grace period. Reader counts are
+ * split by epoch parity and sharded by thread.
+ */
+class ProcTable {
+public:
+  /**
+   * @brief read side critical section
+   *
+   * Must not be held while destroying a proc.
+   */
+  class ReadGuard {
+    int parity;
+    int shard;
+  public:
+    ReadGuard();
+    ~ReadGuard();
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+  };
+
+  static int insert(ProcHandle *);
+  static void remove(int);
+  static ProcHandle *get(int);
+  static int count();
+  static std::vector<ProcHandle *> snapshot();
+};
+} // namespace veo
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file Stream.cpp
+ * @brief implementation of double-buffered data streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Stream methods implementation.
+ */
+#include "Stream.hpp"
+#include "Context.hpp"
+#include "ProcHandle.hpp"
+#include "CallArgs.hpp"
+#include "VEOException.hpp"
+#include "log.h"
+
+namespace veo {
+
+namespace {
+struct XferWait {
+  Context *xctx;
+  uint64_t req;
+};
+
+/**
+ * @brief VH command on the kernel context waiting for a chunk write
+ *
+ * @return status of the write
+ */
+uint64_t waitXfer(void *arg)
+{
+  auto w = static_cast<XferWait *>(arg);
+  uint64_t dummy;
+  int rc = w->xctx->callWaitResult(w->req, &dummy);
+  delete w;
+  return rc;
+}
+} // namespace
+
+/**
+ * @brief constructor
+ *
+ * @param ctx context calling the kernel
+ * @param chunk_size size of the VE buffers
+ * @param depth number of VE buffers, chunks in flight
+ * @param kernel VEMVA of the kernel
+ */
+Stream::Stream(Context *ctx, size_t chunk_size, int depth, uint64_t kernel) :
+  ctx(ctx), kernel(kernel), chunk_size(chunk_size), next_index(0)
+{
+  if (ctx == nullptr || chunk_size == 0 || depth < 2 || kernel == 0)
+    throw VEOException("Stream: invalid argument", EINVAL);
+  for (int i = 0; i < depth; i++) {
+    uint64_t buf = ctx->proc->allocBuff(chunk_size);
+    if (buf == 0) {
+      this->_release();
+      throw VEOException("Stream: failed to allocate VE buffers", ENOMEM);
+    }
+    this->bufs.push_back(buf);
+  }
+  this->xctx = ctx->proc->openHiddenContext();
+  if (this->xctx == nullptr) {
+    this->_release();
+    throw VEOException("Stream: failed to open transfer context");
+  }
+}
+
+Stream::~Stream()
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  for (auto &c : this->chunks)
+    this->_complete(c, true);
+  this->chunks.clear();
+  this->_release();
+}
+
+/**
+ * @brief free the VE buffers and close the transfer context
+ */
+void Stream::_release()
+{
+  for (auto b : this->bufs)
+    this->ctx->proc->freeBuff(b);
+  this->bufs.clear();
+  if (this->xctx) {
+    this->xctx->close();
+    this->xctx.reset();
+  }
+}
+
+/**
+ * @brief collect the results of a chunk
+ *
+ * @return VEO_COMMAND_OK once done, VEO_COMMAND_UNFINISHED if not
+ *         waiting and the chunk is still in flight.
+ */
+int Stream::_complete(Chunk &c, bool wait)
+{
+  uint64_t r = 0;
+  if (c.done)
+    return VEO_COMMAND_OK;
+  if (!c.synced) {
+    int rc = wait ? this->ctx->callWaitResult(c.syncreq, &r)
+                  : this->ctx->callPeekResult(c.syncreq, &r);
+    if (rc == VEO_COMMAND_UNFINISHED)
+      return rc;
+    c.synced = true;
+    c.status = rc == VEO_COMMAND_OK ? (int)r : rc;
+    if (c.status != VEO_COMMAND_OK)
+      VEO_ERROR("write of stream chunk %lu failed (%d)", c.index, c.status);
+  }
+  int rc = wait ? this->ctx->callWaitResult(c.callreq, &r)
+                : this->ctx->callPeekResult(c.callreq, &r);
+  if (rc == VEO_COMMAND_UNFINISHED)
+    return rc;
+  if (c.status == VEO_COMMAND_OK) {
+    c.status = rc;
+    c.result = r;
+  }
+  c.done = true;
+  return VEO_COMMAND_OK;
+}
+
+/**
+ * @brief submit the next chunk
+ *
+ * Blocks while all VE buffers are used by chunks whose kernel calls
+ * did not finish. The data must stay valid until the result of the
+ * chunk was taken.
+ *
+ * @param data chunk data
+ * @param size chunk size, at most the chunk size of the stream
+ * @return index of the chunk; -1 upon failure.
+ */
+int Stream::push(const void *data, size_t size)
+{
+  if (size == 0 || size > this->chunk_size) {
+    VEO_ERROR("chunk size %lu out of range 1..%lu", size, this->chunk_size);
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(this->mtx);
+  uint64_t i = this->next_index;
+  uint64_t depth = this->bufs.size();
+  // the buffer is free once the kernel of chunk i - depth is done
+  if (i >= depth && !this->chunks.empty() &&
+      this->chunks.front().index <= i - depth)
+    this->_complete(this->chunks[i - depth - this->chunks.front().index], true);
+
+  uint64_t buf = this->bufs[i % depth];
+  uint64_t wreq = this->xctx->asyncWriteMem(buf, data, size);
+  if (wreq == VEO_REQUEST_ID_INVALID)
+    return -1;
+
+  CallArgs args;
+  args.set(0, buf);
+  args.set(1, (uint64_t)size);
+  args.set(2, i);
+  Chunk c = { i, VEO_REQUEST_ID_INVALID, VEO_REQUEST_ID_INVALID,
+              false, false, VEO_COMMAND_OK, 0 };
+  // keep the wait and the call together on the kernel context
+  // waitXfer frees the XferWait, keep it if the command was not queued
+  std::unique_ptr<XferWait> w(new XferWait{this->xctx.get(), wreq});
+  uint64_t r;
+  this->ctx->reqBlockBegin();
+  c.syncreq = this->ctx->callVHAsync(waitXfer, w.get());
+  if (c.syncreq == VEO_REQUEST_ID_INVALID) {
+    this->ctx->reqBlockEnd();
+    VEO_ERROR("failed to submit stream chunk %lu", i);
+    // the write was queued, reap it before the buffer is reused
+    this->xctx->callWaitResult(wreq, &r);
+    return -1;
+  }
+  w.release();
+  c.callreq = this->ctx->callAsync(this->kernel, args);
+  this->ctx->reqBlockEnd();
+  if (c.callreq == VEO_REQUEST_ID_INVALID) {
+    VEO_ERROR("failed to submit stream chunk %lu", i);
+    // the wait reaps the write
+    this->ctx->callWaitResult(c.syncreq, &r);
+    return -1;
+  }
+  this->chunks.push_back(c);
+  this->next_index++;
+  return (int)i;
+}
+
+int Stream::_takeResult(uint64_t *index, uint64_t *result, bool wait)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->chunks.empty())
+    return -1;
+  auto &c = this->chunks.front();
+  if (this->_complete(c, wait) == VEO_COMMAND_UNFINISHED)
+    return VEO_COMMAND_UNFINISHED;
+  if (index)
+    *index = c.index;
+  if (result)
+    *result = c.result;
+  int rc = c.status;
+  this->chunks.pop_front();
+  return rc;
+}
+
+/**
+ * @brief take the result of the oldest chunk if it is done
+ *
+ * @return status of the chunk, VEO_COMMAND_UNFINISHED if it is still
+ *         in flight; -1 if no chunk is pending.
+ */
+int Stream::peekResult(uint64_t *index, uint64_t *result)
+{
+  return this->_takeResult(index, result, false);
+}
+
+/**
+ * @brief wait for the oldest chunk and take its result
+ *
+ * @return status of the chunk; -1 if no chunk is pending.
+ */
+int Stream::waitResult(uint64_t *index, uint64_t *result)
+{
+  return this->_takeResult(index, result, true);
+}
+
+} // namespace veo
@@ -0,0 +1,85 @@
+/**
+ * @file Stream.hpp
+ * @brief double-buffered data streams into VE kernels
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Stream class definition.
+ */
+#ifndef _VEO_STREAM_HPP_
+#define _VEO_STREAM_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ve_offload.h>
+
+namespace veo {
+
+class Context;
+
+/**
+ * @brief stream of data chunks processed by a VE kernel
+ *
+ * A ring of VE buffers is written through a hidden transfer context,
+ * the kernel is called on the user's context. The call of a chunk
+ * waits for its write only, so the writes of the next chunks overlap
+ * with the kernel working on the current one. The kernel is called
+ * as kernel(void *buf, size_t size, uint64_t index).
+ */
+class Stream {
+  struct Chunk {
+    uint64_t index;	//!< sequence number
+    uint64_t syncreq;	//!< VH command waiting for the write
+    uint64_t callreq;	//!< kernel call
+    bool synced;	//!< result of syncreq taken
+    bool done;		//!< result of callreq taken
+    int status;
+    uint64_t result;
+  };
+  Context *ctx;				//!< context calling the kernel
+  std::shared_ptr<Context> xctx;	//!< hidden context writing the chunks
+  uint64_t kernel;
+  size_t chunk_size;
+  std::vector<uint64_t> bufs;		//!< ring of VE buffers
+  std::deque<Chunk> chunks;		//!< chunks whose results were not taken
+  uint64_t next_index;
+  std::mutex mtx;
+
+  int _complete(Chunk &, bool);
+  int _takeResult(uint64_t *, uint64_t *, bool);
+  void _release();
+
+public:
+  Stream(Context *, size_t, int, uint64_t);
+  ~Stream();
+  Stream(const Stream &) = delete;
+
+  int push(const void *, size_t);
+  int peekResult(uint64_t *, uint64_t *);
+  int waitResult(uint64_t *, uint64_t *);
+  size_t chunkSize() { return this->chunk_size; }
+
+  veo_stream *toCHandle() {
+    return reinterpret_cast<veo_stream *>(this);
+  }
+};
+
+} // namespace veo
+#endif
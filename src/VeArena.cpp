@@ -0,0 +1,217 @@
+/**
+ * @file VeArena.cpp
+ * @brief implementation of the VE memory arena
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * VeArena methods implementation.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+#include "VeArena.hpp"
+#include "ProcHandle.hpp"
+#include "log.h"
+
+// buffers are aligned like large VE malloc results
+#define ARENA_ALIGN 64UL
+// larger requests bypass the arena
+#define ARENA_MAX_FRACTION 4
+
+namespace veo {
+
+/**
+ * @brief set up the arena of a proc
+ *
+ * @param p proc owning the arena
+ * @param chunk initial chunk size, 0 disables the arena. Overridden by
+ *        the environment variable VEO_ARENA_CHUNK.
+ */
+void VeArena::init(ProcHandle *p, size_t chunk)
+{
+  this->proc = p;
+  const char *e = getenv("VEO_ARENA_CHUNK");
+  if (e != nullptr)
+    chunk = strtoul(e, nullptr, 0);
+  this->setChunkSize(chunk);
+}
+
+/**
+ * @brief set the size of new chunks, 0 disables new arena allocations
+ *
+ * Buffers already in the arena are still freed into it.
+ */
+void VeArena::setChunkSize(size_t chunk)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  this->chunk_size = (chunk + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  VEO_DEBUG("VE arena chunk size %lu", this->chunk_size);
+}
+
+std::map<uint64_t, VeArena::Chunk>::iterator VeArena::_chunkOf(uint64_t addr)
+{
+  auto it = this->chunks.upper_bound(addr);
+  if (it == this->chunks.begin())
+    return this->chunks.end();
+  --it;
+  if (addr >= it->first + it->second.size)
+    return this->chunks.end();
+  return it;
+}
+
+void VeArena::_addFree(uint64_t addr, size_t size)
+{
+  this->free_ranges[addr] = size;
+  this->by_size.insert(std::make_pair(size, addr));
+}
+
+void VeArena::_delFree(std::map<uint64_t, size_t>::iterator it)
+{
+  auto r = this->by_size.equal_range(it->second);
+  for (auto s = r.first; s != r.second; ++s) {
+    if (s->second == it->first) {
+      this->by_size.erase(s);
+      break;
+    }
+  }
+  this->free_ranges.erase(it);
+}
+
+/**
+ * @brief allocate one more chunk from the VE process
+ */
+bool VeArena::_grow(size_t size)
+{
+  size_t csz = std::max(this->chunk_size, size);
+  uint64_t base = this->proc->allocBuff(csz);
+  if (base == 0)
+    return false;
+  VEO_DEBUG("new VE arena chunk %lx size %lu", base, csz);
+  this->chunks[base] = Chunk{csz, 0};
+  this->empty_chunks++;
+  this->_addFree(base, csz);
+  return true;
+}
+
+/**
+ * @brief return empty chunks to the VE process, keeping one spare
+ */
+void VeArena::_releaseEmpty()
+{
+  for (auto it = this->chunks.begin();
+       it != this->chunks.end() && this->empty_chunks > 1; ) {
+    if (it->second.used != 0) {
+      ++it;
+      continue;
+    }
+    uint64_t base = it->first;
+    this->_delFree(this->free_ranges.find(base));
+    it = this->chunks.erase(it);
+    this->empty_chunks--;
+    VEO_DEBUG("releasing VE arena chunk %lx", base);
+    this->proc->freeBuff(base);
+  }
+}
+
+/**
+ * @brief allocate a buffer from the arena
+ *
+ * @param size size in byte
+ * @return VEMVA of the buffer; 0 if the arena is disabled, the size is
+ *         too large for it or the VE memory is exhausted.
+ */
+uint64_t VeArena::alloc(size_t size)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  if (this->chunk_size == 0 || size == 0 ||
+      size > this->chunk_size / ARENA_MAX_FRACTION)
+    return 0;
+  this->_releaseEmpty();
+  size_t len = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  auto f = this->by_size.lower_bound(len);
+  if (f == this->by_size.end()) {
+    if (!this->_grow(len))
+      return 0;
+    f = this->by_size.lower_bound(len);
+  }
+  uint64_t addr = f->second;
+  size_t fsize = f->first;
+  this->_delFree(this->free_ranges.find(addr));
+  if (fsize > len)
+    this->_addFree(addr + len, fsize - len);
+  auto c = this->_chunkOf(addr);
+  if (c->second.used == 0)
+    this->empty_chunks--;
+  c->second.used += len;
+  this->allocs[addr] = len;
+  return addr;
+}
+
+/**
+ * @brief free a buffer into the arena
+ *
+ * @param addr VEMVA of the buffer
+ * @param release return empty chunks to the VE process right away.
+ *        Must be false when called from a progress thread.
+ * @return true if the buffer belonged to the arena.
+ */
+bool VeArena::free(uint64_t addr, bool release)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  auto a = this->allocs.find(addr);
+  if (a == this->allocs.end())
+    return false;
+  size_t len = a->second;
+  this->allocs.erase(a);
+  auto c = this->_chunkOf(addr);
+  uint64_t cstart = c->first, cend = c->first + c->second.size;
+
+  // merge with the free neighbours inside the chunk
+  uint64_t start = addr, end = addr + len;
+  auto next = this->free_ranges.lower_bound(addr);
+  if (next != this->free_ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first >= cstart && prev->first + prev->second == start) {
+      start = prev->first;
+      this->_delFree(prev);
+    }
+  }
+  next = this->free_ranges.lower_bound(addr);
+  if (next != this->free_ranges.end() && next->first == end && end < cend) {
+    end += next->second;
+    this->_delFree(next);
+  }
+  this->_addFree(start, end - start);
+
+  c->second.used -= len;
+  if (c->second.used == 0)
+    this->empty_chunks++;
+  if (release)
+    this->_releaseEmpty();
+  return true;
+}
+
+/**
+ * @brief check if a buffer was allocated from the arena
+ */
+bool VeArena::owns(uint64_t addr)
+{
+  std::lock_guard<std::mutex> lock(this->mtx);
+  return this->allocs.count(addr) > 0;
+}
+
+} // namespace veo
@@ -0,0 +1,76 @@
+/**
+ * @file VeArena.hpp
+ * @brief VH side sub-allocator of VE memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * VeArena class definition.
+ */
+#ifndef _VEO_VE_ARENA_HPP_
+#define _VEO_VE_ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace veo {
+
+class ProcHandle;
+
+/**
+ * @brief serves VE buffers from large VE chunks without VE round trips
+ *
+ * Chunks are allocated from the VE process on demand. Buffers are cut
+ * from the free ranges of the chunks by best fit, freed buffers are
+ * merged with neighbouring free ranges of the same chunk. Empty chunks
+ * beyond one spare chunk are returned to the VE process.
+ */
+class VeArena {
+  struct Chunk {
+    size_t size;
+    size_t used;	//!< bytes handed out
+  };
+  ProcHandle *proc;
+  size_t chunk_size;	//!< 0: arena disabled
+  std::map<uint64_t, Chunk> chunks;		//!< key is the chunk start
+  std::map<uint64_t, size_t> free_ranges;	//!< start -> size
+  std::multimap<size_t, uint64_t> by_size;	//!< size -> start
+  std::unordered_map<uint64_t, size_t> allocs;	//!< buffer -> size
+  int empty_chunks;
+  std::mutex mtx;
+
+  std::map<uint64_t, Chunk>::iterator _chunkOf(uint64_t);
+  void _addFree(uint64_t, size_t);
+  void _delFree(std::map<uint64_t, size_t>::iterator);
+  bool _grow(size_t);
+  void _releaseEmpty();
+
+public:
+  VeArena() : proc(nullptr), chunk_size(0), empty_chunks(0) {}
+  VeArena(const VeArena &) = delete;
+
+  void init(ProcHandle *, size_t);
+  void setChunkSize(size_t);
+  size_t chunkSize() { return this->chunk_size; }
+  uint64_t alloc(size_t);
+  bool free(uint64_t, bool release = true);
+  bool owns(uint64_t);
+};
+
+} // namespace veo
+#endif
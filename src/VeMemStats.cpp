@@ -0,0 +1,155 @@
+/**
+ * @file VeMemStats.cpp
+ * @brief accounting of the VE memory held by a proc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * VeMemStats methods implementation.
+ */
+#include <cstdlib>
+
+#include "VeMemStats.hpp"
+#include "log.h"
+
+// leaked buffers listed by report()
+#define MEM_STATS_MAX_LISTED 16
+
+namespace veo {
+
+VeMemStats::VeMemStats() : count(0), bytes(0), peak(0), allocs(0), frees(0)
+{
+  for (auto &h : this->hist)
+    h = 0;
+}
+
+/**
+ * @brief histogram bucket of a size, floor(log2(size))
+ */
+int VeMemStats::_bucket(size_t size)
+{
+  if (size == 0)
+    return 0;
+  int b = 63 - __builtin_clzl(size);
+  return b < VEO_MEM_HIST_BUCKETS ? b : VEO_MEM_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief account an allocated buffer
+ *
+ * @param addr VEMVA of the buffer
+ * @param size size in byte
+ */
+void VeMemStats::add(uint64_t addr, size_t size)
+{
+  if (addr == 0)
+    return;
+  {
+    auto &s = this->_shard(addr);
+    std::lock_guard<std::mutex> lock(s.mtx);
+    s.live[addr] = size;
+  }
+  this->count.fetch_add(1, std::memory_order_relaxed);
+  this->allocs.fetch_add(1, std::memory_order_relaxed);
+  this->hist[_bucket(size)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t b = this->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t p = this->peak.load(std::memory_order_relaxed);
+  while (b > p &&
+         !this->peak.compare_exchange_weak(p, b, std::memory_order_relaxed))
+    ;
+}
+
+/**
+ * @brief account a freed buffer
+ *
+ * @param addr VEMVA of the buffer
+ * @return true if the buffer was accounted; false for unknown buffers,
+ *         e.g. buffers allocated by VE code.
+ */
+bool VeMemStats::remove(uint64_t addr)
+{
+  size_t size;
+  {
+    auto &s = this->_shard(addr);
+    std::lock_guard<std::mutex> lock(s.mtx);
+    auto it = s.live.find(addr);
+    if (it == s.live.end())
+      return false;
+    size = it->second;
+    s.live.erase(it);
+  }
+  this->count.fetch_sub(1, std::memory_order_relaxed);
+  this->frees.fetch_add(1, std::memory_order_relaxed);
+  this->hist[_bucket(size)].fetch_sub(1, std::memory_order_relaxed);
+  this->bytes.fetch_sub(size, std::memory_order_relaxed);
+  return true;
+}
+
+/**
+ * @brief snapshot of the counters
+ *
+ * The counters are read one by one, the snapshot is not atomic while
+ * other threads allocate.
+ */
+void VeMemStats::get(veo_mem_stats *st)
+{
+  st->live_count = this->count.load(std::memory_order_relaxed);
+  st->live_bytes = this->bytes.load(std::memory_order_relaxed);
+  st->peak_bytes = this->peak.load(std::memory_order_relaxed);
+  st->allocs = this->allocs.load(std::memory_order_relaxed);
+  st->frees = this->frees.load(std::memory_order_relaxed);
+  for (int i = 0; i < VEO_MEM_HIST_BUCKETS; i++)
+    st->hist[i] = this->hist[i].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief report buffers which are still allocated
+ *
+ * Printed if the environment variable VEO_LEAK_REPORT is set to a
+ * nonzero value, else only with debug logging.
+ *
+ * @param pid PID of the VE process, for the report header
+ */
+void VeMemStats::report(int pid)
+{
+  veo_mem_stats st;
+  this->get(&st);
+  if (st.live_count == 0)
+    return;
+  const char *e = getenv("VEO_LEAK_REPORT");
+  if (e == nullptr || atoi(e) == 0) {
+    VEO_DEBUG("VE proc %d: %lu buffers (%lu bytes) not freed", pid,
+              st.live_count, st.live_bytes);
+    return;
+  }
+  VEO_ERROR("VE proc %d: %lu buffers (%lu bytes) not freed, peak %lu bytes,"
+            " %lu allocations, %lu frees", pid, st.live_count,
+            st.live_bytes, st.peak_bytes, st.allocs, st.frees);
+  for (int i = 0; i < VEO_MEM_HIST_BUCKETS; i++) {
+    if (st.hist[i])
+      VEO_ERROR("  %lu buffers of %lu - %lu bytes", st.hist[i],
+                i ? 1UL << i : 0UL, (2UL << i) - 1);
+  }
+  int listed = 0;
+  for (auto &s : this->shards) {
+    std::lock_guard<std::mutex> lock(s.mtx);
+    for (auto &b : s.live) {
+      if (listed++ == MEM_STATS_MAX_LISTED)
+        return;
+      VEO_ERROR("  leaked buffer %#lx, %lu bytes", b.first, b.second);
+    }
+  }
+}
+} // namespace veo
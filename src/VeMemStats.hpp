@@ -0,0 +1,71 @@
+/**
+ * @file VeMemStats.hpp
+ * @brief accounting of the VE memory held by a proc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * VeMemStats class definition.
+ */
+#ifndef _VEO_VE_MEM_STATS_HPP_
+#define _VEO_VE_MEM_STATS_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "ve_offload.h"
+
+namespace veo {
+
+/**
+ * @brief live VE buffers of a proc allocated through the VEO API
+ *
+ * Buffer sizes are kept in hash maps sharded by address, so concurrent
+ * allocations rarely contend for a lock. The counters and the size
+ * histogram are atomic.
+ */
+class VeMemStats {
+  enum { NSHARDS = 16 };
+  struct Shard {
+    std::mutex mtx;
+    std::unordered_map<uint64_t, size_t> live;	//!< buffer -> size
+  };
+  Shard shards[NSHARDS];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> peak;
+  std::atomic<uint64_t> allocs;
+  std::atomic<uint64_t> frees;
+  std::atomic<uint64_t> hist[VEO_MEM_HIST_BUCKETS];
+
+  // large VE buffers are page aligned, mix the address bits
+  Shard &_shard(uint64_t addr) {
+    return this->shards[((addr >> 6) * 0x9e3779b97f4a7c15UL) >> 60];
+  }
+  static int _bucket(size_t);
+
+public:
+  VeMemStats();
+  VeMemStats(const VeMemStats &) = delete;
+  void add(uint64_t, size_t);
+  bool remove(uint64_t);
+  void get(veo_mem_stats *);
+  void report(int);
+};
+} // namespace veo
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file XferTuning.cpp
+ * @brief implementation of transfer fragmentation calibration
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * XferTuning methods implementation.
+ */
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "XferTuning.hpp"
+#include "ProcHandle.hpp"
+#include "Context.hpp"
+#include "log.h"
+#include "veo_time.h"
+#include "veo_get_arch_info.h"
+
+// range of transfer sizes measured, in powers of two
+#define XFER_CALIB_MIN_SIZE (64 * 1024)
+#define XFER_CALIB_MAX_SIZE (64 * 1024 * 1024)
+// repetitions per measurement, the fastest one counts
+#define XFER_CALIB_REPS 3
+
+namespace veo {
+
+static const char *dir_name[2] = { "send", "recv" };
+
+/**
+ * @brief path of the calibration cache file
+ *
+ * VEO_XFER_CALIBRATE_FILE overrides the default location
+ * $XDG_CACHE_HOME/aveo (or $HOME/.cache/aveo).
+ *
+ * @param venode VE node number
+ * @param bufsz VE-URPC maximum command size
+ * @return path, empty if there is no place to store the cache
+ */
+static std::string _cacheFile(int venode, size_t bufsz)
+{
+  const char *f = getenv("VEO_XFER_CALIBRATE_FILE");
+  if (f != nullptr && *f)
+    return std::string(f);
+
+  std::string dir;
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (xdg != nullptr && *xdg)
+    dir = std::string(xdg);
+  else if (home != nullptr && *home)
+    dir = std::string(home) + "/.cache";
+  else
+    return std::string();
+  mkdir(dir.c_str(), 0700);
+  dir += "/aveo";
+  mkdir(dir.c_str(), 0700);
+
+  unsigned int cpu = 0, node = 0;
+  syscall(SYS_getcpu, &cpu, &node, nullptr);
+  int arch = veo_arch_number_sysfs(venode);
+
+  std::ostringstream ss;
+  ss << dir << "/xfer_ve" << arch << "_buf" << bufsz << "_numa" << node
+     << ".tbl";
+  return ss.str();
+}
+
+/**
+ * @brief look up the calibrated fragment size for a transfer
+ *
+ * @param dir XFER_SEND or XFER_RECV
+ * @param size size of the whole transfer
+ * @return fragment size; 0 if there is no calibrated table.
+ */
+size_t XferTuning::fragSize(int dir, size_t size)
+{
+  if (!this->valid)
+    return 0;
+  auto &t = this->table[dir];
+  size_t frag = t.back().second;
+  for (auto &e : t) {
+    if (size <= e.first) {
+      frag = e.second;
+      break;
+    }
+  }
+  return frag < size ? frag : ALIGN8B(size);
+}
+
+/**
+ * @brief set up the table if calibration is enabled
+ *
+ * Calibration is enabled by VEO_XFER_CALIBRATE=1, a cached table is
+ * used if it exists. VEO_XFER_CALIBRATE=2 forces a new calibration
+ * and overwrites the cache.
+ *
+ * @param ctx context used for the measurements
+ * @param venode VE node number
+ * @param bufsz VE-URPC maximum command size
+ * @return 0 upon success or if disabled; -1 upon failure.
+ */
+int XferTuning::init(Context *ctx, int venode, size_t bufsz)
+{
+  const char *e = getenv("VEO_XFER_CALIBRATE");
+  if (e == nullptr)
+    return 0;
+  int mode = atoi(e);
+  if (mode == 0)
+    return 0;
+
+  std::string path = _cacheFile(venode, bufsz);
+  if (mode != 2 && !path.empty() && this->load(path) == 0) {
+    VEO_DEBUG("loaded transfer calibration from %s", path.c_str());
+    return 0;
+  }
+  if (this->calibrate(ctx, bufsz) != 0) {
+    VEO_ERROR("transfer calibration failed, using defaults");
+    return -1;
+  }
+  if (!path.empty() && this->save(path) != 0)
+    VEO_ERROR("failed to save transfer calibration to %s", path.c_str());
+  return 0;
+}
+
+/**
+ * @brief time one transfer
+ *
+ * @return best time of XFER_CALIB_REPS runs in us; -1 upon failure.
+ */
+long XferTuning::measure(Context *ctx, int dir, uint64_t vebuf, void *buf,
+                         size_t size, size_t frag)
+{
+  long best = LONG_MAX;
+  for (int r = 0; r < XFER_CALIB_REPS; r++) {
+    long ts = get_time_us();
+    uint64_t req;
+    if (dir == XFER_SEND)
+      req = ctx->asyncWriteMemFrag(vebuf, buf, size, frag);
+    else
+      req = ctx->asyncReadMemFrag(buf, vebuf, size, frag);
+    if (req == VEO_REQUEST_ID_INVALID)
+      return -1;
+    uint64_t res;
+    if (ctx->callWaitResult(req, &res) != VEO_COMMAND_OK)
+      return -1;
+    long t = timediff_us(ts);
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+/**
+ * @brief measure the fragment sizes per direction
+ *
+ * For each power of two transfer size the candidates are even splits
+ * into 1..8 parts and fixed fragment sizes. Fragments never exceed
+ * half of the VE-URPC command size, such that two of them can be in
+ * flight, like with the built-in heuristics.
+ *
+ * @param ctx context used for the measurements
+ * @param bufsz VE-URPC maximum command size
+ * @return 0 upon success; -1 upon failure.
+ */
+int XferTuning::calibrate(Context *ctx, size_t bufsz)
+{
+  const size_t maxsz = XFER_CALIB_MAX_SIZE;
+  const size_t fraglimit = bufsz / 2;
+  const int parts[] = { 1, 2, 3, 4, 5, 8 };
+
+  uint64_t vebuf = ctx->proc->allocBuff(maxsz);
+  if (vebuf == 0)
+    return -1;
+  char *buf = (char *)malloc(maxsz);
+  if (buf == nullptr) {
+    ctx->proc->freeBuff(vebuf);
+    return -1;
+  }
+  memset(buf, 0, maxsz);
+
+  int rc = 0;
+  for (int dir = XFER_SEND; dir <= XFER_RECV && rc == 0; dir++) {
+    auto &t = this->table[dir];
+    t.clear();
+    // warm up, pages get touched on both sides
+    if (this->measure(ctx, dir, vebuf, buf, maxsz, fraglimit) < 0) {
+      rc = -1;
+      break;
+    }
+    for (size_t size = XFER_CALIB_MIN_SIZE; size <= maxsz; size *= 2) {
+      std::vector<size_t> cand;
+      for (int n : parts)
+        cand.push_back(ALIGN8B(size / n));
+      for (size_t f = 512 * 1024; f < size; f *= 2)
+        cand.push_back(f);
+
+      size_t best_frag = 0;
+      long best = LONG_MAX;
+      for (size_t frag : cand) {
+        if (frag == 0 || frag > fraglimit)
+          continue;
+        long us = this->measure(ctx, dir, vebuf, buf, size, frag);
+        if (us < 0) {
+          rc = -1;
+          break;
+        }
+        if (us < best) {
+          best = us;
+          best_frag = frag;
+        }
+      }
+      if (rc)
+        break;
+      if (best_frag == 0)
+        continue;
+      VEO_DEBUG("%s size=%lu frag=%lu time=%ldus", dir_name[dir], size,
+                best_frag, best);
+      t.push_back(std::make_pair(size, best_frag));
+    }
+    if (t.empty())
+      rc = -1;
+  }
+  free(buf);
+  ctx->proc->freeBuff(vebuf);
+  this->valid = (rc == 0);
+  return rc;
+}
+
+/**
+ * @brief read the table from a cache file
+ *
+ * @return 0 upon success; -1 if the file is missing or broken.
+ */
+int XferTuning::load(const std::string &path)
+{
+  std::ifstream in(path);
+  if (!in)
+    return -1;
+  std::vector<std::pair<size_t, size_t>> t[2];
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream ls(line);
+    std::string d;
+    size_t size, frag;
+    if (!(ls >> d >> size >> frag) || frag == 0)
+      return -1;
+    if (d == dir_name[XFER_SEND])
+      t[XFER_SEND].push_back(std::make_pair(size, frag));
+    else if (d == dir_name[XFER_RECV])
+      t[XFER_RECV].push_back(std::make_pair(size, frag));
+    else
+      return -1;
+  }
+  if (t[XFER_SEND].empty() || t[XFER_RECV].empty())
+    return -1;
+  for (int dir = XFER_SEND; dir <= XFER_RECV; dir++) {
+    std::sort(t[dir].begin(), t[dir].end());
+    this->table[dir] = t[dir];
+  }
+  this->valid = true;
+  return 0;
+}
+
+/**
+ * @brief write the table to a cache file
+ *
+ * @return 0 upon success; -1 upon failure.
+ */
+int XferTuning::save(const std::string &path)
+{
+  std::string tmp = path + "." + std::to_string(getpid());
+  {
+    std::ofstream out(tmp);
+    if (!out)
+      return -1;
+    out << "# AVEO transfer fragmentation table: direction size fragment\n";
+    for (int dir = XFER_SEND; dir <= XFER_RECV; dir++)
+      for (auto &e : this->table[dir])
+        out << dir_name[dir] << " " << e.first << " " << e.second << "\n";
+    if (!out)
+      return -1;
+  }
+  // concurrent processes may calibrate at the same time
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace veo
@@ -0,0 +1,63 @@
+/**
+ * @file XferTuning.hpp
+ * @brief calibrated fragmentation of memory transfers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * XferTuning class definition.
+ */
+#ifndef _VEO_XFER_TUNING_HPP_
+#define _VEO_XFER_TUNING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace veo {
+
+class Context;
+
+/**
+ * @brief table of fragment sizes for memory transfers
+ *
+ * Maps transfer sizes to the fragment size which performed best for
+ * SENDBUFF (write) and RECVBUFF (read) request chains. The table is
+ * measured on the VE by calibrate() and cached in a file keyed by the
+ * VE architecture, the VE-URPC buffer size and the host NUMA node.
+ */
+class XferTuning {
+public:
+  enum { XFER_SEND = 0, XFER_RECV = 1 };
+
+  XferTuning() : valid(false) {}
+  bool isValid() { return this->valid; }
+  size_t fragSize(int, size_t);
+  int init(Context *, int, size_t);
+  int calibrate(Context *, size_t);
+  int load(const std::string &);
+  int save(const std::string &);
+
+private:
+  bool valid;
+  //! (transfer size, fragment size) pairs sorted by transfer size
+  std::vector<std::pair<size_t, size_t>> table[2];
+  long measure(Context *, int, uint64_t, void *, size_t, size_t);
+};
+
+} // namespace veo
+#endif
@@ -29,9 +29,16 @@
 #define VEO_SYMNAME_LEN_MAX (255)
 #define VEO_LOG_CATEGORY "veos.veo.veo"
 #define VEO_MAX_NUM_ARGS (256)
+#define VEO_MAX_XFER_CHANNELS (8)
+#define VEO_NUMA_NODE_AUTO (-1)	/* NUMA node closest to the VE */
+#define VEO_NUMA_NODE_NONE (-2)	/* no NUMA binding */
 
 #define VEO_REQUEST_ID_INVALID (~0UL)
 
+/* flags of veo_alloc_mem_ex() */
+#define VEO_ALLOC_HUGEPAGE (1 << 0)	/* back the buffer with 64MB pages */
+#define VEO_ALLOC_PREFAULT (1 << 1)	/* touch all pages before returning */
+
 #define CMD_VEGDB "/opt/nec/ve/bin/ve-gdb"
 #define CMD_XTERM "/usr/bin/xterm"
 
@@ -70,10 +77,78 @@ enum veo_args_intent {
   VEO_INTENT_OUT,
 };
 
+/**
+ * @brief one buffer of a scatter-gather transfer
+ */
+struct veo_iovec {
+  void *vhaddr;		/*!< VH address */
+  uint64_t veaddr;	/*!< VE address */
+  size_t size;		/*!< size in byte */
+};
+
+enum veo_call_arg_kind {
+  VEO_CALL_ARG_VALUE = 0,	/*!< val is passed */
+  VEO_CALL_ARG_BUFFER,		/*!< buff is passed on the stack */
+};
+
+/**
+ * @brief one argument of veo_call_async_argv()
+ */
+struct veo_call_arg {
+  uint64_t val;		/*!< register image of a value */
+  void *buff;		/*!< VH buffer passed on the stack */
+  size_t len;		/*!< size of the value (1 to 8) or of the buffer */
+  enum veo_args_intent intent;	/*!< copy direction of the buffer */
+  enum veo_call_arg_kind kind;	/*!< value or buffer */
+};
+
+/**
+ * @brief one copy of a batched veo_hmemcpy_batch_async()
+ */
+struct veo_hmemcpy_desc {
+  void *dst;		/*!< destination, VH or HMEM address */
+  const void *src;	/*!< source, VH or HMEM address */
+  size_t size;		/*!< size in byte */
+};
+
+/**
+ * @brief progress of a transfer started with veo_async_*_mem_progress()
+ *
+ * done counts the leading bytes of the buffer which were transferred,
+ * it is updated after each fragment. cb, if set, is called from the
+ * progress thread of the context each time done crosses a multiple
+ * of step (every fragment if step is 0) and when the transfer is done.
+ */
+struct veo_xfer_progress {
+  volatile uint64_t done;	/*!< bytes transferred, set by VEO */
+  size_t step;			/*!< callback granularity in byte */
+  void (*cb)(void *arg, size_t done, size_t total);	/*!< callback or NULL */
+  void *arg;			/*!< argument of the callback */
+};
+
+#define VEO_MEM_HIST_BUCKETS 48
+
+/**
+ * @brief VE memory held by a proc through the VEO allocation API
+ *
+ * hist[i] counts the live buffers with a size of 2^i up to 2^(i+1)-1
+ * bytes, hist[0] also counts empty buffers and the last bucket all
+ * larger ones.
+ */
+struct veo_mem_stats {
+  uint64_t live_count;	/*!< buffers not freed yet */
+  uint64_t live_bytes;	/*!< bytes of the live buffers */
+  uint64_t peak_bytes;	/*!< high-water mark of live_bytes */
+  uint64_t allocs;	/*!< buffers allocated so far */
+  uint64_t frees;	/*!< buffers freed so far */
+  uint64_t hist[VEO_MEM_HIST_BUCKETS];	/*!< live buffers by size */
+};
+
 struct veo_args;
 struct veo_proc_handle;
 struct veo_thr_ctxt;
 struct veo_thr_ctxt_attr;
+struct veo_stream;
 
 void veo_register_hook(void* func, void (*hook)(void*, ...), void* payload);
 void *veo_get_hook(void* func);
@@ -89,6 +164,13 @@ int veo_unload_library(struct veo_proc_handle *, const uint64_t);
 uint64_t veo_get_sym(struct veo_proc_handle *, uint64_t, const char *);
 int veo_alloc_mem(struct veo_proc_handle *, uint64_t *, const size_t);
 int veo_free_mem(struct veo_proc_handle *, uint64_t);
+int64_t veo_trim_mem(struct veo_proc_handle *, size_t);
+int veo_set_arena_chunk(struct veo_proc_handle *, size_t);
+int veo_alloc_mem_multi(struct veo_proc_handle *, int, const size_t *, uint64_t *);
+int veo_free_mem_multi(struct veo_proc_handle *, int, const uint64_t *);
+int veo_alloc_mem_ex(struct veo_proc_handle *, uint64_t *, const size_t,
+                     uint64_t, size_t);
+int veo_get_mem_stats(struct veo_proc_handle *, struct veo_mem_stats *);
 int veo_read_mem(struct veo_proc_handle *, void *, uint64_t, size_t);
 struct veo_proc_handle *veo_get_proc_handle_from_hmem(const void *);
 pid_t veo_get_pid_from_hmem(const void *);
@@ -124,15 +206,51 @@ uint64_t veo_call_async(struct veo_thr_ctxt *, uint64_t, struct veo_args *);
 uint64_t veo_call_async_by_name(struct veo_thr_ctxt *, uint64_t, const char *,
                                 struct veo_args *);
 uint64_t veo_call_async_vh(struct veo_thr_ctxt *, uint64_t (*)(void *), void *);
+uint64_t veo_call_async_with_io(struct veo_thr_ctxt *, uint64_t, struct veo_args *,
+                                const struct veo_iovec *, int,
+                                const struct veo_iovec *, int);
+uint64_t veo_call_async_argv(struct veo_thr_ctxt *, uint64_t, int,
+                             const struct veo_call_arg *);
 
 int veo_call_peek_result(struct veo_thr_ctxt *, uint64_t, uint64_t *);
 int veo_call_wait_result(struct veo_thr_ctxt *, uint64_t, uint64_t *);
 
 uint64_t veo_alloc_mem_async(struct veo_thr_ctxt *ctx, const size_t size);
 uint64_t veo_free_mem_async(struct veo_thr_ctxt *ctx, uint64_t addr);
+uint64_t veo_alloc_mem_multi_async(struct veo_thr_ctxt *ctx, int n,
+                                   const size_t *sizes, uint64_t *addrs);
+uint64_t veo_free_mem_multi_async(struct veo_thr_ctxt *ctx, int n,
+                                  const uint64_t *addrs);
 uint64_t veo_async_read_mem(struct veo_thr_ctxt *, void *, uint64_t, size_t);
 uint64_t veo_async_write_mem(struct veo_thr_ctxt *, uint64_t, const void *,
                              size_t);
+uint64_t veo_async_read_mem_2d(struct veo_thr_ctxt *, void *, size_t,
+                               uint64_t, size_t, size_t, size_t);
+uint64_t veo_async_write_mem_2d(struct veo_thr_ctxt *, uint64_t, size_t,
+                                const void *, size_t, size_t, size_t);
+uint64_t veo_async_read_mem_3d(struct veo_thr_ctxt *, void *, size_t, size_t,
+                               uint64_t, size_t, size_t,
+                               size_t, size_t, size_t);
+uint64_t veo_async_write_mem_3d(struct veo_thr_ctxt *, uint64_t, size_t, size_t,
+                                const void *, size_t, size_t,
+                                size_t, size_t, size_t);
+uint64_t veo_async_readv(struct veo_thr_ctxt *, const struct veo_iovec *, int);
+uint64_t veo_async_writev(struct veo_thr_ctxt *, const struct veo_iovec *, int);
+uint64_t veo_async_read_mem_progress(struct veo_thr_ctxt *, void *, uint64_t,
+                                     size_t, struct veo_xfer_progress *);
+uint64_t veo_async_write_mem_progress(struct veo_thr_ctxt *, uint64_t,
+                                      const void *, size_t,
+                                      struct veo_xfer_progress *);
+uint64_t veo_memset_async(struct veo_thr_ctxt *, uint64_t, int, size_t);
+uint64_t veo_fill_async(struct veo_thr_ctxt *, uint64_t, uint64_t, size_t, size_t);
+uint64_t veo_hmemcpy_async(struct veo_thr_ctxt *, void *, const void *, size_t);
+uint64_t veo_hmemcpy_batch_async(struct veo_thr_ctxt *,
+                                 const struct veo_hmemcpy_desc *, int);
+struct veo_stream *veo_stream_open(struct veo_thr_ctxt *, size_t, int, uint64_t);
+int veo_stream_push(struct veo_stream *, const void *, size_t);
+int veo_stream_peek_result(struct veo_stream *, uint64_t *, uint64_t *);
+int veo_stream_wait_result(struct veo_stream *, uint64_t *, uint64_t *);
+int veo_stream_close(struct veo_stream *);
 void veo_req_block_begin(struct veo_thr_ctxt *ctx);
 void veo_req_block_end(struct veo_thr_ctxt *ctx);
 
@@ -142,6 +260,8 @@ struct veo_thr_ctxt_attr *veo_alloc_thr_ctxt_attr(void);
 int veo_free_thr_ctxt_attr(struct veo_thr_ctxt_attr *);
 int veo_set_thr_ctxt_stacksize(struct veo_thr_ctxt_attr *, size_t);
 int veo_get_thr_ctxt_stacksize(struct veo_thr_ctxt_attr *, size_t *);
+int veo_set_thr_ctxt_numa_node(struct veo_thr_ctxt_attr *, int);
+int veo_get_thr_ctxt_numa_node(struct veo_thr_ctxt_attr *, int *);
 
 const char *veo_version_string(void);
 int veo_api_version(void);
@@ -156,6 +276,22 @@ int veo_get_ve_arch(int ve_node_numember);
 
 void veo_register_hmem_hook_functions(void (*)(void *, size_t), void (*)(uint64_t));
 void veo_unregister_hmem_hook_functions();
+
+int veo_register_host_mem(struct veo_proc_handle *, void *, size_t);
+int veo_unregister_host_mem(struct veo_proc_handle *, void *);
+
+int veo_set_xfer_channels(struct veo_proc_handle *, int);
+int veo_get_xfer_channels(struct veo_proc_handle *);
+
+void *veo_alloc_managed(struct veo_proc_handle *, size_t);
+int veo_free_managed(void *);
+uint64_t veo_managed_ve_addr(const void *);
+int veo_args_set_managed(struct veo_args *, int, void *);
+int veo_args_set_managed_range(struct veo_args *, int, void *,
+                               enum veo_args_intent, size_t, size_t);
+int veo_sync_managed_to_ve(void *);
+int veo_sync_managed_from_ve(void *, size_t, size_t);
+size_t veo_managed_dirty_bytes(void *);
 #ifdef __cplusplus
 } // extern "C"
 #endif
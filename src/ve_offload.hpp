@@ -0,0 +1,249 @@
+/* Copyright (C) 2017-2022 by NEC Corporation
+ * Copyright (C) 2020-2022 Erich Focht  
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+/**
+ * @file ve_offload.hpp
+ * @brief typed C++17 interface for calling VE functions
+ *
+ * veo::call<double(int64_t, double *, float)>(ctx, sym, a, veo::in(buf, n), f)
+ * checks the arguments against the signature at compile time and packs
+ * each of them into its register image with a few stores. Pointer
+ * parameters take a VEMVA, as integer or veo::vemva, or a VH buffer of
+ * the pointed-to type wrapped by veo::in(), veo::out() or veo::inout(),
+ * which is passed on the VE stack. VH pointers are rejected. The
+ * call is submitted with veo_call_async_argv() and returns a
+ * veo::Future of the result type.
+ */
+#ifndef _VE_OFFLOAD_HPP_
+#define _VE_OFFLOAD_HPP_
+
+#if __cplusplus >= 201703L
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "ve_offload.h"
+
+namespace veo {
+
+/**
+ * @brief VE address for a pointer parameter
+ */
+struct vemva {
+  uint64_t addr;
+};
+
+/**
+ * @brief VH buffer passed on the VE stack
+ */
+template <typename T, enum veo_args_intent I> struct StackBuffer {
+  T *ptr;
+  size_t count;		//!< number of elements
+};
+
+/**
+ * @brief buffer copied to the VE stack before the call
+ */
+template <typename T>
+constexpr StackBuffer<const T, VEO_INTENT_IN> in(const T *p, size_t n = 1)
+{
+  return {p, n};
+}
+
+/**
+ * @brief buffer copied from the VE stack after the call
+ */
+template <typename T>
+constexpr StackBuffer<T, VEO_INTENT_OUT> out(T *p, size_t n = 1)
+{
+  return {p, n};
+}
+
+/**
+ * @brief buffer copied to the VE stack and back
+ */
+template <typename T>
+constexpr StackBuffer<T, VEO_INTENT_INOUT> inout(T *p, size_t n = 1)
+{
+  return {p, n};
+}
+
+namespace detail {
+template <typename T> struct is_stack_buffer : std::false_type {};
+template <typename T, enum veo_args_intent I>
+struct is_stack_buffer<StackBuffer<T, I>> : std::true_type {
+  using element = T;
+  static constexpr enum veo_args_intent intent = I;
+};
+
+/**
+ * @brief argument a for parameter type P
+ */
+template <typename P, typename A> inline veo_call_arg pack(const A &a)
+{
+  veo_call_arg r{};
+  if constexpr (is_stack_buffer<A>::value) {
+    static_assert(std::is_pointer_v<P>, "buffers are passed for pointer parameters");
+    using E = std::remove_cv_t<std::remove_pointer_t<P>>;
+    static_assert(std::is_void_v<E> ||
+                  std::is_same_v<std::remove_cv_t<
+                                   typename is_stack_buffer<A>::element>, E>,
+                  "buffer element type differs from the parameter");
+    r.buff = const_cast<void *>(static_cast<const void *>(a.ptr));
+    r.len = a.count * sizeof(*a.ptr);
+    r.intent = is_stack_buffer<A>::intent;
+    r.kind = VEO_CALL_ARG_BUFFER;
+  } else if constexpr (std::is_pointer_v<P>) {
+    static_assert(!std::is_pointer_v<std::decay_t<A>>,
+                  "VH pointers are not VEMVAs, use veo::in/out/inout()");
+    static_assert(std::is_integral_v<A> || std::is_same_v<A, vemva>,
+                  "pointer parameters take a VEMVA or veo::in/out/inout()");
+    if constexpr (std::is_same_v<A, vemva>)
+      r.val = a.addr;
+    else
+      r.val = static_cast<uint64_t>(a);
+    r.len = 8;
+  } else if constexpr (std::is_same_v<P, double>) {
+    double d = a;
+    std::memcpy(&r.val, &d, sizeof(d));
+    r.len = 8;
+  } else if constexpr (std::is_same_v<P, float>) {
+    // a float is passed in the upper half of the register
+    float f = a;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    r.val = static_cast<uint64_t>(bits) << 32;
+    r.len = 8;
+  } else {
+    static_assert(std::is_integral_v<P> || std::is_enum_v<P>,
+                  "unsupported parameter type");
+    static_assert(sizeof(P) <= 8, "parameters are at most 8 bytes");
+    static_assert(!std::is_floating_point_v<std::decay_t<A>>,
+                  "floating arguments are not converted to integers");
+    P v = static_cast<P>(a);
+    r.val = static_cast<uint64_t>(static_cast<int64_t>(v));
+    r.len = sizeof(P);
+  }
+  return r;
+}
+
+/**
+ * @brief function result from the register image
+ */
+template <typename R> inline R unpack(uint64_t raw)
+{
+  if constexpr (std::is_same_v<R, double>) {
+    double d;
+    std::memcpy(&d, &raw, sizeof(d));
+    return d;
+  } else if constexpr (std::is_same_v<R, float>) {
+    uint32_t bits = static_cast<uint32_t>(raw >> 32);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  } else if constexpr (std::is_pointer_v<R>) {
+    return reinterpret_cast<R>(raw);
+  } else {
+    static_assert(std::is_integral_v<R> || std::is_enum_v<R>,
+                  "unsupported result type");
+    return static_cast<R>(raw);
+  }
+}
+} // namespace detail
+
+/**
+ * @brief pending result of a VE function call
+ *
+ * The result has to be collected, a future which was not waited for
+ * waits in its destructor.
+ */
+template <typename R> class Future {
+  veo_thr_ctxt *ctx;
+  uint64_t req;
+public:
+  Future(veo_thr_ctxt *c, uint64_t r) : ctx(c), req(r) {}
+  Future(Future &&f) noexcept : ctx(f.ctx), req(f.req) {
+    f.req = VEO_REQUEST_ID_INVALID;
+  }
+  Future(const Future &) = delete;
+  Future &operator=(const Future &) = delete;
+  ~Future() {
+    uint64_t raw;
+    if (this->req != VEO_REQUEST_ID_INVALID)
+      veo_call_wait_result(this->ctx, this->req, &raw);
+  }
+
+  bool valid() const { return this->req != VEO_REQUEST_ID_INVALID; }
+  uint64_t id() const { return this->req; }
+
+  /**
+   * @brief wait for the result
+   * @throw std::runtime_error if the call failed
+   */
+  R get() {
+    uint64_t raw = 0;
+    if (this->req == VEO_REQUEST_ID_INVALID)
+      throw std::runtime_error("veo::Future: no pending call");
+    int rc = veo_call_wait_result(this->ctx, this->req, &raw);
+    this->req = VEO_REQUEST_ID_INVALID;
+    if (rc != VEO_COMMAND_OK)
+      throw std::runtime_error("veo::Future: VE function call failed");
+    if constexpr (!std::is_void_v<R>)
+      return detail::unpack<R>(raw);
+  }
+};
+
+template <typename Sig> struct Caller;
+
+template <typename R, typename... P> struct Caller<R(P...)> {
+  template <typename... A>
+  static Future<R> call(veo_thr_ctxt *ctx, uint64_t addr, const A &...a) {
+    static_assert(sizeof...(P) == sizeof...(A),
+                  "number of arguments does not match the signature");
+    const std::array<veo_call_arg, sizeof...(P)> argv{{detail::pack<P>(a)...}};
+    return Future<R>(ctx, veo_call_async_argv(ctx, addr, sizeof...(P),
+                                              argv.data()));
+  }
+};
+
+/**
+ * @brief call a VE function asynchronously
+ *
+ * @tparam Sig signature of the VE function, e.g. double(int64_t, float)
+ * @param ctx VEO context to execute the function on VE
+ * @param addr VEMVA of the function
+ * @param a arguments
+ * @return future of the result, not valid if the submission failed
+ */
+template <typename Sig, typename... A>
+auto call(veo_thr_ctxt *ctx, uint64_t addr, const A &...a)
+{
+  return Caller<Sig>::call(ctx, addr, a...);
+}
+
+} // namespace veo
+
+#endif // __cplusplus >= 201703L
+#endif // _VE_OFFLOAD_HPP_
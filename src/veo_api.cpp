@@ -1,5 +1,6 @@
 #include "ve_offload.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <vector>
@@ -10,8 +11,11 @@
 #include <cstddef>
 #include <cstdarg>
 #include <map>
+#include <memory>
 
 #include "ProcHandle.hpp"
+#include "ProcTable.hpp"
+#include "ManagedMem.hpp"
 #include "CallArgs.hpp"
 #include "VEOException.hpp"
 #include "veo_hmem.h"
@@ -27,11 +31,27 @@ using veo::api::ProcHandleFromC;
 using veo::api::ContextFromC;
 using veo::api::CallArgsFromC;
 using veo::api::ThreadContextAttrFromC;
+using veo::api::StreamFromC;
 using veo::api::veo_args_set_;
 using veo::VEOException;
+using veo::StridedLayout;
 
 using veo_alloc_mem_async_data = std::tuple<veo_thr_ctxt*, uint64_t, size_t>;
 using veo_free_mem_async_data = std::tuple<veo_thr_ctxt*, uint64_t, uint64_t>;
+using veo_free_arena_data = std::pair<veo::VeArena*, uint64_t>;
+struct veo_alloc_mem_multi_async_data {
+  veo_thr_ctxt *ctx;
+  uint64_t req;
+  std::vector<size_t> sizes;
+  uint64_t *addrs;
+};
+struct veo_free_mem_multi_async_data {
+  veo_thr_ctxt *ctx;
+  uint64_t req;
+  veo::VeArena *arena;
+  std::vector<uint64_t> arena_addrs;	// freed on VH
+  std::vector<uint64_t> addrs;		// for the hooks
+};
 
 static std::map<void*, std::tuple<void (*)(void*, ...), void*>> static_hooks;
 static void (* alloc_hook)(void *, size_t);
@@ -42,6 +62,9 @@ static void _alloc_hmem_async_hook(void *, ...);
 static void _free_hmem_async_hook(void *, ...);
 static uint64_t _alloc_mem_async_hook(void*);
 static uint64_t _free_mem_async_hook(void*);
+static uint64_t _free_arena_mem(void*);
+static uint64_t _alloc_mem_multi_async_hook(void*);
+static uint64_t _free_mem_multi_async_hook(void*);
 static int set_venode_from_env(int);
 
 
@@ -202,12 +225,12 @@ int veo_proc_destroy(veo_proc_handle *proc)
 /**
  * @brief find a veo_proc_handle's identifier
  * @param [in] proc pointer to VEO process handle
- * @retval >= 0 VEO process identifier, i.e. index in the proc list
- * @retval -1 VEO process not found in list
+ * @retval >= 0 VEO process identifier, i.e. index in the proc table
+ * @retval -1 VEO process not found in the table
  */
 int veo_proc_identifier(veo_proc_handle *proc)
 {
-  return veo::_getProcIdentifier(ProcHandleFromC(proc));
+  return ProcHandleFromC(proc)->getProcIdentifier();
 }
 
 /**
@@ -278,7 +301,7 @@ uint64_t veo_get_sym(veo_proc_handle *proc, uint64_t libhdl,
 int veo_alloc_mem(veo_proc_handle *h, uint64_t *addr, const size_t size)
 {
   try {
-    *addr = ProcHandleFromC(h)->allocBuff(size);
+    *addr = ProcHandleFromC(h)->allocMem(size);
     if (*addr == 0UL)
       return -1;
     auto it = static_hooks.find((void *)&veo_alloc_mem);
@@ -304,14 +327,13 @@ int veo_alloc_mem(veo_proc_handle *h, uint64_t *addr, const size_t size)
  * This function allocates a VE memory buffer if h is a valid
  * handle. This function allocates a VH memory buffer if h is NULL.
  * This function returns the address with the process identifier.
- * Since the number of processes that can be identified by the process 
- * identifier is 16, this function will fail if the user attempts to 
- * identify more than 16 processes. The memory allocated using this 
+ * Up to VEO_MAX_HMEM_PROCS (4096) processes can be identified by the
+ * process identifier, this function fails for procs beyond. The memory allocated using this 
  * function must be transferred to the VE side with veo_args_set_hmem(),
  * and freed with veo_free_hmem(). The data transfer of this memory
  * between VH and VE, same VE, or different VE processes must be done 
  * by veo_hmemcpy(). veo_hmemcpy() allows user to transfer data from 
- * VH to VE, from VE to VH, from VH to VH, or VE to VE(same node). 
+ * VH to VE, from VE to VH, from VH to VH, or VE to VE. 
  * The transfer direction is determined from the identifier of 
  * the virtual address of the argument passed to veo_hmemcpy(). 
  * Users can check with veo_is_ve_addr() that the target address is 
@@ -337,19 +359,12 @@ int veo_alloc_hmem(veo_proc_handle *h, void **addr, const size_t size)
         return -1;
       return 0;
     }
-    int nprocs = ProcHandleFromC(h)->numProcs();
-    VEO_DEBUG("nprocs = %d", nprocs);
-    if (nprocs > VEO_MAX_HMEM_PROCS) {
-      VEO_ERROR("VEO procs exceeded VEO_MAX_HMEM_PROCS.");
+    int proc_ident = ProcHandleFromC(h)->getProcIdentifier();
+    if (proc_ident < 0)
       return -1;
-    }
     ret = veo_alloc_mem(h, &veaddr, size);
     if (ret != 0)
       return ret;
-    //std::lock_guard<std::mutex> lock(ProcHandle::__procs_mtx);
-    int proc_ident = ProcHandleFromC(h)->getProcIdentifier();
-    if (proc_ident < 0)
-      return proc_ident;
     *addr = (void *)SET_VE_FLAG(veaddr);
     *addr = (void *)SET_PROC_IDENT(*addr, proc_ident);
     auto it = static_hooks.find((void *)&veo_alloc_hmem);
@@ -380,7 +395,7 @@ int veo_alloc_hmem(veo_proc_handle *h, void **addr, const size_t size)
 int veo_free_mem(veo_proc_handle *h, uint64_t addr)
 {
   try {
-    ProcHandleFromC(h)->freeBuff(addr);
+    ProcHandleFromC(h)->freeMem(addr);
     auto it = static_hooks.find((void *)&veo_free_mem);
     if (it != static_hooks.end()) {
 #ifndef NOCPP17
@@ -398,28 +413,38 @@ int veo_free_mem(veo_proc_handle *h, uint64_t addr)
 }
 
 /**
- * @brief Free a VE memory buffer
+ * @brief Allocate a VE memory buffer with placement requirements
  *
- * This function free the memory allocated by veo_alloc_hmem().
+ * VEO_ALLOC_HUGEPAGE maps the buffer with 64MB VE pages, so it is
+ * aligned to 64MB and suitable for veo_register_mem_to_dmaatb().
+ * VEO_ALLOC_PREFAULT touches all pages of the buffer on the VE before
+ * returning, the first kernel using the buffer does not pay the page
+ * faults. Hooks registered for veo_alloc_mem() are called.
  *
- * @param [in] addr a pointer to VEMVA address
- * @retval 0 memory is successfully freed.
- * @retval -1 internal error.
+ * @param [in]  h VEO process handle
+ * @param [out] addr VEMVA address
+ * @param [in]  size size in bytes
+ * @param [in]  flags VEO_ALLOC_* flags or 0
+ * @param [in]  alignment alignment in bytes, a power of 2, or 0 for
+ *              the default alignment. At most 64MB with
+ *              VEO_ALLOC_HUGEPAGE.
+ * @retval 0 memory allocation succeeded.
+ * @retval -1 memory allocation failed or invalid arguments.
+ * @retval -2 internal error.
  */
-int veo_free_hmem(void *addr)
+int veo_alloc_mem_ex(veo_proc_handle *h, uint64_t *addr, const size_t size,
+                     uint64_t flags, size_t alignment)
 {
-  int ret = -1;
+  if ((alignment & (alignment - 1)) != 0 ||
+      (flags & ~(uint64_t)(VEO_ALLOC_HUGEPAGE | VEO_ALLOC_PREFAULT)) != 0) {
+    VEO_ERROR("invalid flags %#lx or alignment %lu", flags, alignment);
+    return -1;
+  }
   try {
-    //std::lock_guard<std::mutex> lock(ProcHandle::__procs_mtx);
-    if (!veo_is_ve_addr(addr)) {
-      free(addr);
-      return 0;
-    }
-    int proc_ident = GET_PROC_IDENT(addr);
-    veo::ProcHandle *p = veo::ProcHandle::getProcHandle(proc_ident);
-    veo_proc_handle *h = p->toCHandle();
-    ret = veo_free_mem(h, VIRT_ADDR_VE(addr));
-    auto it = static_hooks.find((void *)&veo_free_hmem);
+    *addr = ProcHandleFromC(h)->allocMemEx(size, flags, alignment);
+    if (*addr == 0UL)
+      return -1;
+    auto it = static_hooks.find((void *)&veo_alloc_mem);
     if (it != static_hooks.end()) {
 #ifndef NOCPP17
       auto&& [hook, payload] = (*it).second;
@@ -427,666 +452,1627 @@ int veo_free_hmem(void *addr)
       auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
       auto&& payload = (void *)std::get<1>((*it).second);
 #endif
-      hook(payload, h, addr);
+      hook(payload, h, addr, size);
     }
   } catch (VEOException &e) {
-    VEO_ERROR("failed to free memory : %s", e.what());
-    return -1;
+    return -2;
   }
-  return ret;
+  return 0;
 }
 
 /**
- * @brief Read VE memory
+ * @brief Allocate several VE memory buffers
+ *
+ * All buffers are allocated with a single request to the VE process,
+ * buffers served by the VE memory arena need no request at all. Hooks
+ * registered for veo_alloc_mem() are called for each buffer.
  *
  * @param [in]  h VEO process handle
- * @param [out] dst destination VHVA
- * @param [in]  src source VEMVA
- * @param [in]  size size in byte
- * @return zero upon success; negative upon failure.
+ * @param [in]  n number of buffers
+ * @param [in]  sizes sizes of the buffers in bytes
+ * @param [out] addrs VEMVA addresses of the buffers
+ * @retval 0 memory allocation succeeded.
+ * @retval -1 memory allocation failed, no buffer is allocated.
+ * @retval -2 internal error.
  */
-int veo_read_mem(veo_proc_handle *h, void *dst, uint64_t src, size_t size)
+int veo_alloc_mem_multi(veo_proc_handle *h, int n, const size_t *sizes,
+                        uint64_t *addrs)
 {
+  if (n < 0 || (n > 0 && (sizes == nullptr || addrs == nullptr)))
+    return -1;
   try {
-    return ProcHandleFromC(h)->readMem(dst, src, size);
+    if (ProcHandleFromC(h)->allocMemMulti(n, sizes, addrs) != 0)
+      return -1;
+    auto it = static_hooks.find((void *)&veo_alloc_mem);
+    if (it != static_hooks.end()) {
+#ifndef NOCPP17
+      auto&& [hook, payload] = (*it).second;
+#else
+      auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
+      auto&& payload = (void *)std::get<1>((*it).second);
+#endif
+      for (int i = 0; i < n; i++)
+        hook(payload, h, &addrs[i], sizes[i]);
+    }
   } catch (VEOException &e) {
-    return -1;
+    return -2;
   }
+  return 0;
 }
 
 /**
- * @brief Write VE memory
+ * @brief Free several VE memory buffers
  *
- * @param [in]  h VEO process handle
- * @param [out] dst destination VEMVA
- * @param [in]  src source VHVA
- * @param [in]  size size in byte
- * @return zero upon success; negative upon failure.
+ * All buffers are freed with a single request to the VE process.
+ * Hooks registered for veo_free_mem() are called for each buffer.
+ *
+ * @param [in] h VEO process handle
+ * @param [in] n number of buffers
+ * @param [in] addrs VEMVA addresses of the buffers
+ * @retval 0 memory is successfully freed.
+ * @retval -1 internal error.
  */
-int veo_write_mem(veo_proc_handle *h, uint64_t dst, const void *src,
-                  size_t size)
+int veo_free_mem_multi(veo_proc_handle *h, int n, const uint64_t *addrs)
 {
+  if (n < 0 || (n > 0 && addrs == nullptr))
+    return -1;
   try {
-    return ProcHandleFromC(h)->writeMem(dst, src, size);
+    if (ProcHandleFromC(h)->freeMemMulti(n, addrs) != 0)
+      return -1;
+    auto it = static_hooks.find((void *)&veo_free_mem);
+    if (it != static_hooks.end()) {
+#ifndef NOCPP17
+      auto&& [hook, payload] = (*it).second;
+#else
+      auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
+      auto&& payload = (void *)std::get<1>((*it).second);
+#endif
+      for (int i = 0; i < n; i++)
+        hook(payload, h, addrs[i]);
+    }
   } catch (VEOException &e) {
     return -1;
   }
+  return 0;
 }
 
 /**
- * @brief Copy VE/VH memory
+ * @brief Get the VE memory usage of a proc
  *
- * This function copies memory. 
- * When only the destination is the VE memory allocated by 
- * veo_alloc_hmem(), the data is transferred from VH to VE.
- * When only the source is the VE memory allocated by 
- * veo_alloc_hmem(), the data is transferred from VE to VH.
- * When both the source and the destination are VH memory, 
- * they are copied on VH.
- * When both the source and the destination are VE memory allocated 
- * by veo_alloc_hmem(), they are copied on VE. In this case, both 
- * the source and the destination need to be VE memory allocated to 
- * the same process.
- * When the source is VE memory attached by veo_shared_mem_attach() 
- * with VE_REGISTER_VEMVA and the destination is VE memory allocated 
- * by veo_alloc_hmem() to the same VE process, the data is transferred 
- * from the attached VE memory to the allocated VE memory.
- * When the source is VE memory allocated by veo_alloc_hmem() and the 
- * destination is VE memory attached by veo_shared_mem_attach() with 
- * VE_REGISTER_VEMVA to the same VE process, the data is transferred 
- * from the allocated VE memory to the attached VE memory.
+ * Counts the buffers allocated through veo_alloc_mem() and its
+ * variants, including the async and hmem ones, which were not freed
+ * through the VEO API yet. If the environment variable VEO_LEAK_REPORT
+ * is set to a nonzero value, buffers still allocated are reported when
+ * the proc is destroyed.
  *
- * @param [out] dst a pointer to destination
- * @param [in]  src a pointer to source
- * @param [in]  size size in byte
- * @return zero upon success; negative upon failure.
+ * @param [in]  h VEO process handle
+ * @param [out] st memory usage
+ * @retval 0 success.
+ * @retval -1 internal error.
  */
-int veo_hmemcpy(void *dst, const void *src, size_t size)
+int veo_get_mem_stats(veo_proc_handle *h, struct veo_mem_stats *st)
 {
-  try
-  {
-    //std::lock_guard<std::mutex> lock(ProcHandle::__procs_mtx);
-    veo_proc_handle *h;
-    veo::ProcHandle *p;
-    int proc_ident = -1;
-    if (IS_VE(dst) && !IS_VE(src)) { // VH to VE
-      proc_ident = GET_PROC_IDENT(dst);
-      p = veo::ProcHandle::getProcHandle(proc_ident);
-      h = p->toCHandle();
-      return veo_write_mem(h, VIRT_ADDR_VE(dst), src, size);
-      //return veo_write_mem(h, (uint64_t)dst, src, size);
-    } else if (!IS_VE(dst) && IS_VE(src)) { // VE to VH
-      proc_ident = GET_PROC_IDENT(src);
-      p = veo::ProcHandle::getProcHandle(proc_ident);
-      h = p->toCHandle();
-      //return veo_read_mem(h, dst, (uint64_t)src, size);
-      return veo_read_mem(h, dst, VIRT_ADDR_VE(src), size);
-    } else if (!IS_VE(dst) && !IS_VE(src)) { // VH to VH
-      memcpy(dst, src, size);
-      return 0;
-    } else { // VE to VE
-      VEO_DEBUG("copy data from VE to VE");
-      veo_proc_handle *dst_h = veo_get_proc_handle_from_hmem(dst);
-      veo_proc_handle *src_h = veo_get_proc_handle_from_hmem(src);
-      if (dst_h == src_h) { // Same VE processes
-	void *dst_mem = veo_get_hmem_addr((void *)dst);
-	void *src_mem = veo_get_hmem_addr((void *)src);
-	void *ret = ProcHandleFromC(src_h)->veMemcpy(dst_mem, src_mem, size);
-	return (int64_t)ret;
-      } else { // Different VE processes
-	VEO_ERROR("dst and src are memories on different nodes.");
-        return -1;
-      }
-    }
-  } catch (std::out_of_range &e) {
-    VEO_ERROR("failed to get process handler: %s", e.what());
+  if (st == nullptr)
     return -1;
-  } catch (VEOException &e) 
-  {
+  try {
+    ProcHandleFromC(h)->memStats()->get(st);
+  } catch (VEOException &e) {
     return -1;
   }
+  return 0;
 }
 
 /**
- * @brief Return number of open contexts in a proc
+ * @brief Allocate a VE buffer with a VH shadow
+ *
+ * The returned VH pointer is used like host memory. Writes to it are
+ * tracked per page: veo_args_set_managed() passes the VE buffer to a
+ * VE function and only the pages written since the last upload are
+ * transferred, queued on the context of the call right before it.
+ * Ranges written by VE code
+ * are read back with veo_sync_managed_from_ve().
+ *
+ * Write tracking uses write protection and a SIGSEGV handler, which
+ * is installed with the first managed buffer and passes other faults
+ * to the previous handler. System calls writing into a managed buffer
+ * fail with EFAULT for protected pages, call veo_sync_managed_to_ve()
+ * and touch the pages before.
  *
  * @param [in] h VEO process handle
- * @return number of open contexts: negative upon failure.
+ * @param [in] size size in byte
+ * @return VH address of the buffer upon success; NULL upon failure.
  */
-int veo_num_contexts(veo_proc_handle *h)
+void *veo_alloc_managed(veo_proc_handle *h, size_t size)
 {
-  if (h == nullptr) {
-    errno = EINVAL;
-    return -1;
+  try {
+    auto m = veo::ManagedMem::create(ProcHandleFromC(h), size);
+    return m->hostAddr();
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to allocate managed buffer: %s", e.what());
+    return nullptr;
   }
-  return ProcHandleFromC(h)->numContexts();
 }
 
 /**
- * @brief Return a pointer of VEO thread context in a proc
+ * @brief Free a buffer allocated by veo_alloc_managed()
  *
- * The argument idx takes an integer value zero or more and less 
- * than the result of veo_num_contexts(). The context with idx=0 
- * is the main context of the ProcHandle. It will not be destroyed 
- * when closed, instead it is destroyed when the proc is killed by 
- * veo_proc_destroy(), or when the program ends. veo_get_context() 
- * returns NULL if a user specifies idx with a value which is the 
- * result of veo_num_contexts() or more.
- * 
- * @param [in] proc VEO process handle
- * @param [in] idx a index which takes an integer value zero or more and less than the result of veo_num_contexts()
- * @return a pointer to VEO thread context upon success.
+ * Waits for queued uploads of the buffer. veo_args with the buffer
+ * fail to be called afterwards. Buffers which are not freed are freed
+ * by veo_proc_destroy().
+ *
+ * @param [in] ptr VH address of the buffer
+ * @retval 0 success.
+ * @retval -1 ptr is not a managed buffer.
  */
-veo_thr_ctxt *veo_get_context(veo_proc_handle *proc, int idx)
+int veo_free_managed(void *ptr)
 {
   try {
-    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->getContext(idx)->toCHandle();
-    auto rv = reinterpret_cast<intptr_t>(ctx);
-    if ( rv < 0 ) {
-      errno = -rv;
-      return NULL;
-    }
-    return ctx;
+    return veo::ManagedMem::remove(ptr);
   } catch (VEOException &e) {
-    VEO_ERROR("failed to retrieve context %d: %s", idx, e.what());
-    errno = e.err();
-    return NULL;
-  } catch (std::out_of_range &e) {
-    VEO_ERROR("failed to retrieve context %d: %s", idx, e.what());
-    return NULL;
-  } 
+    return -1;
+  }
 }
 
 /**
- * @brief open a VEO context
+ * @brief VE address of a managed buffer
  *
- * Create a new VEO context, a pseudo thread and VE thread for the context.
- * All attributes which veo_context_open_with_attr() can specify have default value.
+ * @param [in] ptr VH address inside a managed buffer
+ * @return VEMVA corresponding to ptr; 0 if ptr is not managed.
+ */
+uint64_t veo_managed_ve_addr(const void *ptr)
+{
+  auto m = veo::ManagedMem::get(ptr);
+  if (m == nullptr)
+    return 0;
+  return m->veAddr() + ((const char *)ptr - (const char *)m->hostAddr());
+}
+
+/**
+ * @brief set a managed buffer argument
  *
- * @param [in] proc VEO process handle
- * @return a pointer to VEO thread context upon success.
- * @retval NULL failed to create a VEO context.
+ * The argument is the VE address of the buffer. Its modified pages
+ * are uploaded whenever a call with these arguments is submitted.
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     ptr VH address of a managed buffer
+ * @return zero upon success; negative upon failure.
  */
-veo_thr_ctxt *veo_context_open(veo_proc_handle *proc)
+int veo_args_set_managed(struct veo_args *ca, int argnum, void *ptr)
 {
-  try {
-    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->openContext()->toCHandle();
-    auto rv = reinterpret_cast<intptr_t>(ctx);
-    if ( rv < 0 ) {
-      errno = -rv;
-      return NULL;
-    }
-    return ctx;
-  } catch (VEOException &e) {
-    VEO_ERROR("failed to open context: %s", e.what());
-    errno = e.err();
-    return NULL;
-  }
+  return veo_args_set_managed_range(ca, argnum, ptr, VEO_INTENT_IN, 0, 0);
 }
 
 /**
- * @brief open a VEO context with attributes.
+ * @brief set a managed buffer argument written by the VE function
  *
- * Create a new VEO context, a pseudo thread and VE thread for the context.
+ * Like veo_args_set_managed(). With VEO_INTENT_OUT or VEO_INTENT_INOUT
+ * the range the function writes is read back into the buffer, queued
+ * on the context of the call right after it. The result of the call
+ * includes the read. The range is not considered modified on VH, the
+ * host must not write its pages until the result was taken.
  *
- * @param [in] proc VEO process handle
- * @param [in] tca veo_thr_ctxt_attr object
- * @return a pointer to VEO thread context upon success.
- * @retval NULL failed to create a VEO context.
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     ptr VH address of a managed buffer
+ * @param [in]     inout VEO_INTENT_IN to read nothing back
+ * @param [in]     off offset of the range written by the function
+ * @param [in]     len length of the range
+ * @return zero upon success; negative upon failure.
  */
-veo_thr_ctxt *veo_context_open_with_attr(
-				veo_proc_handle *proc, veo_thr_ctxt_attr *tca)
+int veo_args_set_managed_range(struct veo_args *ca, int argnum, void *ptr,
+                               enum veo_args_intent inout, size_t off,
+                               size_t len)
 {
-  if ((tca == nullptr) || (proc == nullptr)) {
-    errno = EINVAL;
-    return NULL;
+  auto m = veo::ManagedMem::get(ptr);
+  if (m == nullptr || m->hostAddr() != ptr) {
+    VEO_ERROR("%p is not a managed buffer", ptr);
+    return -1;
   }
-  auto attr = ThreadContextAttrFromC(tca);
+  if (inout == VEO_INTENT_IN)
+    off = len = 0;
   try {
-    size_t stack_sz = attr->getStacksize();
-    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->openContext(stack_sz)->toCHandle();
-    auto rv = reinterpret_cast<intptr_t>(ctx);
-    if ( rv < 0 ) {
-      errno = -rv;
-      return NULL;
-    }
-    return ctx;
+    CallArgsFromC(ca)->setManaged(argnum, m, off, len);
+    return 0;
   } catch (VEOException &e) {
-    VEO_ERROR("failed to open context: %s", e.what());
-    errno = e.err();
-    return NULL;
+    VEO_ERROR("failed set_managed CallArgs(%d): %s", argnum, e.what());
+    return -1;
   }
 }
 
 /**
- * @brief close a VEO context
+ * @brief upload the modified pages of a managed buffer
  *
- * @param [in] ctx a VEO context to close
- * @retval 0 VEO context is successfully closed.
- * @retval non-zero failed to close VEO context.
+ * @param [in] ptr VH address of a managed buffer
+ * @retval 0 success.
+ * @retval -1 internal error.
  */
-int veo_context_close(veo_thr_ctxt *ctx)
+int veo_sync_managed_to_ve(void *ptr)
 {
-  auto c = ContextFromC(ctx);
-  if (c->isMain()) {
-    return 0;
+  auto m = veo::ManagedMem::get(ptr);
+  if (m == nullptr)
+    return -1;
+  try {
+    return m->syncToVE();
+  } catch (VEOException &e) {
+    return -1;
   }
-  veo::ProcHandle *p = c->proc;
-  p->delContext(c);
-  return 0;
 }
 
 /**
- * @brief synchronize a VEO context
+ * @brief read a range written by VE code into a managed buffer
  *
- * While the submission lock is held, wait until all
- * commands have been processed in this context.
+ * Only the range is transferred. It is not considered modified on VH,
+ * host modifications of pages completely inside the range are lost.
  *
- * @param [in] ctx the VEO context to synchronize
+ * @param [in] ptr VH address of a managed buffer
+ * @param [in] off offset of the range
+ * @param [in] len length of the range
+ * @retval 0 success.
+ * @retval -1 internal error.
  */
-void veo_context_sync(veo_thr_ctxt *ctx)
+int veo_sync_managed_from_ve(void *ptr, size_t off, size_t len)
 {
-  auto c = ContextFromC(ctx);
-  c->synchronize();
+  auto m = veo::ManagedMem::get(ptr);
+  if (m == nullptr)
+    return -1;
+  try {
+    return m->syncFromVE(off, len);
+  } catch (VEOException &e) {
+    return -1;
+  }
 }
 
 /**
- * @brief get VEO context state
+ * @brief number of bytes the next upload of a managed buffer transfers
  *
- * @param [in] ctx VEO context
- * @return the state of the VEO context state.
- * @retval VEO_STATE_RUNNING VEO context is running.
- * @retval VEO_STATE_EXIT VEO context  exited.
+ * @param [in] ptr VH address of a managed buffer
+ * @return modified bytes, rounded to pages; 0 if ptr is not managed.
  */
-int veo_get_context_state(veo_thr_ctxt *ctx)
+size_t veo_managed_dirty_bytes(void *ptr)
 {
-  return ContextFromC(ctx)->getState();
+  auto m = veo::ManagedMem::get(ptr);
+  return m != nullptr ? m->dirtyBytes() : 0;
 }
 
 /**
- * @brief allocate VEO arguments object (veo_args)
+ * @brief Release VE memory buffers cached by the VE process
  *
- * @return pointer to veo_args
- * @retval NULL the allocation of veo_args failed.
+ * Freed VE buffers of 64KiB and more are kept by the VE process for
+ * reuse, up to VEO_VE_ALLOC_CACHE bytes (default 256MiB). This hands
+ * the cached buffers back to the VE memory allocator.
+ *
+ * @param [in] h VEO process handle
+ * @param [in] keep number of bytes which may stay cached
+ * @return number of bytes released
+ * @retval -1 internal error.
  */
-veo_args *veo_args_alloc(void)
+int64_t veo_trim_mem(veo_proc_handle *h, size_t keep)
 {
   try {
-    auto rv = new veo::CallArgs();
-    return rv->toCHandle();
+    return ProcHandleFromC(h)->trimMem(keep);
   } catch (VEOException &e) {
-    errno = e.err();
-    return NULL;
+    return -1;
   }
 }
 
 /**
- * @brief set a 64-bit integer argument
+ * @brief Serve small VE buffers from VH managed arenas
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
- */
-int veo_args_set_i64(veo_args *ca, int argnum, int64_t val)
-{
-  return veo_args_set_(ca, argnum, val);
-}
-
-/**
- * @brief set a 64-bit uunsigned integer argument
+ * With a chunk size set, veo_alloc_mem() takes buffers of up to a
+ * quarter of the chunk size from chunks of VE memory reserved by VEO
+ * and sub-allocated on VH, without a round trip to the VE. Chunks are
+ * added when the arena is full and returned when they are empty,
+ * except for one spare chunk. Buffers in the arena are freed with
+ * veo_free_mem() or veo_free_mem_async(); veo_alloc_mem_async() still
+ * allocates from the VE process. The environment variable
+ * VEO_ARENA_CHUNK sets the initial chunk size.
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
+ * @param [in] h VEO process handle
+ * @param [in] chunk_size size of the VE chunks, 0 disables the arena
+ *             for new allocations
+ * @retval 0 success.
+ * @retval -1 internal error.
  */
-int veo_args_set_u64(veo_args *ca, int argnum, uint64_t val)
+int veo_set_arena_chunk(veo_proc_handle *h, size_t chunk_size)
 {
-  return veo_args_set_(ca, argnum, val);
+  if (h == nullptr) {
+    errno = EINVAL;
+    return -1;
+  }
+  ProcHandleFromC(h)->veArena()->setChunkSize(chunk_size);
+  return 0;
 }
 
 /**
- * @brief set a 32-bit integer argument
+ * @brief Free a VE memory buffer
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
- */
-int veo_args_set_i32(veo_args *ca, int argnum, int32_t val)
-{
-  return veo_args_set_(ca, argnum, val);
-}
-
-/**
- * @brief set a 32-bit unsigned integer argument
+ * This function free the memory allocated by veo_alloc_hmem().
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
+ * @param [in] addr a pointer to VEMVA address
+ * @retval 0 memory is successfully freed.
+ * @retval -1 internal error.
  */
-int veo_args_set_u32(veo_args *ca, int argnum, uint32_t val)
+int veo_free_hmem(void *addr)
 {
-  return veo_args_set_(ca, argnum, val);
+  int ret = -1;
+  try {
+    // the proc stays alive until the operation is done
+    veo::ProcTable::ReadGuard guard;
+    if (!veo_is_ve_addr(addr)) {
+      free(addr);
+      return 0;
+    }
+    int proc_ident = GET_PROC_IDENT(addr);
+    veo::ProcHandle *p = veo::ProcHandle::getProcHandle(proc_ident);
+    veo_proc_handle *h = p->toCHandle();
+    ret = veo_free_mem(h, VIRT_ADDR_VE(addr));
+    auto it = static_hooks.find((void *)&veo_free_hmem);
+    if (it != static_hooks.end()) {
+#ifndef NOCPP17
+      auto&& [hook, payload] = (*it).second;
+#else
+      auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
+      auto&& payload = (void *)std::get<1>((*it).second);
+#endif
+      hook(payload, h, addr);
+    }
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to free memory : %s", e.what());
+    return -1;
+  }
+  return ret;
 }
 
 /**
- * @brief set a 16-bit integer argument
+ * @brief Read VE memory
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
+ * @param [in]  h VEO process handle
+ * @param [out] dst destination VHVA
+ * @param [in]  src source VEMVA
+ * @param [in]  size size in byte
  * @return zero upon success; negative upon failure.
  */
-int veo_args_set_i16(veo_args *ca, int argnum, int16_t val)
+int veo_read_mem(veo_proc_handle *h, void *dst, uint64_t src, size_t size)
 {
-  return veo_args_set_(ca, argnum, val);
+  try {
+    return ProcHandleFromC(h)->readMem(dst, src, size);
+  } catch (VEOException &e) {
+    return -1;
+  }
 }
 
 /**
- * @brief set a 16-bit unsigned integer argument
+ * @brief Write VE memory
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
+ * @param [in]  h VEO process handle
+ * @param [out] dst destination VEMVA
+ * @param [in]  src source VHVA
+ * @param [in]  size size in byte
  * @return zero upon success; negative upon failure.
  */
-int veo_args_set_u16(veo_args *ca, int argnum, uint16_t val)
+int veo_write_mem(veo_proc_handle *h, uint64_t dst, const void *src,
+                  size_t size)
 {
-  return veo_args_set_(ca, argnum, val);
+  try {
+    return ProcHandleFromC(h)->writeMem(dst, src, size);
+  } catch (VEOException &e) {
+    return -1;
+  }
 }
 
 /**
- * @brief set a 8-bit integer argument
+ * @brief Register VH memory for zero-copy transfers
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
- */
-int veo_args_set_i8(veo_args *ca, int argnum, int8_t val)
-{
-  return veo_args_set_(ca, argnum, val);
-}
-
-/**
- * @brief set a 8-bit unsigned integer argument
+ * The buffer must be inside a System V shared memory segment which
+ * was allocated with SHM_HUGETLB. The segment is attached to the VE
+ * process with VHSHM, afterwards veo_read_mem(), veo_write_mem(),
+ * veo_async_read_mem() and veo_async_write_mem() move data from and
+ * to the buffer by VE DMA, without copying it through the VE-URPC
+ * communication buffers. Addresses and size of such transfers must
+ * be 4 byte aligned, otherwise the normal path is taken.
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
- */
-int veo_args_set_u8(veo_args *ca, int argnum, uint8_t val)
-{
-  return veo_args_set_(ca, argnum, val);
-}
-
-/**
- * @brief set a double precision floating point number argument
+ * Registrations are reference counted, registering a buffer which
+ * is already registered is cheap.
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
+ * @param [in] h VEO process handle
+ * @param [in] ptr VH address of the buffer
+ * @param [in] size size in byte
+ * @retval 0 the buffer is registered.
+ * @retval -1 registration failed.
  */
-int veo_args_set_double(veo_args *ca, int argnum, double val)
+int veo_register_host_mem(veo_proc_handle *h, void *ptr, size_t size)
 {
-  return veo_args_set_(ca, argnum, val);
+  try {
+    return ProcHandleFromC(h)->registerHostMem(ptr, size);
+  } catch (VEOException &e) {
+    return -1;
+  }
 }
 
 /**
- * @brief set a single precision floating point number argument
+ * @brief Drop a registration of VH memory
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val value to be set
- * @return zero upon success; negative upon failure.
+ * The VHSHM segment is detached from the VE process when its last
+ * registration is dropped.
+ *
+ * @param [in] h VEO process handle
+ * @param [in] ptr VH address passed to veo_register_host_mem()
+ * @retval 0 upon success.
+ * @retval -1 the buffer was not registered or detaching failed.
  */
-int veo_args_set_float(veo_args *ca, int argnum, float val)
+int veo_unregister_host_mem(veo_proc_handle *h, void *ptr)
 {
-  return veo_args_set_(ca, argnum, val);
+  try {
+    return ProcHandleFromC(h)->unregisterHostMem(ptr);
+  } catch (VEOException &e) {
+    return -1;
+  }
 }
 
 /**
- * @brief set VEO function calling argument pointing to buffer on stack
+ * @brief Set the number of channels used for large transfers
  *
- * @param [in,out] ca pointer to veo_args object
- * @param [in]     inout intent of argument. VEO_INTENT_IN, VEO_INTENT_OUT, VEO_INTENT_INOUT are supported
- * @param [in]     argnum argument number that is being set
- * @param [in]     buff char pointer to buffer that will be copied to the VE stack
- * @param [in]     len length of buffer that is copied to the VE stack
- * @retval  0 argumen is successfully set.
- * @retval -1 an error occurred.
+ * Memory transfers of at least 8MB between VH and VE are striped over
+ * n channels: the context issuing the transfer and n - 1 hidden
+ * transfer contexts, each with its own VE-URPC channel and VE thread.
+ * The transfer keeps a single request ID which completes when all
+ * stripes are done. The default is taken from VEO_XFER_CHANNELS.
  *
- * The buffer is copied to the stack and will look to the VE callee
- * like a local variable of the caller function. Use this to pass
- * structures to the VE "kernel" function. The size of arguments
- * passed on the stack is limited to 63MB, since the size of the
- * initial stack is 64MB. Allocate and use memory buffers on heap when
- * you have huge argument arrays to pass.
+ * @param [in] h VEO process handle
+ * @param [in] n number of channels (1..VEO_MAX_XFER_CHANNELS), 1 disables
+ *             striping
+ * @return the number of channels upon success; -1 upon failure.
  */
-int veo_args_set_stack(veo_args *ca, enum veo_args_intent inout,
-                       int argnum, char *buff, size_t len)
+int veo_set_xfer_channels(veo_proc_handle *h, int n)
 {
   try {
-    CallArgsFromC(ca)->setOnStack(inout, argnum, buff, len);
-    return 0;
+    return ProcHandleFromC(h)->setXferChannels(n);
   } catch (VEOException &e) {
-    VEO_ERROR("failed set_on_stack CallArgs(%d): %s",
-              argnum, e.what());
     return -1;
   }
 }
 
- /**
- * @brief set a heteroginious memory argument
- *
- * @note Remove the bit 63:59 flag by veo_get_hmem_addr(),
- *       when argument val set the memory allocated by veo_alloc_hmem().
+/**
+ * @brief Get the number of channels used for large transfers
  *
- * @param [in,out] ca veo_args
- * @param [in]     argnum the argnum-th argument
- * @param [in]     val a pointer to value to be set
- * @return zero upon success; negative upon failure.
+ * @param [in] h VEO process handle
+ * @return the number of channels.
  */
-int veo_args_set_hmem(struct veo_args *ca, int argnum, void *val)
+int veo_get_xfer_channels(veo_proc_handle *h)
 {
-  return veo_args_set_u64(ca, argnum, (uint64_t)val);
+  return ProcHandleFromC(h)->numXferChannels();
 }
 
 /**
- * @brief clear arguments set in VEO arguments object
+ * @brief Copy VE/VH memory
  *
- * @param [in,out] ca veo_args object
+ * This function copies memory. 
+ * When only the destination is the VE memory allocated by 
+ * veo_alloc_hmem(), the data is transferred from VH to VE.
+ * When only the source is the VE memory allocated by 
+ * veo_alloc_hmem(), the data is transferred from VE to VH.
+ * When both the source and the destination are VH memory, 
+ * they are copied on VH.
+ * When both the source and the destination are VE memory allocated 
+ * by veo_alloc_hmem() to the same process, they are copied on VE.
+ * When they belong to different processes, large copies go through
+ * VESHM and VE DMA if the memory can be registered, other copies are
+ * staged through VH buffers, overlapping the read from the source VE
+ * with the write to the destination VE.
+ * When the source is VE memory attached by veo_shared_mem_attach() 
+ * with VE_REGISTER_VEMVA and the destination is VE memory allocated 
+ * by veo_alloc_hmem() to the same VE process, the data is transferred 
+ * from the attached VE memory to the allocated VE memory.
+ * When the source is VE memory allocated by veo_alloc_hmem() and the 
+ * destination is VE memory attached by veo_shared_mem_attach() with 
+ * VE_REGISTER_VEMVA to the same VE process, the data is transferred 
+ * from the allocated VE memory to the attached VE memory.
+ *
+ * @param [out] dst a pointer to destination
+ * @param [in]  src a pointer to source
+ * @param [in]  size size in byte
+ * @return zero upon success; negative upon failure.
+ */
+int veo_hmemcpy(void *dst, const void *src, size_t size)
+{
+  try
+  {
+    // the proc stays alive until the operation is done
+    veo::ProcTable::ReadGuard guard;
+    veo_proc_handle *h;
+    veo::ProcHandle *p;
+    int proc_ident = -1;
+    if (IS_VE(dst) && !IS_VE(src)) { // VH to VE
+      proc_ident = GET_PROC_IDENT(dst);
+      p = veo::ProcHandle::getProcHandle(proc_ident);
+      h = p->toCHandle();
+      return veo_write_mem(h, VIRT_ADDR_VE(dst), src, size);
+      //return veo_write_mem(h, (uint64_t)dst, src, size);
+    } else if (!IS_VE(dst) && IS_VE(src)) { // VE to VH
+      proc_ident = GET_PROC_IDENT(src);
+      p = veo::ProcHandle::getProcHandle(proc_ident);
+      h = p->toCHandle();
+      //return veo_read_mem(h, dst, (uint64_t)src, size);
+      return veo_read_mem(h, dst, VIRT_ADDR_VE(src), size);
+    } else if (!IS_VE(dst) && !IS_VE(src)) { // VH to VH
+      memcpy(dst, src, size);
+      return 0;
+    } else { // VE to VE
+      VEO_DEBUG("copy data from VE to VE");
+      veo_proc_handle *dst_h = veo_get_proc_handle_from_hmem(dst);
+      veo_proc_handle *src_h = veo_get_proc_handle_from_hmem(src);
+      if (dst_h == src_h) { // Same VE processes
+	void *dst_mem = veo_get_hmem_addr((void *)dst);
+	void *src_mem = veo_get_hmem_addr((void *)src);
+	void *ret = ProcHandleFromC(src_h)->veMemcpy(dst_mem, src_mem, size);
+	return (int64_t)ret;
+      } else { // Different VE processes
+        return veo::api::hmemcpyProcs(dst_h, VIRT_ADDR_VE(dst), src_h,
+                                      VIRT_ADDR_VE(src), size);
+      }
+    }
+  } catch (std::out_of_range &e) {
+    VEO_ERROR("failed to get process handler: %s", e.what());
+    return -1;
+  } catch (VEOException &e) 
+  {
+    return -1;
+  }
+}
+
+/**
+ * @brief Asynchronously copy VE/VH memory
+ *
+ * Asynchronous counterpart of veo_hmemcpy(). The copy is submitted to
+ * ctx and can overlap with functions running in other contexts. VE
+ * memory must belong to the process of ctx, copies between VE
+ * processes are done by veo_hmemcpy().
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst a pointer to destination
+ * @param [in]  src a pointer to source
+ * @param [in]  size size in byte
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_hmemcpy_async(veo_thr_ctxt *ctx, void *dst, const void *src,
+                           size_t size)
+{
+  struct veo_hmemcpy_desc d = { dst, src, size };
+  return veo_hmemcpy_batch_async(ctx, &d, 1);
+}
+
+/**
+ * @brief Asynchronously copy a batch of VE/VH memory buffers
+ *
+ * The direction of each copy is decoded once for the batch, copies
+ * of the same direction are combined into few requests. The copies
+ * are not ordered against each other, buffers must not overlap.
+ * The returned request completes when all copies are done.
+ *
+ * @param [in]  ctx VEO context
+ * @param [in]  d array of (dst, src, size) triples
+ * @param [in]  n number of elements in d
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_hmemcpy_batch_async(veo_thr_ctxt *ctx,
+                                 const struct veo_hmemcpy_desc *d, int n)
+{
+  try {
+    return ContextFromC(ctx)->asyncHmemcpy(d, n);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief Return number of open contexts in a proc
+ *
+ * @param [in] h VEO process handle
+ * @return number of open contexts: negative upon failure.
+ */
+int veo_num_contexts(veo_proc_handle *h)
+{
+  if (h == nullptr) {
+    errno = EINVAL;
+    return -1;
+  }
+  return ProcHandleFromC(h)->numContexts();
+}
+
+/**
+ * @brief Return a pointer of VEO thread context in a proc
+ *
+ * The argument idx takes an integer value zero or more and less 
+ * than the result of veo_num_contexts(). The context with idx=0 
+ * is the main context of the ProcHandle. It will not be destroyed 
+ * when closed, instead it is destroyed when the proc is killed by 
+ * veo_proc_destroy(), or when the program ends. veo_get_context() 
+ * returns NULL if a user specifies idx with a value which is the 
+ * result of veo_num_contexts() or more.
+ * 
+ * @param [in] proc VEO process handle
+ * @param [in] idx a index which takes an integer value zero or more and less than the result of veo_num_contexts()
+ * @return a pointer to VEO thread context upon success.
+ */
+veo_thr_ctxt *veo_get_context(veo_proc_handle *proc, int idx)
+{
+  try {
+    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->getContext(idx)->toCHandle();
+    auto rv = reinterpret_cast<intptr_t>(ctx);
+    if ( rv < 0 ) {
+      errno = -rv;
+      return NULL;
+    }
+    return ctx;
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to retrieve context %d: %s", idx, e.what());
+    errno = e.err();
+    return NULL;
+  } catch (std::out_of_range &e) {
+    VEO_ERROR("failed to retrieve context %d: %s", idx, e.what());
+    return NULL;
+  } 
+}
+
+/**
+ * @brief open a VEO context
+ *
+ * Create a new VEO context, a pseudo thread and VE thread for the context.
+ * All attributes which veo_context_open_with_attr() can specify have default value.
+ *
+ * @param [in] proc VEO process handle
+ * @return a pointer to VEO thread context upon success.
+ * @retval NULL failed to create a VEO context.
+ */
+veo_thr_ctxt *veo_context_open(veo_proc_handle *proc)
+{
+  try {
+    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->openContext()->toCHandle();
+    auto rv = reinterpret_cast<intptr_t>(ctx);
+    if ( rv < 0 ) {
+      errno = -rv;
+      return NULL;
+    }
+    return ctx;
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to open context: %s", e.what());
+    errno = e.err();
+    return NULL;
+  }
+}
+
+/**
+ * @brief open a VEO context with attributes.
+ *
+ * Create a new VEO context, a pseudo thread and VE thread for the context.
+ *
+ * @param [in] proc VEO process handle
+ * @param [in] tca veo_thr_ctxt_attr object
+ * @return a pointer to VEO thread context upon success.
+ * @retval NULL failed to create a VEO context.
+ */
+veo_thr_ctxt *veo_context_open_with_attr(
+				veo_proc_handle *proc, veo_thr_ctxt_attr *tca)
+{
+  if ((tca == nullptr) || (proc == nullptr)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  auto attr = ThreadContextAttrFromC(tca);
+  try {
+    size_t stack_sz = attr->getStacksize();
+    int node = attr->getNumaNode();
+    veo_thr_ctxt *ctx = ProcHandleFromC(proc)->openContext(stack_sz, node)->toCHandle();
+    auto rv = reinterpret_cast<intptr_t>(ctx);
+    if ( rv < 0 ) {
+      errno = -rv;
+      return NULL;
+    }
+    return ctx;
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to open context: %s", e.what());
+    errno = e.err();
+    return NULL;
+  }
+}
+
+/**
+ * @brief close a VEO context
+ *
+ * @param [in] ctx a VEO context to close
+ * @retval 0 VEO context is successfully closed.
+ * @retval non-zero failed to close VEO context.
+ */
+int veo_context_close(veo_thr_ctxt *ctx)
+{
+  auto c = ContextFromC(ctx);
+  if (c->isMain()) {
+    return 0;
+  }
+  veo::ProcHandle *p = c->proc;
+  p->delContext(c);
+  return 0;
+}
+
+/**
+ * @brief synchronize a VEO context
+ *
+ * While the submission lock is held, wait until all
+ * commands have been processed in this context.
+ *
+ * @param [in] ctx the VEO context to synchronize
+ */
+void veo_context_sync(veo_thr_ctxt *ctx)
+{
+  auto c = ContextFromC(ctx);
+  c->synchronize();
+}
+
+/**
+ * @brief get VEO context state
+ *
+ * @param [in] ctx VEO context
+ * @return the state of the VEO context state.
+ * @retval VEO_STATE_RUNNING VEO context is running.
+ * @retval VEO_STATE_EXIT VEO context  exited.
+ */
+int veo_get_context_state(veo_thr_ctxt *ctx)
+{
+  return ContextFromC(ctx)->getState();
+}
+
+/**
+ * @brief allocate VEO arguments object (veo_args)
+ *
+ * @return pointer to veo_args
+ * @retval NULL the allocation of veo_args failed.
+ */
+veo_args *veo_args_alloc(void)
+{
+  try {
+    auto rv = new veo::CallArgs();
+    return rv->toCHandle();
+  } catch (VEOException &e) {
+    errno = e.err();
+    return NULL;
+  }
+}
+
+/**
+ * @brief set a 64-bit integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_i64(veo_args *ca, int argnum, int64_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 64-bit uunsigned integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_u64(veo_args *ca, int argnum, uint64_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 32-bit integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_i32(veo_args *ca, int argnum, int32_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 32-bit unsigned integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_u32(veo_args *ca, int argnum, uint32_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 16-bit integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_i16(veo_args *ca, int argnum, int16_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 16-bit unsigned integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_u16(veo_args *ca, int argnum, uint16_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 8-bit integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_i8(veo_args *ca, int argnum, int8_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a 8-bit unsigned integer argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_u8(veo_args *ca, int argnum, uint8_t val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a double precision floating point number argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_double(veo_args *ca, int argnum, double val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set a single precision floating point number argument
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_float(veo_args *ca, int argnum, float val)
+{
+  return veo_args_set_(ca, argnum, val);
+}
+
+/**
+ * @brief set VEO function calling argument pointing to buffer on stack
+ *
+ * @param [in,out] ca pointer to veo_args object
+ * @param [in]     inout intent of argument. VEO_INTENT_IN, VEO_INTENT_OUT, VEO_INTENT_INOUT are supported
+ * @param [in]     argnum argument number that is being set
+ * @param [in]     buff char pointer to buffer that will be copied to the VE stack
+ * @param [in]     len length of buffer that is copied to the VE stack
+ * @retval  0 argumen is successfully set.
+ * @retval -1 an error occurred.
+ *
+ * The buffer is copied to the stack and will look to the VE callee
+ * like a local variable of the caller function. Use this to pass
+ * structures to the VE "kernel" function. The size of arguments
+ * passed on the stack is limited to 63MB, since the size of the
+ * initial stack is 64MB. Allocate and use memory buffers on heap when
+ * you have huge argument arrays to pass.
+ */
+int veo_args_set_stack(veo_args *ca, enum veo_args_intent inout,
+                       int argnum, char *buff, size_t len)
+{
+  try {
+    CallArgsFromC(ca)->setOnStack(inout, argnum, buff, len);
+    return 0;
+  } catch (VEOException &e) {
+    VEO_ERROR("failed set_on_stack CallArgs(%d): %s",
+              argnum, e.what());
+    return -1;
+  }
+}
+
+ /**
+ * @brief set a heteroginious memory argument
+ *
+ * @note Remove the bit 63:59 flag by veo_get_hmem_addr(),
+ *       when argument val set the memory allocated by veo_alloc_hmem().
+ *
+ * @param [in,out] ca veo_args
+ * @param [in]     argnum the argnum-th argument
+ * @param [in]     val a pointer to value to be set
+ * @return zero upon success; negative upon failure.
+ */
+int veo_args_set_hmem(struct veo_args *ca, int argnum, void *val)
+{
+  return veo_args_set_u64(ca, argnum, (uint64_t)val);
+}
+
+/**
+ * @brief clear arguments set in VEO arguments object
+ *
+ * @param [in,out] ca veo_args object
+ */
+void veo_args_clear(veo_args *ca)
+{
+  CallArgsFromC(ca)->clear();
+}
+
+/**
+ * @brief free VEO arguments object
+ *
+ * @param [in] ca veo_args object
+ */
+void veo_args_free(veo_args *ca)
+{
+  delete CallArgsFromC(ca);
+}
+
+/**
+ * @brief Call VE function synchronously on a proc
+ *
+ * @param [in]  h VEO process handle
+ * @param [in]  addr VEMVA address of VE function
+ * @param [in]  ca call args
+ * @param [out] result pointer to result variable
+ * @return zero upon success; negative upon failure.
+ */
+int veo_call_sync(veo_proc_handle *h, uint64_t addr, veo_args *ca,
+                  uint64_t *result)
+{
+  try {
+    return ProcHandleFromC(h)->callSync(addr, *CallArgsFromC(ca), result);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief request a VE thread to call a function
+ *
+ * @param [in] ctx VEO context to execute the function on VE.
+ * @param [in] addr VEMVA of the function to call
+ * @param [in] args arguments to be passed to the function
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_call_async(veo_thr_ctxt *ctx, uint64_t addr, veo_args *args)
+{
+  try {
+    return ContextFromC(ctx)->callAsync(addr, *CallArgsFromC(args));
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief request a VE thread to call a function with packed arguments
+ *
+ * The arguments are given as their register images, as built by the
+ * typed C++ API in ve_offload.hpp, and go to the context without a
+ * veo_args object. Buffers passed on the stack must stay valid until
+ * the result is collected. Values must have a NULL buff, buffers a
+ * non-NULL one unless their length is 0.
+ *
+ * @param [in] ctx VEO context to execute the function on VE.
+ * @param [in] addr VEMVA of the function to call
+ * @param [in] nargs number of arguments
+ * @param [in] argv arguments
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_call_async_argv(veo_thr_ctxt *ctx, uint64_t addr, int nargs,
+                             const struct veo_call_arg *argv)
+{
+  try {
+    veo::CallArgs args;
+    for (int i = 0; i < nargs; i++) {
+      auto &a = argv[i];
+      if (a.kind == VEO_CALL_ARG_BUFFER && (a.buff != nullptr || a.len == 0)) {
+        args.setOnStack(a.intent, i, (char *)a.buff, a.len);
+      } else if (a.kind == VEO_CALL_ARG_VALUE && a.buff == nullptr) {
+        args.setImage(i, a.val, a.len);
+      } else {
+        VEO_ERROR("argument %d: kind %d does not match buffer %p",
+                  i, a.kind, a.buff);
+        return VEO_REQUEST_ID_INVALID;
+      }
+    }
+    return ContextFromC(ctx)->callAsync(addr, args);
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to call %lx: %s", addr, e.what());
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief write inputs, call a VE function and read outputs
+ *
+ * The input buffers are written to VE memory, the function is called
+ * and the output buffers are read from VE memory after it returned.
+ * The VE executes the whole sequence without waiting for the VH in
+ * between. The returned request ID completes after the outputs were
+ * read, its result is the return value of the function.
+ *
+ * @param [in] ctx VEO context to execute the function on VE.
+ * @param [in] addr VEMVA of the function to call
+ * @param [in] args arguments to be passed to the function
+ * @param [in] in_iov buffers to write before the call
+ * @param [in] in_cnt number of input buffers
+ * @param [in] out_iov buffers to read after the call
+ * @param [in] out_cnt number of output buffers
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_call_async_with_io(veo_thr_ctxt *ctx, uint64_t addr,
+                                veo_args *args,
+                                const struct veo_iovec *in_iov, int in_cnt,
+                                const struct veo_iovec *out_iov, int out_cnt)
+{
+  try {
+    return ContextFromC(ctx)->callAsyncWithIO(addr, *CallArgsFromC(args),
+                                              in_iov, in_cnt, out_iov, out_cnt);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief pick up a resutl from VE function if it has finished
+ *
+ * @param [in]  ctx VEO context
+ * @param [in]  reqid request ID
+ * @param [out] retp pointer to buffer to store the return value from the function.
+ * @retval VEO_COMMAND_OK function is successfully returned.
+ * @retval VEO_COMMAND_EXCEPTION an exception occurred on function.
+ * @retval VEO_COMMAND_ERROR an error occurred on function.
+ * @retval VEO_COMMAND_UNFINISHED function is not finished.
+ * @retval -1 internal error.
+ */
+int veo_call_peek_result(veo_thr_ctxt *ctx, uint64_t reqid, uint64_t *retp)
+{
+  try {
+    return ContextFromC(ctx)->callPeekResult(reqid, retp);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief pick up a resutl from VE function
+
+ * @param [in]  ctx VEO context
+ * @param [in]  reqid request ID
+ * @param [out] retp pointer to buffer to store the return value from the function.
+ * @retval VEO_COMMAND_OK function is successfully returned.
+ * @retval VEO_COMMAND_EXCEPTION an exception occurred on execution.
+ * @retval VEO_COMMAND_ERROR an error occurred on execution.
+ * @retval VEO_COMMAND_UNFINISHED function is not finished.
+ * @retval -1 internal error.
+ */
+int veo_call_wait_result(veo_thr_ctxt *ctx, uint64_t reqid, uint64_t *retp)
+{
+  try {
+    return ContextFromC(ctx)->callWaitResult(reqid, retp);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief Allocate a VE memory buffer asynchronously
+ *
+ * The buffer allocation is queued as a urpc alloc request which
+ * returns a request ID. This can be queried to retrieve the
+ * allocated address as result of the request.
+ *
+ * @param [in]  ctx VEO thread context
+ * @param [in]  size size in bytes
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_alloc_mem_async(veo_thr_ctxt *ctx, const size_t size)
+{
+  uint64_t req;
+  try {
+    req = ContextFromC(ctx)->allocMemAsync(size);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+  if (static_hooks.count((void *)&veo_alloc_mem_async) > 0) {
+    return veo_call_async_vh(ctx, _alloc_mem_async_hook,
+                             new veo_alloc_mem_async_data(ctx, req, size));
+  }
+  return req;
+}
+
+/**
+ * @brief Free a VE memory buffer asynchronously
+ *
+ * The buffer de-allocation is queued as a urpc request which
+ * returns a request ID. This can be queried to retrieve the
+ * allocated address as result of the request.
+ *
+ * @param [in]  ctx VEO thread context
+ * @param [in]  addr VEMVA address
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_free_mem_async(veo_thr_ctxt *ctx, uint64_t addr)
+{
+  uint64_t req;
+  try {
+    auto c = ContextFromC(ctx);
+    c->proc->memStats()->remove(addr);
+    if (c->proc->veArena()->owns(addr))
+      req = c->callVHAsync(_free_arena_mem,
+                           new veo_free_arena_data(c->proc->veArena(), addr));
+    else
+      req = c->genericAsyncReq(URPC_CMD_FREE, (char *)"L", addr);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+  if (static_hooks.count((void *)&veo_free_mem_async) > 0) {
+    return veo_call_async_vh(ctx, _free_mem_async_hook,
+                             new veo_free_mem_async_data(ctx, req, addr));
+  }
+  return req;
+}
+
+/**
+ * @brief Allocate several VE memory buffers asynchronously
+ *
+ * The allocation of as many buffers as fit into one urpc command is
+ * queued as a single urpc request, more buffers take several. The
+ * addresses are stored into addrs when the request has finished, its
+ * result is 0. If one allocation fails no buffer is allocated: the
+ * buffers of the other requests are freed again by requests queued
+ * on ctx and all addresses are 0. Hooks registered for veo_alloc_mem_async() are called for
+ * each buffer.
+ *
+ * @param [in]  ctx VEO thread context
+ * @param [in]  n number of buffers, at least 1
+ * @param [in]  sizes sizes of the buffers in bytes
+ * @param [out] addrs VEMVA addresses, must stay valid until the
+ *              request has finished
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_alloc_mem_multi_async(veo_thr_ctxt *ctx, int n,
+                                   const size_t *sizes, uint64_t *addrs)
+{
+  if (n <= 0 || sizes == nullptr || addrs == nullptr)
+    return VEO_REQUEST_ID_INVALID;
+  uint64_t req = VEO_REQUEST_ID_INVALID;
+  std::fill(addrs, addrs + n, 0);
+  try {
+    auto c = ContextFromC(ctx);
+    int maxv = (int)c->maxAllocV();
+    // several chunks need the VH call to roll back on failure
+    bool finish = n > maxv ||
+                  static_hooks.count((void *)&veo_alloc_mem_async) > 0;
+    c->reqBlockBegin();
+    for (int off = 0; off < n; off += maxv) {
+      int cnt = std::min(n - off, maxv);
+      std::vector<uint64_t> sz(sizes + off, sizes + off + cnt);
+      req = c->allocMultiAsync(std::move(sz), addrs + off, req);
+      if (req == VEO_REQUEST_ID_INVALID)
+        break;
+    }
+    if (req != VEO_REQUEST_ID_INVALID && finish) {
+      // the VH call frees data, keep it if the call was not queued
+      std::unique_ptr<veo_alloc_mem_multi_async_data> data(
+        new veo_alloc_mem_multi_async_data{ctx, req,
+              std::vector<size_t>(sizes, sizes + n), addrs});
+      req = c->callVHAsync(_alloc_mem_multi_async_hook, data.get());
+      if (req != VEO_REQUEST_ID_INVALID)
+        data.release();
+    }
+    c->reqBlockEnd();
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+  return req;
+}
+
+/**
+ * @brief Free several VE memory buffers asynchronously
+ *
+ * The buffers are freed by a single urpc request. Hooks registered
+ * for veo_free_mem_async() are called for each buffer.
+ *
+ * @param [in]  ctx VEO thread context
+ * @param [in]  n number of buffers, at least 1
+ * @param [in]  addrs VEMVA addresses of the buffers
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_free_mem_multi_async(veo_thr_ctxt *ctx, int n,
+                                  const uint64_t *addrs)
+{
+  if (n <= 0 || addrs == nullptr)
+    return VEO_REQUEST_ID_INVALID;
+  uint64_t req = VEO_REQUEST_ID_INVALID;
+  auto data = new veo_free_mem_multi_async_data{ctx, VEO_REQUEST_ID_INVALID,
+                                                nullptr, {}, {}};
+  try {
+    auto c = ContextFromC(ctx);
+    data->arena = c->proc->veArena();
+    std::vector<uint64_t> veaddrs;
+    for (int i = 0; i < n; i++) {
+      c->proc->memStats()->remove(addrs[i]);
+      if (data->arena->owns(addrs[i]))
+        data->arena_addrs.push_back(addrs[i]);
+      else if (addrs[i] != 0)
+        veaddrs.push_back(addrs[i]);
+    }
+    size_t maxv = c->maxAllocV();
+    c->reqBlockBegin();
+    for (size_t off = 0; off < veaddrs.size(); off += maxv) {
+      size_t cnt = std::min(veaddrs.size() - off, maxv);
+      std::vector<uint64_t> a(veaddrs.begin() + off,
+                              veaddrs.begin() + off + cnt);
+      req = c->freeMultiAsync(std::move(a), req);
+      if (req == VEO_REQUEST_ID_INVALID)
+        break;
+    }
+    c->reqBlockEnd();
+    if (!veaddrs.empty() && req == VEO_REQUEST_ID_INVALID) {
+      delete data;
+      return VEO_REQUEST_ID_INVALID;
+    }
+  } catch (VEOException &e) {
+    delete data;
+    return VEO_REQUEST_ID_INVALID;
+  }
+  bool hooked = static_hooks.count((void *)&veo_free_mem_async) > 0;
+  if (data->arena_addrs.empty() && !hooked) {
+    delete data;
+    return req;
+  }
+  data->req = req;
+  if (hooked)
+    data->addrs.assign(addrs, addrs + n);
+  return veo_call_async_vh(ctx, _free_mem_multi_async_hook, data);
+}
+
+/**
+ * @brief Asynchronously read VE memory
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VHVA
+ * @param [in]  src source VEMVA
+ * @param [in]  size size in byte
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_async_read_mem(veo_thr_ctxt *ctx, void *dst, uint64_t src,
+                            size_t size)
+{
+  try {
+    return ContextFromC(ctx)->asyncReadMem(dst, src, size);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief Asynchronously write VE memory
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VEMVA
+ * @param [in]  src source VHVA
+ * @param [in]  size size in byte
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
+ */
+uint64_t veo_async_write_mem(veo_thr_ctxt *ctx, uint64_t dst, const void *src,
+                             size_t size)
+{
+  try {
+    return ContextFromC(ctx)->asyncWriteMem(dst, src, size);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
+}
+
+/**
+ * @brief Asynchronously read VE memory, reporting partial progress
+ *
+ * The transfer is done as a chain of fragments on ctx, prog->done
+ * holds the number of leading bytes of dst which are in place. It is
+ * not striped over transfer channels and does not use VE DMA.
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VHVA
+ * @param [in]  src source VEMVA
+ * @param [in]  size size in byte
+ * @param [in]  prog progress record, valid until the request is done
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-void veo_args_clear(veo_args *ca)
+uint64_t veo_async_read_mem_progress(veo_thr_ctxt *ctx, void *dst, uint64_t src,
+                                     size_t size, veo_xfer_progress *prog)
 {
-  CallArgsFromC(ca)->clear();
+  try {
+    return ContextFromC(ctx)->asyncReadMemProgress(dst, src, size, prog);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
 }
 
 /**
- * @brief free VEO arguments object
+ * @brief Asynchronously write VE memory, reporting partial progress
  *
- * @param [in] ca veo_args object
+ * prog->done holds the number of leading bytes of dst which were
+ * written, see veo_async_read_mem_progress().
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VEMVA
+ * @param [in]  src source VHVA
+ * @param [in]  size size in byte
+ * @param [in]  prog progress record, valid until the request is done
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-void veo_args_free(veo_args *ca)
+uint64_t veo_async_write_mem_progress(veo_thr_ctxt *ctx, uint64_t dst,
+                                      const void *src, size_t size,
+                                      veo_xfer_progress *prog)
 {
-  delete CallArgsFromC(ca);
+  try {
+    return ContextFromC(ctx)->asyncWriteMemProgress(dst, src, size, prog);
+  } catch (VEOException &e) {
+    return VEO_REQUEST_ID_INVALID;
+  }
 }
 
 /**
- * @brief Call VE function synchronously on a proc
+ * @brief Asynchronously read a 2D block from VE memory
  *
- * @param [in]  h VEO process handle
- * @param [in]  addr VEMVA address of VE function
- * @param [in]  ca call args
- * @param [out] result pointer to result variable
- * @return zero upon success; negative upon failure.
+ * Reads height rows of width bytes. Consecutive rows are spitch bytes
+ * apart in VE memory and are stored dpitch bytes apart on VH. Many
+ * rows are carried by one transfer fragment.
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VHVA of the first row
+ * @param [in]  dpitch distance of rows at the destination in byte
+ * @param [in]  src source VEMVA of the first row
+ * @param [in]  spitch distance of rows at the source in byte
+ * @param [in]  width row width in byte
+ * @param [in]  height number of rows
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-int veo_call_sync(veo_proc_handle *h, uint64_t addr, veo_args *ca,
-                  uint64_t *result)
+uint64_t veo_async_read_mem_2d(veo_thr_ctxt *ctx, void *dst, size_t dpitch,
+                               uint64_t src, size_t spitch,
+                               size_t width, size_t height)
 {
+  StridedLayout dl = {dpitch, dpitch * height, height};
+  StridedLayout sl = {spitch, spitch * height, height};
   try {
-    return ProcHandleFromC(h)->callSync(addr, *CallArgsFromC(ca), result);
+    return ContextFromC(ctx)->asyncReadMemStrided(dst, dl, src, sl, width, height);
   } catch (VEOException &e) {
-    return -1;
+    return VEO_REQUEST_ID_INVALID;
   }
 }
 
 /**
- * @brief request a VE thread to call a function
+ * @brief Asynchronously write a 2D block to VE memory
  *
- * @param [in] ctx VEO context to execute the function on VE.
- * @param [in] addr VEMVA of the function to call
- * @param [in] args arguments to be passed to the function
+ * Writes height rows of width bytes. Consecutive rows are spitch bytes
+ * apart on VH and are stored dpitch bytes apart in VE memory. Many
+ * rows are carried by one transfer fragment.
+ *
+ * @param [in]  ctx VEO context
+ * @param [out] dst destination VEMVA of the first row
+ * @param [in]  dpitch distance of rows at the destination in byte
+ * @param [in]  src source VHVA of the first row
+ * @param [in]  spitch distance of rows at the source in byte
+ * @param [in]  width row width in byte
+ * @param [in]  height number of rows
  * @return request ID
  * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-uint64_t veo_call_async(veo_thr_ctxt *ctx, uint64_t addr, veo_args *args)
+uint64_t veo_async_write_mem_2d(veo_thr_ctxt *ctx, uint64_t dst, size_t dpitch,
+                                const void *src, size_t spitch,
+                                size_t width, size_t height)
 {
+  StridedLayout dl = {dpitch, dpitch * height, height};
+  StridedLayout sl = {spitch, spitch * height, height};
   try {
-    return ContextFromC(ctx)->callAsync(addr, *CallArgsFromC(args));
+    return ContextFromC(ctx)->asyncWriteMemStrided(dst, dl, src, sl, width, height);
   } catch (VEOException &e) {
     return VEO_REQUEST_ID_INVALID;
   }
 }
 
 /**
- * @brief pick up a resutl from VE function if it has finished
+ * @brief Asynchronously read a 3D block from VE memory
+ *
+ * Reads depth slices of height rows of width bytes. The block lies
+ * inside arrays whose slices have sheight (source) and dheight
+ * (destination) rows of spitch and dpitch bytes.
  *
  * @param [in]  ctx VEO context
- * @param [in]  reqid request ID
- * @param [out] retp pointer to buffer to store the return value from the function.
- * @retval VEO_COMMAND_OK function is successfully returned.
- * @retval VEO_COMMAND_EXCEPTION an exception occurred on function.
- * @retval VEO_COMMAND_ERROR an error occurred on function.
- * @retval VEO_COMMAND_UNFINISHED function is not finished.
- * @retval -1 internal error.
+ * @param [out] dst destination VHVA of the first row
+ * @param [in]  dpitch distance of rows at the destination in byte
+ * @param [in]  dheight rows per slice of the destination array
+ * @param [in]  src source VEMVA of the first row
+ * @param [in]  spitch distance of rows at the source in byte
+ * @param [in]  sheight rows per slice of the source array
+ * @param [in]  width row width in byte
+ * @param [in]  height number of rows per slice
+ * @param [in]  depth number of slices
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-int veo_call_peek_result(veo_thr_ctxt *ctx, uint64_t reqid, uint64_t *retp)
+uint64_t veo_async_read_mem_3d(veo_thr_ctxt *ctx, void *dst, size_t dpitch,
+                               size_t dheight, uint64_t src, size_t spitch,
+                               size_t sheight, size_t width, size_t height,
+                               size_t depth)
 {
+  if (dheight < height || sheight < height)
+    return VEO_REQUEST_ID_INVALID;
+  StridedLayout dl = {dpitch, dpitch * dheight, height};
+  StridedLayout sl = {spitch, spitch * sheight, height};
   try {
-    return ContextFromC(ctx)->callPeekResult(reqid, retp);
+    return ContextFromC(ctx)->asyncReadMemStrided(dst, dl, src, sl, width,
+                                                  height * depth);
   } catch (VEOException &e) {
-    return -1;
+    return VEO_REQUEST_ID_INVALID;
   }
 }
 
 /**
- * @brief pick up a resutl from VE function
-
+ * @brief Asynchronously write a 3D block to VE memory
+ *
+ * Writes depth slices of height rows of width bytes. The block lies
+ * inside arrays whose slices have sheight (source) and dheight
+ * (destination) rows of spitch and dpitch bytes.
+ *
  * @param [in]  ctx VEO context
- * @param [in]  reqid request ID
- * @param [out] retp pointer to buffer to store the return value from the function.
- * @retval VEO_COMMAND_OK function is successfully returned.
- * @retval VEO_COMMAND_EXCEPTION an exception occurred on execution.
- * @retval VEO_COMMAND_ERROR an error occurred on execution.
- * @retval VEO_COMMAND_UNFINISHED function is not finished.
- * @retval -1 internal error.
+ * @param [out] dst destination VEMVA of the first row
+ * @param [in]  dpitch distance of rows at the destination in byte
+ * @param [in]  dheight rows per slice of the destination array
+ * @param [in]  src source VHVA of the first row
+ * @param [in]  spitch distance of rows at the source in byte
+ * @param [in]  sheight rows per slice of the source array
+ * @param [in]  width row width in byte
+ * @param [in]  height number of rows per slice
+ * @param [in]  depth number of slices
+ * @return request ID
+ * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-int veo_call_wait_result(veo_thr_ctxt *ctx, uint64_t reqid, uint64_t *retp)
+uint64_t veo_async_write_mem_3d(veo_thr_ctxt *ctx, uint64_t dst, size_t dpitch,
+                                size_t dheight, const void *src, size_t spitch,
+                                size_t sheight, size_t width, size_t height,
+                                size_t depth)
 {
+  if (dheight < height || sheight < height)
+    return VEO_REQUEST_ID_INVALID;
+  StridedLayout dl = {dpitch, dpitch * dheight, height};
+  StridedLayout sl = {spitch, spitch * sheight, height};
   try {
-    return ContextFromC(ctx)->callWaitResult(reqid, retp);
+    return ContextFromC(ctx)->asyncWriteMemStrided(dst, dl, src, sl, width,
+                                                   height * depth);
   } catch (VEOException &e) {
-    return -1;
+    return VEO_REQUEST_ID_INVALID;
   }
 }
 
 /**
- * @brief Allocate a VE memory buffer asynchronously
+ * @brief Asynchronously read VE memory into several VH buffers
  *
- * The buffer allocation is queued as a urpc alloc request which
- * returns a request ID. This can be queried to retrieve the
- * allocated address as result of the request.
+ * Small buffers are gathered by the VE into few transfers, the whole
+ * set of buffers completes under one request ID.
  *
- * @param [in]  ctx VEO thread context
- * @param [in]  size size in bytes
+ * @param [in]  ctx VEO context
+ * @param [in]  iov array of (VH address, VE address, size) triples
+ * @param [in]  n number of elements in iov
  * @return request ID
  * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-uint64_t veo_alloc_mem_async(veo_thr_ctxt *ctx, const size_t size)
+uint64_t veo_async_readv(veo_thr_ctxt *ctx, const struct veo_iovec *iov, int n)
 {
-  uint64_t req;
   try {
-    req = ContextFromC(ctx)->genericAsyncReq(URPC_CMD_ALLOC,
-                                             (char *)"L", size);
+    return ContextFromC(ctx)->asyncReadV(iov, n);
   } catch (VEOException &e) {
     return VEO_REQUEST_ID_INVALID;
   }
-  if (static_hooks.count((void *)&veo_alloc_mem_async) > 0) {
-    return veo_call_async_vh(ctx, _alloc_mem_async_hook,
-                             new veo_alloc_mem_async_data(ctx, req, size));
-  }
-  return req;
 }
 
 /**
- * @brief Free a VE memory buffer asynchronously
+ * @brief Asynchronously write several VH buffers to VE memory
  *
- * The buffer de-allocation is queued as a urpc request which
- * returns a request ID. This can be queried to retrieve the
- * allocated address as result of the request.
+ * Small buffers are packed into few transfers which are scattered by
+ * the VE, the whole set of buffers completes under one request ID.
  *
- * @param [in]  ctx VEO thread context
- * @param [in]  addr VEMVA address
+ * @param [in]  ctx VEO context
+ * @param [in]  iov array of (VH address, VE address, size) triples
+ * @param [in]  n number of elements in iov
  * @return request ID
  * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-uint64_t veo_free_mem_async(veo_thr_ctxt *ctx, uint64_t addr)
+uint64_t veo_async_writev(veo_thr_ctxt *ctx, const struct veo_iovec *iov, int n)
 {
-  uint64_t req;
   try {
-    req = ContextFromC(ctx)->genericAsyncReq(URPC_CMD_FREE,
-                                             (char *)"L", addr);
+    return ContextFromC(ctx)->asyncWriteV(iov, n);
   } catch (VEOException &e) {
     return VEO_REQUEST_ID_INVALID;
   }
-  if (static_hooks.count((void *)&veo_free_mem_async) > 0) {
-    return veo_call_async_vh(ctx, _free_mem_async_hook,
-                             new veo_free_mem_async_data(ctx, req, addr));
-  }
-  return req;
 }
 
 /**
- * @brief Asynchronously read VE memory
+ * @brief Asynchronously set VE memory to a byte value
+ *
+ * The VE writes the memory itself, no data is transferred from VH.
  *
  * @param [in]  ctx VEO context
- * @param [out] dst destination VHVA
- * @param [in]  src source VEMVA
+ * @param [in]  addr VE address
+ * @param [in]  value byte value
  * @param [in]  size size in byte
  * @return request ID
  * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-uint64_t veo_async_read_mem(veo_thr_ctxt *ctx, void *dst, uint64_t src,
-                            size_t size)
+uint64_t veo_memset_async(veo_thr_ctxt *ctx, uint64_t addr, int value,
+                          size_t size)
 {
   try {
-    return ContextFromC(ctx)->asyncReadMem(dst, src, size);
+    return ContextFromC(ctx)->asyncFillMem(addr, (uint8_t)value, 1, size);
   } catch (VEOException &e) {
     return VEO_REQUEST_ID_INVALID;
   }
 }
 
 /**
- * @brief Asynchronously write VE memory
+ * @brief Asynchronously fill VE memory with a 1, 4 or 8 byte pattern
+ *
+ * The VE writes the memory itself with vector stores, no data is
+ * transferred from VH.
  *
  * @param [in]  ctx VEO context
- * @param [out] dst destination VEMVA
- * @param [in]  src source VHVA
- * @param [in]  size size in byte
+ * @param [in]  addr VE address, aligned to pattern_size
+ * @param [in]  pattern pattern, only the low pattern_size bytes are used
+ * @param [in]  pattern_size size of the pattern in byte: 1, 4 or 8
+ * @param [in]  count number of patterns to write
  * @return request ID
  * @retval VEO_REQUEST_ID_INVALID request failed.
  */
-uint64_t veo_async_write_mem(veo_thr_ctxt *ctx, uint64_t dst, const void *src,
-                             size_t size)
+uint64_t veo_fill_async(veo_thr_ctxt *ctx, uint64_t addr, uint64_t pattern,
+                        size_t pattern_size, size_t count)
 {
   try {
-    return ContextFromC(ctx)->asyncWriteMem(dst, src, size);
+    return ContextFromC(ctx)->asyncFillMem(addr, pattern, pattern_size, count);
   } catch (VEOException &e) {
     return VEO_REQUEST_ID_INVALID;
   }
@@ -1130,6 +2116,119 @@ uint64_t veo_call_async_vh(veo_thr_ctxt *ctx, uint64_t (*func)(void *), void *ar
   }
 }
 
+/**
+ * @brief open a stream of data chunks processed by a VE kernel
+ *
+ * The stream allocates depth VE buffers of chunk_size bytes. Pushed
+ * chunks are written to the next free buffer by a hidden transfer
+ * context while the kernel processes earlier chunks on ctx. The kernel
+ * is called as uint64_t kernel(void *buf, size_t size, uint64_t index).
+ *
+ * @param [in] ctx VEO context calling the kernel
+ * @param [in] chunk_size maximum size of a chunk
+ * @param [in] depth number of VE buffers, at least 2
+ * @param [in] kernel VEMVA of the kernel function
+ * @return pointer to the stream
+ * @retval NULL the stream could not be opened.
+ */
+veo_stream *veo_stream_open(veo_thr_ctxt *ctx, size_t chunk_size, int depth,
+                            uint64_t kernel)
+{
+  try {
+    auto s = new veo::Stream(ContextFromC(ctx), chunk_size, depth, kernel);
+    return s->toCHandle();
+  } catch (VEOException &e) {
+    VEO_ERROR("failed to open stream: %s", e.what());
+    errno = e.err();
+    return NULL;
+  }
+}
+
+/**
+ * @brief push a chunk into a stream
+ *
+ * Blocks while all VE buffers are in use. The data must not be
+ * modified or freed until the result of the chunk was taken.
+ *
+ * @param [in] s stream
+ * @param [in] data chunk data
+ * @param [in] size size of the chunk, at most chunk_size
+ * @return index of the chunk in the stream
+ * @retval -1 failed to push the chunk.
+ */
+int veo_stream_push(veo_stream *s, const void *data, size_t size)
+{
+  try {
+    return StreamFromC(s)->push(data, size);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief take the kernel result of the oldest chunk if available
+ *
+ * Results are returned in the order the chunks were pushed.
+ *
+ * @param [in] s stream
+ * @param [out] index index of the chunk
+ * @param [out] result return value of the kernel
+ * @retval VEO_COMMAND_OK the kernel returned.
+ * @retval VEO_COMMAND_EXCEPTION exception occured in the kernel.
+ * @retval VEO_COMMAND_ERROR error occured on the transfer or the call.
+ * @retval VEO_COMMAND_UNFINISHED the chunk is not done yet.
+ * @retval -1 no chunk is pending.
+ */
+int veo_stream_peek_result(veo_stream *s, uint64_t *index, uint64_t *result)
+{
+  try {
+    return StreamFromC(s)->peekResult(index, result);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief wait for the kernel result of the oldest chunk
+ *
+ * @param [in] s stream
+ * @param [out] index index of the chunk
+ * @param [out] result return value of the kernel
+ * @retval VEO_COMMAND_OK the kernel returned.
+ * @retval VEO_COMMAND_EXCEPTION exception occured in the kernel.
+ * @retval VEO_COMMAND_ERROR error occured on the transfer or the call.
+ * @retval -1 no chunk is pending.
+ */
+int veo_stream_wait_result(veo_stream *s, uint64_t *index, uint64_t *result)
+{
+  try {
+    return StreamFromC(s)->waitResult(index, result);
+  } catch (VEOException &e) {
+    return -1;
+  }
+}
+
+/**
+ * @brief close a stream
+ *
+ * Waits for the pending chunks, their results are dropped.
+ *
+ * @param [in] s stream
+ * @retval 0 the stream was closed.
+ * @retval -1 failed to close the stream.
+ */
+int veo_stream_close(veo_stream *s)
+{
+  if (s == nullptr)
+    return -1;
+  try {
+    delete StreamFromC(s);
+  } catch (VEOException &e) {
+    return -1;
+  }
+  return 0;
+}
+
 /**
  * @brief allocate and initialize VEO thread context attributes object
  *        (veo_thr_ctxt_attr).
@@ -1208,6 +2307,52 @@ int veo_get_thr_ctxt_stacksize(veo_thr_ctxt_attr *tca, size_t *stack_sz)
   *stack_sz = ThreadContextAttrFromC(tca)->getStacksize();
   return 0;
 }
+
+/**
+ * @brief set NUMA node of the communication buffers of a VEO context.
+ *
+ * By default the VE-URPC buffers of a context are placed on the NUMA
+ * node closest to the VE, read from sysfs.
+ *
+ * @param [in] tca veo_thr_ctxt_attr object
+ * @param [in] node NUMA node, VEO_NUMA_NODE_AUTO for the node closest
+ *             to the VE, VEO_NUMA_NODE_NONE for no binding
+ *
+ * @return 0 upon success; -1 upon failure.
+ */
+int veo_set_thr_ctxt_numa_node(veo_thr_ctxt_attr *tca, int node)
+{
+  if (tca == nullptr) {
+    errno = EINVAL;
+    return -1;
+  }
+  try {
+    ThreadContextAttrFromC(tca)->setNumaNode(node);
+  } catch (VEOException &e) {
+    VEO_ERROR("failed veo_set_thr_ctxt_numa_node (%p)", tca);
+    errno = e.err();
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief get NUMA node of the communication buffers of a VEO context.
+ *
+ * @param [in]  tca veo_thr_ctxt_attr object
+ * @param [out] node pointer to store the NUMA node
+ *
+ * @return 0 upon success; -1 upon failure.
+ */
+int veo_get_thr_ctxt_numa_node(veo_thr_ctxt_attr *tca, int *node)
+{
+  if (tca == nullptr || node == nullptr) {
+    errno = EINVAL;
+    return -1;
+  }
+  *node = ThreadContextAttrFromC(tca)->getNumaNode();
+  return 0;
+}
 //@}
 
 // implementation of VEO API functions (low-level)
@@ -1361,6 +2506,120 @@ static uint64_t _free_mem_async_hook(void* data_) {
   return 0;
 }
 
+/*
+ * Helper function for async allocation of several buffers.
+ *
+ * Runs as an async VH call and waits for the allocation. If it failed,
+ * frees of the buffers of the chunks which succeeded are queued on the
+ * context and all addresses are cleared. The progress thread must not
+ * wait for them, a VH call queued behind them reaps their result.
+ * Otherwise the hook function is called for each buffer. Returns 0
+ * upon success.
+ */
+static uint64_t _alloc_mem_multi_async_hook(void* data_) {
+  auto data = (veo_alloc_mem_multi_async_data*)data_;
+  auto ctx = data->ctx;
+  uint64_t dummy = 0;
+  auto rv = ContextFromC(ctx)->callWaitResult(data->req, &dummy);
+  if (rv != VEO_COMMAND_OK) {
+    VEO_ERROR("rv=%d", rv);
+    // a failed chunk leaves its addresses zero, free the others
+    std::vector<uint64_t> allocated;
+    for (size_t i = 0; i < data->sizes.size(); i++)
+      if (data->addrs[i] != 0)
+        allocated.push_back(data->addrs[i]);
+    auto c = ContextFromC(ctx);
+    uint64_t req = VEO_REQUEST_ID_INVALID;
+    for (auto addr : allocated)
+      c->proc->memStats()->remove(addr);
+    size_t maxv = c->maxAllocV();
+    for (size_t off = 0; off < allocated.size(); off += maxv) {
+      size_t cnt = std::min(allocated.size() - off, maxv);
+      std::vector<uint64_t> a(allocated.begin() + off,
+                              allocated.begin() + off + cnt);
+      auto r = c->freeMultiAsync(std::move(a), req);
+      if (r == VEO_REQUEST_ID_INVALID) {
+        VEO_ERROR("failed to free %lu VE buffers", allocated.size() - off);
+        break;
+      }
+      req = r;
+    }
+    if (req != VEO_REQUEST_ID_INVALID) {
+      std::unique_ptr<veo_free_mem_multi_async_data> reap(
+        new veo_free_mem_multi_async_data{ctx, req, nullptr, {}, {}});
+      if (c->callVHAsync(_free_mem_multi_async_hook, reap.get())
+          != VEO_REQUEST_ID_INVALID)
+        reap.release();
+    }
+    std::fill(data->addrs, data->addrs + data->sizes.size(), 0);
+    delete data;
+    return -1;
+  }
+  auto it = static_hooks.find((void *)&veo_alloc_mem_async);
+  if (it != static_hooks.end()) {
+#ifndef NOCPP17
+    auto&& [hook, payload] = (*it).second;
+#else
+    auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
+    auto&& payload = (void *)std::get<1>((*it).second);
+#endif
+    for (size_t i = 0; i < data->sizes.size(); i++)
+      hook(payload, ctx, data->addrs[i], data->sizes[i]);
+  }
+  delete data;
+  return 0;
+}
+
+/*
+ * Helper function for async free of several buffers.
+ *
+ * Runs as an async VH call, waits for the free request of the VE
+ * buffers, frees the arena buffers and calls the hook function for
+ * each buffer. Returns 0 upon success.
+ */
+static uint64_t _free_mem_multi_async_hook(void* data_) {
+  auto data = (veo_free_mem_multi_async_data*)data_;
+  auto ctx = data->ctx;
+  uint64_t rc = 0;
+  if (data->req != VEO_REQUEST_ID_INVALID) {
+    uint64_t dummy = 0;
+    auto rv = ContextFromC(ctx)->callWaitResult(data->req, &dummy);
+    if (rv != VEO_COMMAND_OK) {
+      VEO_ERROR("rv=%d", rv);
+      rc = -1;
+    }
+  }
+  for (auto addr : data->arena_addrs)
+    data->arena->free(addr, false);
+  auto it = static_hooks.find((void *)&veo_free_mem_async);
+  if (rc == 0 && it != static_hooks.end()) {
+#ifndef NOCPP17
+    auto&& [hook, payload] = (*it).second;
+#else
+    auto&& hook = (void (*)(void*, ...))(std::get<0>((*it).second));
+    auto&& payload = (void *)std::get<1>((*it).second);
+#endif
+    for (auto addr : data->addrs)
+      hook(payload, ctx, addr);
+  }
+  delete data;
+  return rc;
+}
+
+/*
+ * Helper function for async free of arena buffers.
+ *
+ * Runs as an async VH call, after all earlier requests of the context.
+ * Empty chunks are released later by the next synchronous allocation,
+ * the progress thread must not wait for the main context.
+ */
+static uint64_t _free_arena_mem(void* data_) {
+  auto data = (veo_free_arena_data*)data_;
+  data->first->free(data->second, false);
+  delete data;
+  return 0;
+}
+
 /**
  * @brief Start a request block, allowing only requests from the current thread.
  *
@@ -1546,7 +2805,7 @@ veo_proc_handle *veo_get_proc_handle_from_hmem(const void *addr) {
   } else {
     int proc_ident = GET_PROC_IDENT(addr);
     veo::ProcHandle *p = veo::ProcHandle::getProcHandle(proc_ident);
-    return p->toCHandle();
+    return p != nullptr ? p->toCHandle() : nullptr;
   }
 }
 
@@ -1564,7 +2823,10 @@ int veo_get_venum_from_hmem(const void *addr) {
   if (IS_VE(addr) == (uint64_t)0) {
     return -1;
   }
+  veo::ProcTable::ReadGuard guard;
   veo_proc_handle *h = veo_get_proc_handle_from_hmem(addr);
+  if (h == nullptr)
+    return -1;
   return ProcHandleFromC(h)->veNumber();
 }
 
@@ -1581,8 +2843,10 @@ int veo_get_venum_from_hmem(const void *addr) {
 pid_t veo_get_pid_from_hmem(const void *addr){
   pid_t pid = (pid_t)(-1);
   if(IS_VE(addr) != (uint64_t)0) {
+    veo::ProcTable::ReadGuard guard;
     veo_proc_handle *h = veo_get_proc_handle_from_hmem(addr);
-    pid = ProcHandleFromC(h)->getPid();
+    if (h != nullptr)
+      pid = ProcHandleFromC(h)->getPid();
   }
   return pid;
 }
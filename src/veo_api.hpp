@@ -12,6 +12,7 @@
 
 #include "ProcHandle.hpp"
 #include "CallArgs.hpp"
+#include "Stream.hpp"
 #include "VEOException.hpp"
 
 namespace veo {
@@ -32,6 +33,10 @@ inline ThreadContextAttr *ThreadContextAttrFromC(veo_thr_ctxt_attr *ta)
 {
   return reinterpret_cast<ThreadContextAttr *>(ta);
 }
+inline Stream *StreamFromC(veo_stream *s)
+{
+  return reinterpret_cast<Stream *>(s);
+}
 
 template <typename T> int veo_args_set_(veo_args *ca, int argnum, T val)
 {
@@ -72,6 +77,9 @@ inline uint64_t callSyscallWrapper(veo_proc_handle *h, veo_args *ca)
         }
         return result;
 }
+
+int hmemcpyProcs(veo_proc_handle *, uint64_t, veo_proc_handle *, uint64_t,
+                 size_t);
 } // namespace veo::api
 } // namespace veo
 
@@ -109,3 +109,34 @@ veo_arch_number_sysfs(int ve_node_number)
 err:
   return num;
 }
+
+/**
+ * @brief read NUMA_FILE and return the NUMA node closest to the VE.
+ * @param ve_node_number VE node number, -1 for VE node 0
+ * @return >= 0 upon success; -1 upon failure or if unknown.
+ */
+int
+veo_numa_node_sysfs(int ve_node_number)
+{
+  char path[ARCH_PATH_BSIZE];
+  char buf[ARCH_FILE_BSIZE] = {0};
+  int fd, num;
+
+  if (ve_node_number < 0)
+    ve_node_number = 0;
+  snprintf(path, ARCH_PATH_BSIZE, CLASS_VE "/ve%d/" NUMA_FILE, ve_node_number);
+  fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    VEO_DEBUG("ve_numa_node_sysfs:open error(%d) %s", errno, path);
+    return -1;
+  }
+  if (read(fd, buf, ARCH_FILE_BSIZE - 1) <= 0) {
+    VEO_DEBUG("ve_numa_node_sysfs:read error(%d) %s", errno, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  /* "-1\n" if the platform has no NUMA information */
+  num = (int)strtol(buf, nullptr, 10);
+  return num < 0 ? -1 : num;
+}
@@ -28,6 +28,9 @@
 #define ARCH_FILE_BSIZE	16		/* buffer of contents in ve_arch_class */
 #define ARCH_PATH_BSIZE	64		/* buffer of "/sys/class/ve/ve#/ve_arch_class" */
 
+#define NUMA_FILE	"device/numa_node" /* NUMA node of the VE PCI device */
+
 extern int veo_arch_number_sysfs(int);
+extern int veo_numa_node_sysfs(int);
 
 #endif
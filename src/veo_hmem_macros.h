@@ -23,17 +23,30 @@
  * Copyright (c) 2020-2021 NEC Corporation
  */
 
-#define VEO_MAX_HMEM_PROCS 16
-#define IDENT_OFFSET_BITS 59 // bit 62:59 is used as VE process identifier.
+/*
+ * The VE process identifier of an HMEM address is split: bits 3:0 are
+ * kept in bits 62:59 like in the original 16 process layout, bits 11:4
+ * in bits 58:51. VEMVAs use less than 51 bits.
+ */
+#define VEO_MAX_HMEM_PROCS 4096
+#define IDENT_OFFSET_BITS 59 // bit 62:59 hold bits 3:0 of the VE process identifier.
+#define IDENT_HI_OFFSET_BITS 51 // bit 58:51 hold bits 11:4 of the VE process identifier.
 #define VEADDR_MBITS    0x8000000000000000 // bit 63 VE virtual adress mask bits
-#define PIDENT_MBITS    0x7800000000000000 // bit 62:59 VE process identifier mask bits
+#define PIDENT_LO_MBITS 0x7800000000000000 // bit 62:59
+#define PIDENT_HI_MBITS 0x07f8000000000000 // bit 58:51
+#define PIDENT_MBITS    (PIDENT_LO_MBITS | PIDENT_HI_MBITS) // VE process identifier mask bits
 #define VEIDENT_MBITS   (VEADDR_MBITS | PIDENT_MBITS)
 #define SET_VE_FLAG(addr)       (VEADDR_MBITS | (uint64_t)addr)
 #define IS_VE(addr)             (VEADDR_MBITS & (uint64_t)addr)
 #define VIRT_ADDR_VE(addr)      (~VEIDENT_MBITS & (uint64_t)addr)
-#define SET_PROC_IDENT(addr, proc_ident) ((uint64_t)addr | (uint64_t)proc_ident \
-                                        <<(int)IDENT_OFFSET_BITS)
-#define GET_PROC_IDENT(addr)    (((uint64_t)addr & PIDENT_MBITS) \
-                                >>(int)IDENT_OFFSET_BITS)
+#define SET_PROC_IDENT(addr, proc_ident) ((uint64_t)addr \
+                                        | ((uint64_t)(proc_ident) & 0xf) \
+                                          <<(int)IDENT_OFFSET_BITS \
+                                        | ((uint64_t)(proc_ident) >> 4) \
+                                          <<(int)IDENT_HI_OFFSET_BITS)
+#define GET_PROC_IDENT(addr)    ((((uint64_t)addr & PIDENT_LO_MBITS) \
+                                  >>(int)IDENT_OFFSET_BITS) \
+                                | (((uint64_t)addr & PIDENT_HI_MBITS) \
+                                  >>(int)(IDENT_HI_OFFSET_BITS - 4)))
 
 #endif
@@ -0,0 +1,218 @@
+/**
+ * @file veo_hmemcpy.cpp
+ * @brief copies of HMEM between VE processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Copies between the memories of two VE processes, either through
+ * VESHM and VE DMA or through a ring of VH staging buffers.
+ */
+#include <algorithm>
+#include <vector>
+
+#include "veo_api.hpp"
+#include "veo_veshm.h"
+#include "veo_vedma.h"
+#include "veo_hmem.h"
+#include "veo_hmem_macros.h"
+#include "log.h"
+
+// VESHM areas and DMAATB registrations are aligned to the 64MB VE page
+#define HMEMCPY_PGSZ (64UL * 1024 * 1024)
+// maximum size of one VE DMA transfer is below 128MB
+#define HMEMCPY_DMA_MAX (64UL * 1024 * 1024)
+// VESHM setup needs several VE syscalls, only worth it for large copies
+#define HMEMCPY_VESHM_MIN (8UL * 1024 * 1024)
+// VH staging ring
+#define HMEMCPY_RING_SLOTS 4
+#define HMEMCPY_RING_SLOT (8UL * 1024 * 1024)
+
+namespace veo {
+namespace api {
+
+/**
+ * @brief HMEM address of a VEMVA of a proc
+ */
+static void *_hmemAddr(veo_proc_handle *h, uint64_t addr)
+{
+  int ident = ProcHandleFromC(h)->getProcIdentifier();
+  return (void *)SET_PROC_IDENT(SET_VE_FLAG(addr), ident);
+}
+
+/**
+ * @brief copy through VESHM
+ *
+ * The source range, extended to VE pages, is opened as VESHM by the
+ * source proc and attached by the destination proc. On the same VE
+ * it is attached to VEMVA and copied by the VE, else it is attached
+ * to VEHVA and transferred by VE DMA into the destination registered
+ * with DMAATB.
+ *
+ * @return 0 upon success; -1 if the VESHM path is not usable.
+ */
+static int _hmemcpyVeshm(veo_proc_handle *dst_h, uint64_t dst,
+                         veo_proc_handle *src_h, uint64_t src, size_t size)
+{
+  auto dp = ProcHandleFromC(dst_h);
+  auto sp = ProcHandleFromC(src_h);
+  bool local = dp->veNumber() == sp->veNumber();
+  // VE DMA works on 4 byte granularity
+  if (!local && ((dst | src | size) & 3))
+    return -1;
+
+  uint64_t s0 = src & ~(HMEMCPY_PGSZ - 1);
+  size_t slen = ((src + size + HMEMCPY_PGSZ - 1) & ~(HMEMCPY_PGSZ - 1)) - s0;
+  long long mode = local ? (long long)VE_REGISTER_NONE : (long long)VE_REGISTER_PCI;
+  void *shm = _hmemAddr(src_h, s0);
+  if (veo_shared_mem_open(shm, slen, 0, mode) != 0) {
+    VEO_DEBUG("VESHM open of %lx-%lx failed (%d)", s0, s0 + slen, errno);
+    return -1;
+  }
+
+  int rc = -1;
+  pid_t pid = sp->getPid();
+  if (local) {
+    void *att = veo_shared_mem_attach(dst_h, pid, shm, slen, 0,
+                                      mode | VE_REGISTER_VEMVA);
+    if (att != (void *)-1) {
+      uint64_t a = (uint64_t)veo_get_hmem_addr(att) + (src - s0);
+      if (dp->veMemcpy((void *)dst, (void *)a, size) == 0)
+        rc = 0;
+      veo_shared_mem_detach(dst_h, att, VE_REGISTER_VEMVA);
+    }
+  } else {
+    void *att = veo_shared_mem_attach(dst_h, pid, shm, slen, 0,
+                                      mode | VE_REGISTER_VEHVA);
+    if (att != (void *)-1) {
+      uint64_t d0 = dst & ~(HMEMCPY_PGSZ - 1);
+      size_t dlen = ((dst + size + HMEMCPY_PGSZ - 1) & ~(HMEMCPY_PGSZ - 1)) - d0;
+      uint64_t dvehva = veo_register_mem_to_dmaatb(_hmemAddr(dst_h, d0), dlen);
+      if (dvehva != (uint64_t)-1) {
+        uint64_t svehva = (uint64_t)att + (src - s0);
+        dvehva += dst - d0;
+        rc = 0;
+        for (size_t off = 0; off < size; off += HMEMCPY_DMA_MAX) {
+          size_t n = std::min(HMEMCPY_DMA_MAX, size - off);
+          if (veo_dma_post_wait(dst_h, dvehva + off, svehva + off, (int)n) != 0) {
+            rc = -1;
+            break;
+          }
+        }
+        veo_unregister_mem_from_dmaatb(dst_h, dvehva - (dst - d0));
+      }
+      veo_shared_mem_detach(dst_h, att, VE_REGISTER_VEHVA);
+    }
+  }
+  veo_shared_mem_close(shm, slen, 0, mode);
+  return rc;
+}
+
+/**
+ * @brief copy through a ring of VH staging buffers
+ *
+ * Up to HMEMCPY_RING_SLOTS chunks are read from the source proc ahead
+ * of the chunk being written to the destination proc, so reads and
+ * writes overlap.
+ *
+ * @return 0 upon success; -1 upon failure.
+ */
+static int _hmemcpyStaged(veo_proc_handle *dst_h, uint64_t dst,
+                          veo_proc_handle *src_h, uint64_t src, size_t size)
+{
+  ProcHandle *src_p = ProcHandleFromC(src_h);
+  Context *rctx = src_p->mainContext();
+  Context *wctx = ProcHandleFromC(dst_h)->mainContext();
+  size_t slot = std::min(size, HMEMCPY_RING_SLOT);
+  size_t nchunks = (size + slot - 1) / slot;
+  size_t nslots = std::min(nchunks, (size_t)HMEMCPY_RING_SLOTS);
+  // on the node of the source, the reads fill the ring first
+  size_t ringsz = nslots * slot;
+  char *ring = static_cast<char *>(allocOnNode(ringsz, src_p->numaNode()));
+  if (ring == nullptr) {
+    VEO_ERROR("failed to allocate a staging ring of %lu bytes", ringsz);
+    return -1;
+  }
+  std::vector<uint64_t> rd(nchunks, VEO_REQUEST_ID_INVALID);
+  std::vector<uint64_t> wr(nchunks, VEO_REQUEST_ID_INVALID);
+  int rc = 0;
+
+  auto buf = [&] (size_t i) { return ring + (i % nslots) * slot; };
+  auto len = [&] (size_t i) { return std::min(slot, size - i * slot); };
+  // wait for a request once, failed requests make the copy fail
+  auto wait = [&rc] (Context *c, uint64_t &req) {
+    uint64_t res;
+    if (req != VEO_REQUEST_ID_INVALID &&
+        c->callWaitResult(req, &res) != VEO_COMMAND_OK)
+      rc = -1;
+    req = VEO_REQUEST_ID_INVALID;
+  };
+
+  size_t r = 0;
+  for (size_t w = 0; w < nchunks && rc == 0; w++) {
+    for (; r < nchunks && r < w + nslots && rc == 0; r++) {
+      // the slot is free once the write of its previous chunk is done
+      if (r >= nslots)
+        wait(wctx, wr[r - nslots]);
+      rd[r] = rctx->asyncReadMem(buf(r), src + r * slot, len(r));
+      if (rd[r] == VEO_REQUEST_ID_INVALID)
+        rc = -1;
+    }
+    wait(rctx, rd[w]);
+    if (rc != 0)
+      break;
+    wr[w] = wctx->asyncWriteMem(dst + w * slot, buf(w), len(w));
+    if (wr[w] == VEO_REQUEST_ID_INVALID)
+      rc = -1;
+  }
+  // drain, the ring must not go away under pending requests
+  for (size_t i = 0; i < nchunks; i++) {
+    wait(rctx, rd[i]);
+    wait(wctx, wr[i]);
+  }
+  freeOnNode(ring, ringsz);
+  return rc;
+}
+
+/**
+ * @brief copy memory between two VE processes
+ *
+ * Large copies try VESHM first unless VEO_HMEMCPY_VESHM=0, everything
+ * else and failed VESHM setups go through the VH staging ring.
+ *
+ * @param dst_h proc owning the destination
+ * @param dst destination VEMVA
+ * @param src_h proc owning the source
+ * @param src source VEMVA
+ * @param size size in byte
+ * @return 0 upon success; -1 upon failure.
+ */
+int hmemcpyProcs(veo_proc_handle *dst_h, uint64_t dst,
+                 veo_proc_handle *src_h, uint64_t src, size_t size)
+{
+  if (size == 0)
+    return 0;
+  const char *e = getenv("VEO_HMEMCPY_VESHM");
+  bool veshm = e == nullptr || atoi(e) != 0;
+  if (veshm && size >= HMEMCPY_VESHM_MIN &&
+      _hmemcpyVeshm(dst_h, dst, src_h, src, size) == 0)
+    return 0;
+  VEO_DEBUG("copy %lu bytes from proc %p to proc %p through VH", size,
+            (void *)src_h, (void *)dst_h);
+  return _hmemcpyStaged(dst_h, dst, src_h, src, size);
+}
+
+} // namespace veo::api
+} // namespace veo
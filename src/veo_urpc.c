@@ -141,38 +141,6 @@ static int getsym_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
   return 0;
 }
 
-static int alloc_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
-                         void *payload, size_t plen)
-{
-  size_t psz = 0;
-  size_t allocsz = 0;
-
-  urpc_unpack_payload(payload, plen, (char *)"L", &allocsz);
-
-  void *addr = malloc(allocsz);
-  VEO_DEBUG("addr=%p size=%lu", addr, allocsz);
-
-  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L", (uint64_t)addr);
-  CHECK_REQ(new_req, req);
-  return 0;
-}
-
-static int free_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
-                        void *payload, size_t plen)
-{
-  size_t psz = 0;
-  uint64_t addr = 0;
-
-  urpc_unpack_payload(payload, plen, (char *)"L", &addr);
-
-  free((void *)addr);
-  VEO_DEBUG("addr=%p", (void *)addr);
-
-  int64_t new_req = urpc_generic_send(up, URPC_CMD_ACK, (char *)"");
-  CHECK_REQ(new_req, req);
-  return 0;
-}
-
 /**
  * @brief Handles a SENDBUFF command
  *
@@ -247,10 +215,6 @@ void veo_urpc_register_handlers(urpc_peer_t *up)
     VEO_ERROR("register_handler failed for cmd %d\n", 1);
   if ((err = urpc_register_handler(up, URPC_CMD_GETSYM, &getsym_handler)) < 0)
     VEO_ERROR("register_handler failed for cmd %d\n", 1);
-  if ((err = urpc_register_handler(up, URPC_CMD_ALLOC, &alloc_handler)) < 0)
-    VEO_ERROR("register_handler failed for cmd %d\n", 1);
-  if ((err = urpc_register_handler(up, URPC_CMD_FREE, &free_handler)) < 0)
-    VEO_ERROR("register_handler failed for cmd %d\n", 1);
   if ((err = urpc_register_handler(up, URPC_CMD_RECVBUFF, &recvbuff_handler)) < 0)
     VEO_ERROR("register_handler failed for cmd %d\n", 1);
   if ((err = urpc_register_handler(up, URPC_CMD_SENDBUFF, &sendbuff_handler)) < 0)
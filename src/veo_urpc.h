@@ -31,6 +31,13 @@
 // multipart SEND/RECVFRAG transfer size
 #define PART_SENDFRAG (4*1024*1024)
 
+// size of an ALLOCV request ("P") or reply ("LP") without the buffers
+#define ALLOCV_CMD_SIZE_WITHOUT_DATA 40
+
+// flags of an ALLOC_EX request
+#define URPC_ALLOC_HUGEPAGE 0x1	// back with 64MB pages
+#define URPC_ALLOC_PREFAULT 0x2	// touch all pages before replying
+
 // The maximum size of arguments we can send using URPC_CMD_CALL_STKxx.
 // 40 is the size to send message with "LPLLP".
 //#define MAX_ARGS_STACK_SIZE (DATA_BUFF_END - 40)
@@ -63,6 +70,10 @@ typedef struct {
 
 void veo_urpc_register_ve_handlers(urpc_peer_t *up);
 void *ve_handler_loop(void *arg);
+void *veo_vealloc(size_t size);
+void *veo_vealloc_ex(size_t size, uint64_t flags, size_t alignment);
+void veo_vefree(void *p);
+size_t veo_alloc_cache_trim(size_t keep);
 
 #else
 
@@ -99,7 +110,18 @@ enum veo_urpc_cmd
    URPC_CMD_SLEEPING      = 18, // notify peer that we're going to sleep
    URPC_CMD_NEWPEER       = 19, // create new remote peer (AKA context) inside same proc
    URPC_CMD_ACS_PCIRCVSYC = 20, // access PCIRCVSYC register
-   URPC_CMD_MEMCPY        = 21  // copy memory
+   URPC_CMD_MEMCPY        = 21, // copy memory
+   URPC_CMD_DMA_SENDBUFF  = 22, // DMA registered VH buffer to VE, args: VE addr, VEHVA, len
+   URPC_CMD_DMA_RECVBUFF  = 23, // DMA VE buffer to registered VH buffer, args: VE addr, VEHVA, len
+   URPC_CMD_SENDSTRIDED   = 24, // scatter packed rows (payload) into a strided block on VE
+   URPC_CMD_RECVSTRIDED   = 25, // gather rows of a strided block on VE, reply is a SENDBUFF
+   URPC_CMD_SENDV         = 26, // scatter several buffers (payload: count, (addr, len) list, data)
+   URPC_CMD_RECVV         = 27, // gather several buffers (payload: count, (addr, len) list), reply is a SENDBUFF
+   URPC_CMD_FILL          = 28, // fill VE memory with a pattern, args: VE addr, pattern, pattern size, count
+   URPC_CMD_TRIM          = 29, // release cached VE buffers, args: bytes to keep cached
+   URPC_CMD_ALLOCV        = 30, // allocate several buffers (payload: sizes), reply is a SENDBUFF of addresses
+   URPC_CMD_FREEV         = 31, // free several buffers (payload: addresses)
+   URPC_CMD_ALLOC_EX      = 32  // allocate buffer on VE, args: size, URPC_ALLOC_* flags, alignment
   };
 
 
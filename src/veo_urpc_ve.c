@@ -22,8 +22,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#include <vedma.h>
 
 #include "veo_urpc.h"
 
@@ -32,6 +35,8 @@ pthread_t __handler_loop_pthreads[MAX_VE_CORES];
 int __num_ve_peers = 0;
 extern __thread urpc_peer_t *__thr_up;
 
+static void dma_bounce_release(void);
+
 //
 // VE side main handler loop
 //
@@ -53,6 +58,7 @@ void *ve_handler_loop(void *arg)
     // as send buffer memory
     ve_urpc_recv_progress(up, 3);
   }
+  dma_bounce_release();
   ve_urpc_fini(up);
   return NULL;
 }
@@ -269,6 +275,526 @@ static int call_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
   return 0;
 }
 
+//
+// DMA between registered VH memory (VHSHM) and VE memory
+//
+#define VE_DMA_PGSZ_64M   (64UL * 1024 * 1024)
+#define VE_DMA_PGSZ_2M    (2UL * 1024 * 1024)
+#define VE_DMA_MAX_XFER   (64UL * 1024 * 1024)  // ve_dma_post limit is < 128MB
+
+// bounce buffer used when the VE memory can not be registered to DMAATB
+static __thread void *__dma_bounce = NULL;
+static __thread uint64_t __dma_bounce_vehva = 0;
+
+/*
+ * Unregister and free the bounce buffer of the calling thread, called
+ * when the handler loop of the thread ends.
+ */
+static void dma_bounce_release(void)
+{
+  if (__dma_bounce == NULL)
+    return;
+  ve_unregister_mem_from_dmaatb(__dma_bounce_vehva);
+  free(__dma_bounce);
+  __dma_bounce = NULL;
+  __dma_bounce_vehva = 0;
+}
+
+/*
+ * Register the VE pages covering [addr, addr + size) to DMAATB.
+ *
+ * The page size of the region is not known, try 64MB pages first,
+ * then 2MB pages. Returns the VEHVA corresponding to addr, or -1.
+ * The VEHVA to unregister later is stored in *reg.
+ */
+static uint64_t dma_register_ve_range(uint64_t addr, size_t size, uint64_t *reg)
+{
+  const uint64_t pgsz[2] = { VE_DMA_PGSZ_64M, VE_DMA_PGSZ_2M };
+
+  for (int i = 0; i < 2; i++) {
+    uint64_t start = addr & ~(pgsz[i] - 1);
+    uint64_t end = (addr + size + pgsz[i] - 1) & ~(pgsz[i] - 1);
+    uint64_t vehva = ve_register_mem_to_dmaatb((void *)start, end - start);
+    if (vehva != (uint64_t)-1) {
+      *reg = vehva;
+      return vehva + (addr - start);
+    }
+  }
+  return (uint64_t)-1;
+}
+
+/*
+ * Move size bytes between VE memory at veaddr and VH memory at vhvehva
+ * (the VEHVA of a VHSHM attached segment). Direction is VH -> VE if
+ * to_ve is set.
+ *
+ * The VE memory is registered to DMAATB for the duration of the
+ * transfer such that the data goes straight from/to the user buffers.
+ * If that fails, a thread private bounce buffer is used.
+ */
+static int dma_vhshm_xfer(uint64_t veaddr, uint64_t vhvehva, size_t size, int to_ve)
+{
+  uint64_t reg = 0;
+  size_t off, n;
+  int rc = 0;
+
+  uint64_t vevehva = dma_register_ve_range(veaddr, size, &reg);
+  if (vevehva != (uint64_t)-1) {
+    for (off = 0; off < size && rc == 0; off += n) {
+      n = size - off < VE_DMA_MAX_XFER ? size - off : VE_DMA_MAX_XFER;
+      if (to_ve)
+        rc = ve_dma_post_wait(vevehva + off, vhvehva + off, (int)n);
+      else
+        rc = ve_dma_post_wait(vhvehva + off, vevehva + off, (int)n);
+    }
+    ve_unregister_mem_from_dmaatb(reg);
+    return rc;
+  }
+
+  VEO_DEBUG("VE memory %p not registrable, using bounce buffer", (void *)veaddr);
+  if (__dma_bounce == NULL) {
+    if (posix_memalign(&__dma_bounce, VE_DMA_PGSZ_64M, VE_DMA_MAX_XFER))
+      return -ENOMEM;
+    __dma_bounce_vehva = ve_register_mem_to_dmaatb(__dma_bounce, VE_DMA_MAX_XFER);
+    if (__dma_bounce_vehva == (uint64_t)-1) {
+      free(__dma_bounce);
+      __dma_bounce = NULL;
+      return -EFAULT;
+    }
+  }
+  for (off = 0; off < size && rc == 0; off += n) {
+    n = size - off < VE_DMA_MAX_XFER ? size - off : VE_DMA_MAX_XFER;
+    if (to_ve) {
+      rc = ve_dma_post_wait(__dma_bounce_vehva, vhvehva + off, (int)n);
+      if (rc == 0)
+        memcpy((void *)(veaddr + off), __dma_bounce, n);
+    } else {
+      memcpy(__dma_bounce, (void *)(veaddr + off), n);
+      rc = ve_dma_post_wait(vhvehva + off, __dma_bounce_vehva, (int)n);
+    }
+  }
+  return rc;
+}
+
+/**
+ * @brief Handles DMA_SENDBUFF and DMA_RECVBUFF commands
+ *
+ * Arguments are the VE address, the VEHVA of the registered VH
+ * buffer and the size. Replies with a RESULT containing the
+ * ve_dma_post_wait() return code.
+ */
+static int dma_buff_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                            void *payload, size_t plen)
+{
+  uint64_t veaddr, vhvehva;
+  size_t size;
+
+  urpc_unpack_payload(payload, plen, (char *)"LLL", &veaddr, &vhvehva, &size);
+  VEO_DEBUG("cmd=%d veaddr=%p vehva=%lx size=%lu", m->c.cmd, (void *)veaddr,
+            vhvehva, size);
+
+  int rc = dma_vhshm_xfer(veaddr, vhvehva, size,
+                          m->c.cmd == URPC_CMD_DMA_SENDBUFF);
+  if (rc)
+    VEO_ERROR("DMA transfer failed, rc=%d", rc);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L", (int64_t)rc);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+//
+// Strided 2D/3D transfers
+//
+// rows narrower than this are copied by a loop vectorized over rows
+#define STRIDED_NARROW_ROW 256
+
+// buffer for packing data to be sent to VH
+static __thread char *__pack_buf = NULL;
+static __thread size_t __pack_bufsz = 0;
+
+/*
+ * Return a packing buffer of at least size bytes, NULL if it can not
+ * be allocated.
+ */
+static char *pack_buffer(size_t size)
+{
+  if (size > __pack_bufsz) {
+    free(__pack_buf);
+    __pack_buf = (char *)malloc(size);
+    __pack_bufsz = __pack_buf ? size : 0;
+  }
+  return __pack_buf;
+}
+
+/*
+ * Copy nrows rows of width byte between a packed buffer and a strided
+ * block, starting at row r0 of the block. Rows are numbered through
+ * all slices, a slice holds height rows.
+ */
+static void strided_copy(char *blk, size_t pitch, size_t slice, size_t height,
+                         size_t width, size_t r0, size_t nrows, char *packed,
+                         int to_blk)
+{
+  size_t i = 0;
+
+  while (i < nrows) {
+    // rows [i, i + n) lie in the same slice
+    size_t r = r0 + i;
+    size_t y = r % height;
+    size_t n = height - y < nrows - i ? height - y : nrows - i;
+    char *b = blk + (r / height) * slice + y * pitch;
+    char *p = packed + i * width;
+
+    if (width < STRIDED_NARROW_ROW &&
+        ((width | pitch | (uint64_t)b | (uint64_t)p) & 7) == 0) {
+      // narrow rows: the vector loop runs across rows
+      size_t nw = width / 8, w, j;
+      if (to_blk) {
+        for (w = 0; w < nw; w++) {
+          #pragma _NEC ivdep
+          for (j = 0; j < n; j++)
+            ((uint64_t *)(b + j * pitch))[w] = ((uint64_t *)(p + j * width))[w];
+        }
+      } else {
+        for (w = 0; w < nw; w++) {
+          #pragma _NEC ivdep
+          for (j = 0; j < n; j++)
+            ((uint64_t *)(p + j * width))[w] = ((uint64_t *)(b + j * pitch))[w];
+        }
+      }
+    } else {
+      size_t j;
+      for (j = 0; j < n; j++) {
+        if (to_blk)
+          memcpy(b + j * pitch, p + j * width, width);
+        else
+          memcpy(p + j * width, b + j * pitch, width);
+      }
+    }
+    i += n;
+  }
+}
+
+/**
+ * @brief Handles a SENDSTRIDED command
+ *
+ * Arguments are the destination block address, its row pitch, slice
+ * pitch and rows per slice, the row width and the index of the first
+ * row. The payload carries the packed rows.
+ */
+static int sendstrided_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                               void *payload, size_t plen)
+{
+  uint64_t dst, pitch, slice, height, width, r0;
+  void *buff = NULL;
+  size_t buffsz = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"LLLLLLP", &dst, &pitch, &slice,
+                      &height, &width, &r0, &buff, &buffsz);
+  VEO_DEBUG("dst=%p pitch=%lu width=%lu r0=%lu size=%lu", (void *)dst, pitch,
+            width, r0, buffsz);
+
+  strided_copy((char *)dst, pitch, slice, height, width, r0, buffsz / width,
+               (char *)buff, 1);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_ACK, (char *)"");
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles a RECVSTRIDED command
+ *
+ * Packs the requested rows and sends them in a SENDBUFF reply, or a
+ * RESULT with -ENOMEM if the packing buffer can not be allocated.
+ * The packed rows must fit into one URPC transfer!
+ */
+static int recvstrided_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                               void *payload, size_t plen)
+{
+  uint64_t src, pitch, slice, height, width, r0, nrows, dst;
+
+  urpc_unpack_payload(payload, plen, (char *)"LLLLLLLL", &src, &pitch, &slice,
+                      &height, &width, &r0, &nrows, &dst);
+  VEO_DEBUG("src=%p pitch=%lu width=%lu r0=%lu nrows=%lu", (void *)src, pitch,
+            width, r0, nrows);
+
+  size_t size = width * nrows;
+  char *buf = pack_buffer(size);
+  if (buf == NULL) {
+    VEO_ERROR("failed to allocate %lu bytes for packing", size);
+    int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L",
+                                        (int64_t)-ENOMEM);
+    CHECK_REQ(new_req, req);
+    return 0;
+  }
+  strided_copy((char *)src, pitch, slice, height, width, r0, nrows, buf, 0);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_SENDBUFF, (char *)"LP",
+                                      dst, (void *)buf, size);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+//
+// Scatter-gather transfers
+//
+// The payload starts with the number of buffers n, followed by n
+// (VE address, size) pairs. For SENDV the data of the buffers follows.
+//
+
+/**
+ * @brief Handles a SENDV command
+ *
+ * Copies the data of each buffer to its VE address.
+ */
+static int sendv_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                         void *payload, size_t plen)
+{
+  void *buff = NULL;
+  size_t buffsz = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"P", &buff, &buffsz);
+  uint64_t *hdr = (uint64_t *)buff;
+  uint64_t n = hdr[0];
+  char *data = (char *)&hdr[1 + 2 * n];
+  VEO_DEBUG("n=%lu size=%lu", n, buffsz);
+
+  for (uint64_t i = 0; i < n; i++) {
+    memcpy((void *)hdr[1 + 2 * i], data, hdr[2 + 2 * i]);
+    data += hdr[2 + 2 * i];
+  }
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_ACK, (char *)"");
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles a RECVV command
+ *
+ * Packs the data of all requested buffers and sends it in a SENDBUFF
+ * reply carrying the total size, or a RESULT with -ENOMEM. The data
+ * must fit into one URPC transfer!
+ */
+static int recvv_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                         void *payload, size_t plen)
+{
+  void *buff = NULL;
+  size_t buffsz = 0;
+  size_t size = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"P", &buff, &buffsz);
+  uint64_t *hdr = (uint64_t *)buff;
+  uint64_t n = hdr[0];
+  for (uint64_t i = 0; i < n; i++)
+    size += hdr[2 + 2 * i];
+  VEO_DEBUG("n=%lu size=%lu", n, size);
+
+  char *buf = pack_buffer(size);
+  if (buf == NULL) {
+    VEO_ERROR("failed to allocate %lu bytes for packing", size);
+    int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L",
+                                        (int64_t)-ENOMEM);
+    CHECK_REQ(new_req, req);
+    return 0;
+  }
+  char *data = buf;
+  for (uint64_t i = 0; i < n; i++) {
+    memcpy(data, (void *)hdr[1 + 2 * i], hdr[2 + 2 * i]);
+    data += hdr[2 + 2 * i];
+  }
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_SENDBUFF, (char *)"LP",
+                                      (uint64_t)size, (void *)buf, size);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles a FILL command
+ *
+ * Stores count copies of a 1, 4 or 8 byte pattern at the VE address,
+ * which must be aligned to the pattern size. Replies a RESULT with 0
+ * or -EINVAL.
+ */
+static int fill_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                        void *payload, size_t plen)
+{
+  uint64_t addr, pattern, psize, count;
+  int64_t rc = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"LLLL", &addr, &pattern,
+                      &psize, &count);
+  VEO_DEBUG("addr=%p pattern=%lx psize=%lu count=%lu", (void *)addr,
+            pattern, psize, count);
+
+  if (psize == 1) {
+    memset((void *)addr, (int)pattern, count);
+  } else if (psize == 4 && (addr & 3) == 0) {
+    uint32_t *p = (uint32_t *)addr;
+    uint32_t v = (uint32_t)pattern;
+    #pragma _NEC ivdep
+    for (uint64_t i = 0; i < count; i++)
+      p[i] = v;
+  } else if (psize == 8 && (addr & 7) == 0) {
+    uint64_t *p = (uint64_t *)addr;
+    #pragma _NEC ivdep
+    for (uint64_t i = 0; i < count; i++)
+      p[i] = pattern;
+  } else {
+    rc = -EINVAL;
+  }
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L", rc);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles an ALLOC command
+ *
+ * Buffers come from the caching allocator, see veo_vealloc.c.
+ */
+static int alloc_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                         void *payload, size_t plen)
+{
+  size_t allocsz = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"L", &allocsz);
+
+  void *addr = veo_vealloc(allocsz);
+  VEO_DEBUG("addr=%p size=%lu", addr, allocsz);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L", (uint64_t)addr);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles an ALLOC_EX command
+ *
+ * Allocates an aligned, optionally huge page backed and prefaulted
+ * buffer, see veo_vealloc_ex().
+ */
+static int alloc_ex_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                            void *payload, size_t plen)
+{
+  uint64_t allocsz = 0, flags = 0, alignment = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"LLL", &allocsz, &flags,
+                      &alignment);
+
+  void *addr = veo_vealloc_ex(allocsz, flags, alignment);
+  VEO_DEBUG("addr=%p size=%lu flags=%lx alignment=%lu", addr, allocsz,
+            flags, alignment);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L", (uint64_t)addr);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+static int free_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                        void *payload, size_t plen)
+{
+  uint64_t addr = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"L", &addr);
+
+  veo_vefree((void *)addr);
+  VEO_DEBUG("addr=%p", (void *)addr);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_ACK, (char *)"");
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles an ALLOCV command
+ *
+ * Allocates one buffer per size of the payload and replies their
+ * addresses in a SENDBUFF. If any allocation fails, all buffers are
+ * freed again and the reply is a RESULT with -ENOMEM.
+ */
+static int allocv_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                          void *payload, size_t plen)
+{
+  void *buff = NULL;
+  size_t buffsz = 0;
+  int64_t new_req;
+
+  urpc_unpack_payload(payload, plen, (char *)"P", &buff, &buffsz);
+  uint64_t *sizes = (uint64_t *)buff;
+  uint64_t n = buffsz / sizeof(uint64_t);
+  uint64_t *addrs = (uint64_t *)malloc(buffsz);
+  uint64_t i = 0;
+  if (addrs != NULL) {
+    for (; i < n; i++) {
+      addrs[i] = (uint64_t)veo_vealloc(sizes[i]);
+      if (addrs[i] == 0 && sizes[i] != 0)
+        break;
+    }
+  }
+  VEO_DEBUG("n=%lu allocated=%lu", n, i);
+
+  if (addrs == NULL || i < n) {
+    while (addrs != NULL && i > 0)
+      veo_vefree((void *)addrs[--i]);
+    free(addrs);
+    new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L",
+                                (int64_t)-ENOMEM);
+    CHECK_REQ(new_req, req);
+    return 0;
+  }
+  new_req = urpc_generic_send(up, URPC_CMD_SENDBUFF, (char *)"LP",
+                              n, (void *)addrs, buffsz);
+  free(addrs);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles a FREEV command
+ */
+static int freev_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                         void *payload, size_t plen)
+{
+  void *buff = NULL;
+  size_t buffsz = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"P", &buff, &buffsz);
+  uint64_t *addrs = (uint64_t *)buff;
+  uint64_t n = buffsz / sizeof(uint64_t);
+  for (uint64_t i = 0; i < n; i++)
+    veo_vefree((void *)addrs[i]);
+  VEO_DEBUG("n=%lu", n);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_ACK, (char *)"");
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
+/**
+ * @brief Handles a TRIM command
+ *
+ * Releases cached buffers down to the given number of bytes and
+ * replies the number of bytes released.
+ */
+static int trim_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
+                        void *payload, size_t plen)
+{
+  uint64_t keep = 0;
+
+  urpc_unpack_payload(payload, plen, (char *)"L", &keep);
+  size_t released = veo_alloc_cache_trim(keep);
+
+  int64_t new_req = urpc_generic_send(up, URPC_CMD_RESULT, (char *)"L",
+                                      (uint64_t)released);
+  CHECK_REQ(new_req, req);
+  return 0;
+}
+
 static int access_pcircvsyc_register_handler(urpc_peer_t *up, urpc_mb_t *m, int64_t req,
                         void *payload, size_t plen)
 {
@@ -297,6 +823,32 @@ void veo_urpc_register_ve_handlers(urpc_peer_t *up)
     VEO_ERROR("failed cmd %d", 1);
   if ((err = urpc_register_handler(up, URPC_CMD_ACS_PCIRCVSYC, &access_pcircvsyc_register_handler)) < 0)
     VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_DMA_SENDBUFF, &dma_buff_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_DMA_RECVBUFF, &dma_buff_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_SENDSTRIDED, &sendstrided_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_RECVSTRIDED, &recvstrided_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_SENDV, &sendv_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_RECVV, &recvv_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_FILL, &fill_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_ALLOC, &alloc_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_FREE, &free_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_TRIM, &trim_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_ALLOCV, &allocv_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_FREEV, &freev_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
+  if ((err = urpc_register_handler(up, URPC_CMD_ALLOC_EX, &alloc_ex_handler)) < 0)
+    VEO_ERROR("failed cmd %d", 1);
 }
 
 __attribute__((constructor(10001)))
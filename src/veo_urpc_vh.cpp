@@ -43,14 +43,14 @@ namespace veo {
    * @return request ID if successful, -1 if failed.
    */
   int64_t send_call_nolock(urpc_peer_t *up, uint64_t ve_sp, uint64_t addr,
-                           std::vector<uint64_t> const &regs,
+                           CallRegs const &regs,
                            uint64_t stack_top, size_t stack_size,
                            bool copyin, bool copyout, void *stack_buf)
   {
     int64_t req;
 
-    void *regsp = (void *)regs.data();
-    size_t regsz = regs.size() * sizeof(uint64_t);
+    void *regsp = (void *)regs.val;
+    size_t regsz = regs.num * sizeof(uint64_t);
     size_t size = stack_size;
     int64_t max_args_size = urpc_max_send_cmd_size(up)
                              - SEND_CALL_CMD_SIZE_WITHOUT_DATA;
@@ -97,7 +97,7 @@ namespace veo {
   }
 
   
-  int unpack_call_result(urpc_mb_t *m, std::function<void(void *)> copyout,
+  int unpack_call_result(urpc_mb_t *m, const std::function<void(void *)> &copyout,
                          void *payload, size_t plen, uint64_t *result, void *stack)
   {
     int rc = -1;
@@ -33,6 +33,7 @@ extern "C" {
 #endif
 
 int veo_prev_req_result(int offs, uint64_t *result);
+size_t veo_alloc_cache_trim(size_t keep);
 
 #if __cplusplus
 }
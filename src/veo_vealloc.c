@@ -0,0 +1,300 @@
+/**
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Caching allocator for VE buffers allocated through VEO.
+ *
+ * Freed blocks of at least VEALLOC_MIN bytes are kept in size class
+ * bins instead of being returned to malloc, which would unmap them.
+ * The next allocation of the same class reuses a block whose pages
+ * are already mapped and touched. Size classes are 4 per power of 2,
+ * so at most 25% of a block are wasted. All blocks are plain malloc
+ * blocks, VE code may free() them and veo_free_mem() accepts blocks
+ * allocated by VE code. The size of a freed block is taken from
+ * malloc_usable_size().
+ *
+ * Huge page backed blocks of veo_vealloc_ex() are mapped directly and
+ * kept in a list, so veo_vefree() recognizes and unmaps them.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "veo_urpc.h"
+
+#define VEALLOC_MIN_SHIFT 16	// smaller blocks are not cached
+#define VEALLOC_MIN (1UL << VEALLOC_MIN_SHIFT)
+#define VEALLOC_SUB_SHIFT 2	// 4 size classes per power of 2
+#define VEALLOC_MAX_SHIFT 40
+#define VEALLOC_NCLASSES ((VEALLOC_MAX_SHIFT - VEALLOC_MIN_SHIFT) << VEALLOC_SUB_SHIFT)
+#define VEALLOC_DEFAULT_LIMIT (256UL * 1024 * 1024)
+#define VEALLOC_HUGE_PGSZ (64UL * 1024 * 1024)
+#define VEALLOC_MALLOC_ALIGN 16	// alignment of every malloc block
+
+// free blocks are linked through their first word
+typedef struct vealloc_block {
+  struct vealloc_block *next;
+} vealloc_block_t;
+
+// mapped huge page blocks
+typedef struct vealloc_huge {
+  struct vealloc_huge *next;
+  void *addr;
+  size_t len;
+} vealloc_huge_t;
+
+static pthread_mutex_t vealloc_mtx = PTHREAD_MUTEX_INITIALIZER;
+static vealloc_block_t *vealloc_bin[VEALLOC_NCLASSES];
+static size_t vealloc_cached;		// bytes in the bins
+static size_t vealloc_limit = (size_t)-1;	// -1: not initialized yet
+static vealloc_huge_t *vealloc_huge_list;
+
+static size_t _limit(void)
+{
+  if (vealloc_limit == (size_t)-1) {
+    char *e = getenv("VEO_VE_ALLOC_CACHE");
+    vealloc_limit = e ? strtoul(e, NULL, 0) : VEALLOC_DEFAULT_LIMIT;
+    VEO_DEBUG("VE allocation cache limit %lu", vealloc_limit);
+  }
+  return vealloc_limit;
+}
+
+static size_t _class_size(int c)
+{
+  int e = (c >> VEALLOC_SUB_SHIFT) + VEALLOC_MIN_SHIFT;
+  size_t sub = c & ((1 << VEALLOC_SUB_SHIFT) - 1);
+  return ((1UL << VEALLOC_SUB_SHIFT) + sub) << (e - VEALLOC_SUB_SHIFT);
+}
+
+/*
+ * Largest class not bigger than size, size must be >= VEALLOC_MIN.
+ */
+static int _class_floor(size_t size)
+{
+  int e = 63 - __builtin_clzl(size);
+  int sub = (size >> (e - VEALLOC_SUB_SHIFT)) & ((1 << VEALLOC_SUB_SHIFT) - 1);
+  return ((e - VEALLOC_MIN_SHIFT) << VEALLOC_SUB_SHIFT) + sub;
+}
+
+static int _class_ceil(size_t size)
+{
+  int c = _class_floor(size);
+  return _class_size(c) < size ? c + 1 : c;
+}
+
+static vealloc_block_t *_pop(int c)
+{
+  vealloc_block_t *b = vealloc_bin[c];
+  if (b) {
+    vealloc_bin[c] = b->next;
+    vealloc_cached -= malloc_usable_size(b);
+  }
+  return b;
+}
+
+/**
+ * @brief free cached blocks, the caller holds vealloc_mtx
+ *
+ * Largest blocks are released first.
+ */
+static size_t _trim(size_t keep)
+{
+  size_t released = 0;
+  for (int c = VEALLOC_NCLASSES - 1; c >= 0 && vealloc_cached > keep; c--) {
+    vealloc_block_t *b;
+    while (vealloc_cached > keep && (b = _pop(c)) != NULL) {
+      released += malloc_usable_size(b);
+      free(b);
+    }
+  }
+  return released;
+}
+
+/**
+ * @brief allocate a VE buffer, reusing a cached block if possible
+ *
+ * @param size size in byte
+ * @return address of the buffer; NULL upon failure.
+ */
+void *veo_vealloc(size_t size)
+{
+  if (size < VEALLOC_MIN || _limit() == 0)
+    return malloc(size);
+  int c = _class_ceil(size);
+  if (c >= VEALLOC_NCLASSES)
+    return malloc(size);
+
+  void *p = NULL;
+  pthread_mutex_lock(&vealloc_mtx);
+  // blocks of the next class waste less than 25%
+  p = _pop(c);
+  if (p == NULL && c + 1 < VEALLOC_NCLASSES)
+    p = _pop(c + 1);
+  pthread_mutex_unlock(&vealloc_mtx);
+  if (p)
+    return p;
+
+  // allocate the full class, so the block is reusable for the class
+  p = malloc(_class_size(c));
+  if (p == NULL) {
+    pthread_mutex_lock(&vealloc_mtx);
+    size_t released = _trim(0);
+    pthread_mutex_unlock(&vealloc_mtx);
+    if (released)
+      p = malloc(_class_size(c));
+  }
+  return p;
+}
+
+/**
+ * @brief map a block backed by 64MB pages
+ */
+static void *_alloc_huge(size_t size)
+{
+#ifndef MAP_64MB
+  VEO_ERROR("64MB pages are not supported, failed to map %lu bytes", size);
+  return NULL;
+#else
+  size_t len = (size + VEALLOC_HUGE_PGSZ - 1) & ~(VEALLOC_HUGE_PGSZ - 1);
+  vealloc_huge_t *h = (vealloc_huge_t *)malloc(sizeof(*h));
+  if (h == NULL)
+    return NULL;
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_64MB, -1, 0);
+  if (p == MAP_FAILED) {
+    free(h);
+    return NULL;
+  }
+  h->addr = p;
+  h->len = len;
+  pthread_mutex_lock(&vealloc_mtx);
+  h->next = vealloc_huge_list;
+  // veo_vefree() checks the list head without the lock
+  __atomic_store_n(&vealloc_huge_list, h, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&vealloc_mtx);
+  return p;
+#endif
+}
+
+/**
+ * @brief unmap a huge page block
+ *
+ * @return 1 if p was a huge page block; 0 otherwise.
+ */
+static int _free_huge(void *p)
+{
+  vealloc_huge_t *h, **pp;
+  pthread_mutex_lock(&vealloc_mtx);
+  for (pp = &vealloc_huge_list; (h = *pp) != NULL; pp = &h->next) {
+    if (h->addr == p) {
+      __atomic_store_n(pp, h->next, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&vealloc_mtx);
+  if (h == NULL)
+    return 0;
+  munmap(h->addr, h->len);
+  free(h);
+  return 1;
+}
+
+/**
+ * @brief allocate a VE buffer with placement requirements
+ *
+ * @param size size in byte
+ * @param flags URPC_ALLOC_HUGEPAGE: map the buffer with 64MB pages,
+ *        it must be freed with veo_vefree(), not free().
+ *        URPC_ALLOC_PREFAULT: touch all pages before returning.
+ * @param alignment power of 2, 0 for the default alignment; at most
+ *        64MB for huge page buffers
+ * @return address of the buffer; NULL upon failure.
+ */
+void *veo_vealloc_ex(size_t size, uint64_t flags, size_t alignment)
+{
+  void *p = NULL;
+  size_t pgsz = (size_t)sysconf(_SC_PAGESIZE);
+
+  if (flags & URPC_ALLOC_HUGEPAGE) {
+    if (alignment > VEALLOC_HUGE_PGSZ)
+      return NULL;
+    p = _alloc_huge(size);
+    pgsz = VEALLOC_HUGE_PGSZ;
+  } else if (alignment > VEALLOC_MALLOC_ALIGN) {
+    if (posix_memalign(&p, alignment, size) != 0)
+      p = NULL;
+  } else {
+    p = veo_vealloc(size);
+  }
+
+  if (p != NULL && (flags & URPC_ALLOC_PREFAULT) && size > 0) {
+    volatile char *c = (volatile char *)p;
+    for (size_t off = 0; off < size; off += pgsz)
+      c[off] = c[off];
+    c[size - 1] = c[size - 1];
+  }
+  return p;
+}
+
+/**
+ * @brief free a VE buffer into the cache
+ *
+ * The block is released to malloc if it is small or the cache is full.
+ *
+ * @param p buffer address, may have been allocated by any malloc
+ */
+void veo_vefree(void *p)
+{
+  if (p == NULL)
+    return;
+  if (__atomic_load_n(&vealloc_huge_list, __ATOMIC_ACQUIRE) != NULL &&
+      _free_huge(p))
+    return;
+  size_t usable = malloc_usable_size(p);
+  if (usable < VEALLOC_MIN || _limit() == 0) {
+    free(p);
+    return;
+  }
+  int c = _class_floor(usable);
+  pthread_mutex_lock(&vealloc_mtx);
+  if (c >= VEALLOC_NCLASSES || vealloc_cached + usable > vealloc_limit) {
+    pthread_mutex_unlock(&vealloc_mtx);
+    free(p);
+    return;
+  }
+  vealloc_block_t *b = (vealloc_block_t *)p;
+  b->next = vealloc_bin[c];
+  vealloc_bin[c] = b;
+  vealloc_cached += usable;
+  pthread_mutex_unlock(&vealloc_mtx);
+}
+
+/**
+ * @brief release cached VE buffers
+ *
+ * @param keep number of bytes which may stay cached
+ * @return number of bytes released
+ */
+size_t veo_alloc_cache_trim(size_t keep)
+{
+  pthread_mutex_lock(&vealloc_mtx);
+  size_t released = _trim(keep);
+  pthread_mutex_unlock(&vealloc_mtx);
+  VEO_DEBUG("released %lu bytes, %lu cached", released, vealloc_cached);
+  return released;
+}
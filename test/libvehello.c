@@ -53,3 +53,11 @@ uint64_t empty2(void)
   empty_cnt2++;
   return empty_cnt2;
 }
+
+uint64_t sum_chunk(uint64_t *buf, size_t size, uint64_t index)
+{
+  uint64_t sum = index;
+  for (size_t i = 0; i < size / sizeof(uint64_t); i++)
+    sum += buf[i];
+  return sum;
+}
@@ -69,3 +69,12 @@ int test_bandwidth(void *data)
 {
     return 0;
 }
+
+long test_20_args(long a0, int a1, long a2, double a3, long a4, long a5,
+                  long a6, long a7, long a8, int a9, long a10, float a11,
+                  long a12, long a13, long a14, long a15, long a16, long a17,
+                  short a18, long a19)
+{
+    return a0 + a1 + a2 + (long)a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 +
+           (long)a11 + a12 + a13 + a14 + a15 + a16 + a17 + a18 + a19;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+#
+# Bandwidth of large transfers vs. number of transfer channels.
+# Usage: scan_bandwidth_channels.sh [sync|async] [xferbench options]
+#
+
+mode=${1:-sync}
+shift
+exec ./xferbench -m $mode -x 1,2,4,8 -s 8m,16m,32m,64m,256m,1g "$@"
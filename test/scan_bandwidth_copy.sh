@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Receive bandwidth vs. number of copy workers (VEO_RECV_COPY_THREADS)
+# and non-temporal stores (VEO_RECV_COPY_NT). Both are read when the
+# proc is created, so each setting runs in its own xferbench process.
+# The CSV header is printed once, JSON results of all runs are
+# collected in one array.
+# Usage: scan_bandwidth_copy.sh [sync|async] [xferbench options]
+#
+
+mode=${1:-sync}
+shift
+thscan="0 1 2 4"
+ntscan="0 1048576"
+
+fmt=text
+args=("$@")
+for ((i = 0; i < ${#args[@]}; i++)); do
+    case ${args[i]} in
+        -o|--format) fmt=${args[i+1]} ;;
+        --format=*) fmt=${args[i]#--format=} ;;
+        -o*) fmt=${args[i]#-o} ;;
+    esac
+done
+
+first=1
+[ "$fmt" = json ] && echo "["
+for t in $thscan; do
+    for n in $ntscan; do
+        [ "$fmt" = json -a $first -eq 0 ] && echo ","
+        VEO_RECV_COPY_THREADS=$t VEO_RECV_COPY_NT=$n \
+            ./xferbench -m $mode -d recv -s 1m,4m,16m,64m,256m \
+            -l "thr=$t nt=$n" "$@" |
+            if [ "$fmt" = csv -a $first -eq 0 ]; then tail -n +2; else cat; fi
+        first=0
+    done
+done
+[ "$fmt" = json ] && echo "]"
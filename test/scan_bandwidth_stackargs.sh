@@ -1,15 +1,7 @@
 #!/bin/bash
+#
+# Bandwidth of buffers passed as stack arguments vs. message size.
+# Further xferbench options are passed through, e.g. -o csv.
+#
 
-kbscan="1 4 16 32 64 96 128 256 512 768"
-mbscan="1 2 4 8 16 32 61"
-
-
-printf "%8s   %7s   %7s\n" "buff kB" "send MB/s" "recv MB/s"
-for s in $kbscan; do
-    bw=`./bandwidth_stackargs $((s * 1024)) | grep "bw=" | sed -e 's,^.*bw=,,' -e 's,\..*$,,'`
-    printf "%8d   %7.0f   %7.0f\n" $s $bw
-done
-for s in $mbscan; do
-    bw=`./bandwidth_stackargs $((s * 1024 * 1024)) | grep "bw=" | sed -e 's,^.*bw=,,' -e 's,\..*$,,'`
-    printf "%8d   %7.0f   %7.0f\n" $((s*1024)) $bw
-done
+exec ./xferbench -m stack -s 1k,4k,16k,32k,64k,96k,128k,256k,512k,768k,1m,2m,4m,8m,16m,32m,61m "$@"
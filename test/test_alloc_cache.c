@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define SIZE (4 * 1024 * 1024)
+#define LOOPS 1000
+
+int
+main()
+{
+  uint64_t addr, first = 0;
+  int i, reused = 0;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  char *buf = (char *)malloc(SIZE);
+  memset(buf, 7, SIZE);
+
+  // same sized scratch buffers are served from the cache
+  for (i = 0; i < LOOPS; i++) {
+    if (veo_alloc_mem(proc, &addr, SIZE) != 0) {
+      printf("veo_alloc_mem failed\n");
+      return 1;
+    }
+    if (i == 0)
+      first = addr;
+    else if (addr == first)
+      reused++;
+    if (veo_write_mem(proc, addr, buf, 4096) != 0) {
+      printf("veo_write_mem failed\n");
+      return 2;
+    }
+    veo_free_mem(proc, addr);
+  }
+  if (reused != LOOPS - 1) {
+    printf("cached buffer reused only %d times\n", reused);
+    return 3;
+  }
+
+  // a slightly smaller size falls into the same class
+  if (veo_alloc_mem(proc, &addr, SIZE - 4096) != 0 || addr != first) {
+    printf("cached buffer not reused for a smaller size\n");
+    return 4;
+  }
+  veo_free_mem(proc, addr);
+
+  int64_t released = veo_trim_mem(proc, 0);
+  if (released < SIZE) {
+    printf("veo_trim_mem released %ld bytes\n", released);
+    return 5;
+  }
+  if (veo_trim_mem(proc, 0) != 0) {
+    printf("cache not empty after trim\n");
+    return 6;
+  }
+  free(buf);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define MB (1024UL * 1024)
+
+static int
+alloc_check(struct veo_proc_handle *proc, uint64_t *addr, size_t size,
+            uint64_t flags, size_t alignment, size_t expect_align)
+{
+  if (veo_alloc_mem_ex(proc, addr, size, flags, alignment) != 0) {
+    printf("veo_alloc_mem_ex(size=%lu, flags=%lx, alignment=%lu) failed\n",
+           size, flags, alignment);
+    return 1;
+  }
+  if (*addr % expect_align) {
+    printf("buffer %lx is not aligned to %lu\n", *addr, expect_align);
+    return 1;
+  }
+  char *buf = (char *)malloc(size);
+  char *chk = (char *)malloc(size);
+  for (size_t i = 0; i < size; i++)
+    buf[i] = (char)(i * 7);
+  if (veo_write_mem(proc, *addr, buf, size) != 0 ||
+      veo_read_mem(proc, chk, *addr, size) != 0 ||
+      memcmp(buf, chk, size) != 0) {
+    printf("transfer to buffer %lx failed\n", *addr);
+    return 1;
+  }
+  free(buf);
+  free(chk);
+  return 0;
+}
+
+int
+main()
+{
+  uint64_t a, b, c, d;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+
+  if (alloc_check(proc, &a, 3 * MB + 5, 0, 2 * MB, 2 * MB))
+    return 1;
+  if (alloc_check(proc, &b, 10 * MB, VEO_ALLOC_HUGEPAGE, 0, 64 * MB))
+    return 2;
+  if (alloc_check(proc, &c, 100 * MB, VEO_ALLOC_HUGEPAGE | VEO_ALLOC_PREFAULT,
+                  0, 64 * MB))
+    return 3;
+  if (alloc_check(proc, &d, 1000, VEO_ALLOC_PREFAULT, 4096, 4096))
+    return 4;
+
+  uint64_t bad;
+  if (veo_alloc_mem_ex(proc, &bad, 1000, 0, 3000) == 0) {
+    printf("alignment which is not a power of 2 accepted\n");
+    return 5;
+  }
+
+  if (veo_free_mem(proc, a) != 0 || veo_free_mem(proc, b) != 0 ||
+      veo_free_mem(proc, c) != 0 || veo_free_mem(proc, d) != 0) {
+    printf("veo_free_mem failed\n");
+    return 6;
+  }
+  // the huge page blocks are unmapped, a new one must work again
+  if (alloc_check(proc, &b, 10 * MB, VEO_ALLOC_HUGEPAGE, 0, 64 * MB))
+    return 7;
+  veo_free_mem(proc, b);
+
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define NBUF 300
+
+static int nalloc, nfree;
+
+void alloc_hook(void *dummy, ...)
+{
+  nalloc++;
+}
+
+void free_hook(void *dummy, ...)
+{
+  nfree++;
+}
+
+static int
+check_bufs(struct veo_proc_handle *proc, uint64_t *addrs, size_t *sizes)
+{
+  for (int i = 0; i < NBUF; i++) {
+    if (addrs[i] == 0) {
+      printf("buffer %d not allocated\n", i);
+      return 1;
+    }
+    if (veo_write_mem(proc, addrs[i], &i, sizeof(i)) != 0) {
+      printf("veo_write_mem to buffer %d failed\n", i);
+      return 1;
+    }
+  }
+  for (int i = 0; i < NBUF; i++) {
+    int v = -1;
+    if (veo_read_mem(proc, &v, addrs[i], sizeof(v)) != 0 || v != i) {
+      printf("buffer %d overlaps another buffer (%d)\n", i, v);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int
+main()
+{
+  size_t sizes[NBUF];
+  uint64_t addrs[NBUF];
+  uint64_t res;
+  int dummy = 0;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  for (int i = 0; i < NBUF; i++)
+    sizes[i] = 64 + (size_t)i * 4096;
+
+  veo_register_hook((void *)&veo_alloc_mem, &alloc_hook, &dummy);
+  veo_register_hook((void *)&veo_free_mem, &free_hook, &dummy);
+
+  if (veo_alloc_mem_multi(proc, NBUF, sizes, addrs) != 0) {
+    printf("veo_alloc_mem_multi failed\n");
+    return 1;
+  }
+  if (check_bufs(proc, addrs, sizes))
+    return 2;
+  if (veo_free_mem_multi(proc, NBUF, addrs) != 0) {
+    printf("veo_free_mem_multi failed\n");
+    return 3;
+  }
+  if (nalloc != NBUF || nfree != NBUF) {
+    printf("hooks called %d/%d times, expected %d\n", nalloc, nfree, NBUF);
+    return 4;
+  }
+
+  // async variants
+  nalloc = nfree = 0;
+  veo_register_hook((void *)&veo_alloc_mem_async, &alloc_hook, &dummy);
+  veo_register_hook((void *)&veo_free_mem_async, &free_hook, &dummy);
+  memset(addrs, 0, sizeof(addrs));
+  uint64_t req = veo_alloc_mem_multi_async(ctx, NBUF, sizes, addrs);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &res) != VEO_COMMAND_OK) {
+    printf("veo_alloc_mem_multi_async failed\n");
+    return 5;
+  }
+  if (check_bufs(proc, addrs, sizes))
+    return 6;
+  req = veo_free_mem_multi_async(ctx, NBUF, addrs);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &res) != VEO_COMMAND_OK) {
+    printf("veo_free_mem_multi_async failed\n");
+    return 7;
+  }
+  if (nalloc != NBUF || nfree != NBUF) {
+    printf("async hooks called %d/%d times, expected %d\n", nalloc, nfree, NBUF);
+    return 8;
+  }
+
+  // one failing allocation fails the whole request
+  sizes[NBUF / 2] = (size_t)1 << 60;
+  if (veo_alloc_mem_multi(proc, NBUF, sizes, addrs) == 0) {
+    printf("veo_alloc_mem_multi of an impossible size succeeded\n");
+    return 9;
+  }
+  for (int i = 0; i < NBUF; i++)
+    if (addrs[i] != 0) {
+      printf("buffer %d left allocated after failure\n", i);
+      return 10;
+    }
+
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define CHUNK (64 * 1024 * 1024)
+#define NBUF 256
+#define BUFSZ (300 * 1024)
+
+int
+main()
+{
+  uint64_t addr[NBUF], retval;
+  int i;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+  if (veo_set_arena_chunk(proc, CHUNK) != 0) {
+    printf("veo_set_arena_chunk failed\n");
+    return 1;
+  }
+
+  char *src = (char *)malloc(BUFSZ);
+  char *dst = (char *)malloc(BUFSZ);
+
+  // more buffers than fit into one chunk, the arena has to grow
+  for (i = 0; i < NBUF; i++) {
+    if (veo_alloc_mem(proc, &addr[i], BUFSZ - i) != 0) {
+      printf("veo_alloc_mem %d failed\n", i);
+      return 2;
+    }
+    memset(src, i, BUFSZ - i);
+    if (veo_write_mem(proc, addr[i], src, BUFSZ - i) != 0) {
+      printf("veo_write_mem %d failed\n", i);
+      return 3;
+    }
+  }
+  // buffers must not overlap
+  for (i = 0; i < NBUF; i++) {
+    memset(src, i, BUFSZ - i);
+    if (veo_read_mem(proc, dst, addr[i], BUFSZ - i) != 0 ||
+        memcmp(src, dst, BUFSZ - i) != 0) {
+      printf("buffer %d was overwritten\n", i);
+      return 4;
+    }
+  }
+
+  // free every other buffer, the holes are reused
+  for (i = 0; i < NBUF; i += 2)
+    veo_free_mem(proc, addr[i]);
+  uint64_t again;
+  if (veo_alloc_mem(proc, &again, BUFSZ - 2) != 0) {
+    printf("veo_alloc_mem after free failed\n");
+    return 5;
+  }
+  for (i = 0; i < NBUF && again != addr[i]; i += 2)
+    ;
+  if (i >= NBUF) {
+    printf("freed arena range not reused\n");
+    return 5;
+  }
+  veo_free_mem(proc, again);
+
+  // async free is ordered after the earlier requests of the context
+  for (i = 1; i < NBUF; i += 2) {
+    uint64_t req = veo_free_mem_async(ctx, addr[i]);
+    if (req == VEO_REQUEST_ID_INVALID ||
+        veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+      printf("veo_free_mem_async %d failed\n", i);
+      return 6;
+    }
+  }
+
+  // large buffers bypass the arena
+  uint64_t big;
+  if (veo_alloc_mem(proc, &big, CHUNK) != 0) {
+    printf("large veo_alloc_mem failed\n");
+    return 7;
+  }
+  veo_free_mem(proc, big);
+
+  veo_set_arena_chunk(proc, 0);
+  free(src);
+  free(dst);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define SMALL (4096)
+#define LARGE (8 * 1024 * 1024)
+#define TOTAL (2 * SMALL + LARGE)
+
+int
+main()
+{
+  uint64_t vein, veout, result;
+  int i;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  uint64_t libh = veo_load_library(proc, "./libvehello.so");
+  uint64_t sym = veo_get_sym(proc, libh, "veo_memcpy");
+  if (sym == 0) {
+    printf("veo_get_sym failed\n");
+    return 1;
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  char *src = (char *)malloc(TOTAL);
+  char *dst = (char *)malloc(TOTAL);
+  for (i = 0; i < TOTAL; i++)
+    src[i] = (char)(i * 13);
+  memset(dst, 0, TOTAL);
+  if (veo_alloc_mem(proc, &vein, TOTAL) != 0 ||
+      veo_alloc_mem(proc, &veout, TOTAL) != 0) {
+    printf("veo_alloc_mem failed\n");
+    return 2;
+  }
+
+  // two small buffers packed into one transfer, one large buffer
+  struct veo_iovec in[3] = {
+    { src + SMALL, vein + SMALL, SMALL },
+    { src, vein, SMALL },
+    { src + 2 * SMALL, vein + 2 * SMALL, LARGE },
+  };
+  struct veo_iovec out[2] = {
+    { dst, veout, LARGE },
+    { dst + LARGE, veout + LARGE, 2 * SMALL },
+  };
+  struct veo_args *argp = veo_args_alloc();
+  veo_args_set_u64(argp, 0, veout);
+  veo_args_set_u64(argp, 1, vein);
+  veo_args_set_u64(argp, 2, TOTAL);
+
+  uint64_t req = veo_call_async_with_io(ctx, sym, argp, in, 3, out, 2);
+  if (req == VEO_REQUEST_ID_INVALID) {
+    printf("veo_call_async_with_io failed\n");
+    return 3;
+  }
+  if (veo_call_wait_result(ctx, req, &result) != VEO_COMMAND_OK) {
+    printf("veo_call_wait_result failed\n");
+    return 4;
+  }
+  if (memcmp(src, dst, TOTAL) != 0) {
+    printf("data mismatch\n");
+    return 5;
+  }
+
+  // no buffers at all is a plain call
+  req = veo_call_async_with_io(ctx, sym, argp, NULL, 0, NULL, 0);
+  if (veo_call_wait_result(ctx, req, &result) != VEO_COMMAND_OK) {
+    printf("veo_call_async_with_io without buffers failed\n");
+    return 6;
+  }
+
+  veo_args_free(argp);
+  veo_free_mem(proc, vein);
+  veo_free_mem(proc, veout);
+  free(src);
+  free(dst);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
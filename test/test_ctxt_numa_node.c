@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define SIZE (16 * 1024 * 1024)
+
+static int
+roundtrip(struct veo_thr_ctxt *ctx,
+          uint64_t vebuf, char *src, char *dst)
+{
+  uint64_t req, retval;
+
+  memset(dst, 0, SIZE);
+  req = veo_async_write_mem(ctx, vebuf, src, SIZE);
+  if (veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_async_write_mem failed\n");
+    return 1;
+  }
+  req = veo_async_read_mem(ctx, dst, vebuf, SIZE);
+  if (veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_async_read_mem failed\n");
+    return 1;
+  }
+  if (memcmp(src, dst, SIZE) != 0) {
+    printf("data mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+int
+main()
+{
+  uint64_t vebuf;
+  int node;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  struct veo_thr_ctxt_attr *tca = veo_alloc_thr_ctxt_attr();
+  if (veo_get_thr_ctxt_numa_node(tca, &node) != 0 ||
+      node != VEO_NUMA_NODE_AUTO) {
+    printf("unexpected default NUMA node %d\n", node);
+    return 1;
+  }
+  if (veo_set_thr_ctxt_numa_node(tca, -3) == 0) {
+    printf("veo_set_thr_ctxt_numa_node accepted an invalid node\n");
+    return 2;
+  }
+
+  char *src = (char *)malloc(SIZE);
+  char *dst = (char *)malloc(SIZE);
+  for (int i = 0; i < SIZE; i++)
+    src[i] = (char)(i * 7);
+  if (veo_alloc_mem(proc, &vebuf, SIZE) != 0) {
+    printf("veo_alloc_mem failed\n");
+    return 3;
+  }
+  if (roundtrip(ctx, vebuf, src, dst))
+    return 4;
+
+  // a context whose buffers are not bound, and one on node 0
+  veo_set_thr_ctxt_numa_node(tca, VEO_NUMA_NODE_NONE);
+  struct veo_thr_ctxt *ctx1 = veo_context_open_with_attr(proc, tca);
+  veo_set_thr_ctxt_numa_node(tca, 0);
+  struct veo_thr_ctxt *ctx2 = veo_context_open_with_attr(proc, tca);
+  if (ctx1 == NULL || ctx2 == NULL) {
+    printf("veo_context_open_with_attr failed\n");
+    return 5;
+  }
+  if (roundtrip(ctx1, vebuf, src, dst) ||
+      roundtrip(ctx2, vebuf, src, dst))
+    return 6;
+
+  veo_free_thr_ctxt_attr(tca);
+  veo_free_mem(proc, vebuf);
+  free(src);
+  free(dst);
+  veo_context_close(ctx2);
+  veo_context_close(ctx1);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define SIZE (64 * 1024 * 1024)
+
+static int
+wait_req(struct veo_thr_ctxt *ctx, uint64_t req, const char *what)
+{
+  uint64_t retval;
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("%s failed\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+int
+main()
+{
+  uint64_t vebuf;
+  size_t i;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+  unsigned char *buf = (unsigned char *)malloc(SIZE);
+  if (veo_alloc_mem(proc, &vebuf, SIZE) != 0) {
+    printf("veo_alloc_mem failed\n");
+    return 1;
+  }
+
+  // unaligned byte ranges
+  if (wait_req(ctx, veo_memset_async(ctx, vebuf, 0xa5, SIZE), "veo_memset_async") ||
+      wait_req(ctx, veo_memset_async(ctx, vebuf + 3, 0, 1000), "veo_memset_async (small)"))
+    return 2;
+  if (veo_read_mem(proc, buf, vebuf, SIZE) != 0)
+    return 3;
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != ((i >= 3 && i < 1003) ? 0 : 0xa5)) {
+      printf("memset mismatch at %lu: %x\n", i, buf[i]);
+      return 4;
+    }
+
+  // 4 and 8 byte patterns
+  uint32_t *p32 = (uint32_t *)buf;
+  uint64_t *p64 = (uint64_t *)buf;
+  if (wait_req(ctx, veo_fill_async(ctx, vebuf, 0x12345678UL, 4, SIZE / 4), "veo_fill_async (4)"))
+    return 5;
+  if (veo_read_mem(proc, buf, vebuf, SIZE) != 0)
+    return 6;
+  for (i = 0; i < SIZE / 4; i++)
+    if (p32[i] != 0x12345678) {
+      printf("fill32 mismatch at %lu: %x\n", i, p32[i]);
+      return 7;
+    }
+  if (wait_req(ctx, veo_fill_async(ctx, vebuf + 8, 0x0123456789abcdefUL, 8, SIZE / 8 - 2),
+               "veo_fill_async (8)"))
+    return 8;
+  if (veo_read_mem(proc, buf, vebuf, SIZE) != 0)
+    return 9;
+  if (p64[0] != 0x1234567812345678UL || p64[SIZE / 8 - 1] != 0x1234567812345678UL) {
+    printf("fill64 wrote outside of the range\n");
+    return 10;
+  }
+  for (i = 1; i < SIZE / 8 - 1; i++)
+    if (p64[i] != 0x0123456789abcdefUL) {
+      printf("fill64 mismatch at %lu: %lx\n", i, p64[i]);
+      return 11;
+    }
+
+  // bad pattern size and alignment are rejected
+  if (veo_fill_async(ctx, vebuf, 0, 2, 16) != VEO_REQUEST_ID_INVALID ||
+      veo_fill_async(ctx, vebuf + 4, 0, 8, 16) != VEO_REQUEST_ID_INVALID) {
+    printf("invalid fill was accepted\n");
+    return 12;
+  }
+
+  veo_free_mem(proc, vebuf);
+  free(buf);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
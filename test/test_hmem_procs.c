@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ve_offload.h>
+
+#define NPROCS 20	// more than the 16 procs of the old HMEM layout
+
+int
+main()
+{
+  struct veo_proc_handle *proc[NPROCS];
+  void *hm[NPROCS];
+  int nprocs = NPROCS;
+  char *e = getenv("TEST_NPROCS");
+  if (e != NULL && atoi(e) > 0 && atoi(e) < NPROCS)
+    nprocs = atoi(e);
+
+  for (int i = 0; i < nprocs; i++) {
+    proc[i] = veo_proc_create(-1);
+    if (proc[i] == NULL) {
+      printf("veo_proc_create #%d failed\n", i);
+      return 1;
+    }
+    if (veo_alloc_hmem(proc[i], &hm[i], sizeof(uint64_t)) != 0) {
+      printf("veo_alloc_hmem for proc #%d failed\n", i);
+      return 2;
+    }
+    if (veo_get_proc_handle_from_hmem(hm[i]) != proc[i] ||
+        veo_get_proc_identifier_from_hmem(hm[i]) != veo_proc_identifier(proc[i])) {
+      printf("HMEM address of proc #%d does not map back to it\n", i);
+      return 3;
+    }
+  }
+  if (veo_get_max_proc_identifier() < nprocs) {
+    printf("only %d procs identifiable\n", veo_get_max_proc_identifier());
+    return 4;
+  }
+
+  // VH -> VE -> VE -> VH through all procs
+  uint64_t v = 0x1234abcd, r = 0;
+  if (veo_hmemcpy(hm[0], &v, sizeof(v)) != 0)
+    return 5;
+  for (int i = 1; i < nprocs; i++)
+    if (veo_hmemcpy(hm[i], hm[i - 1], sizeof(v)) != 0) {
+      printf("veo_hmemcpy from proc #%d to #%d failed\n", i - 1, i);
+      return 6;
+    }
+  if (veo_hmemcpy(&r, hm[nprocs - 1], sizeof(r)) != 0 || r != v) {
+    printf("value %lx arrived as %lx\n", v, r);
+    return 7;
+  }
+
+  for (int i = 0; i < nprocs; i++) {
+    veo_free_hmem(hm[i]);
+    veo_proc_destroy(proc[i]);
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <ve_offload.h>
+
+#define NTHREADS 4
+#define NCYCLES 8
+
+static void *hm;
+static volatile int stop;
+static int errors;
+
+// HMEM copies through a proc which stays alive, racing with the
+// creation and destruction of other procs
+static void *reader(void *arg)
+{
+  uint64_t v = (uint64_t)arg, r;
+  while (!stop) {
+    uint64_t *p = (uint64_t *)hm + (uint64_t)arg;
+    if (veo_hmemcpy(p, &v, sizeof(v)) != 0 ||
+        veo_hmemcpy(&r, p, sizeof(r)) != 0 || r != v ||
+        veo_get_pid_from_hmem(p) < 0)
+      __sync_fetch_and_add(&errors, 1);
+    v += NTHREADS;
+  }
+  return NULL;
+}
+
+int
+main()
+{
+  pthread_t th[NTHREADS];
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  if (veo_alloc_hmem(proc, &hm, NTHREADS * sizeof(uint64_t)) != 0) {
+    printf("veo_alloc_hmem failed\n");
+    return 1;
+  }
+  for (uint64_t i = 0; i < NTHREADS; i++)
+    pthread_create(&th[i], NULL, reader, (void *)i);
+
+  for (int i = 0; i < NCYCLES; i++) {
+    void *hm2;
+    uint64_t v = i, r = -1;
+    struct veo_proc_handle *p = veo_proc_create(-1);
+    if (p == NULL) {
+      printf("veo_proc_create #%d failed\n", i);
+      return 2;
+    }
+    if (veo_alloc_hmem(p, &hm2, sizeof(v)) != 0 ||
+        veo_hmemcpy(hm2, &v, sizeof(v)) != 0 ||
+        veo_hmemcpy(&r, hm2, sizeof(r)) != 0 || r != v) {
+      printf("HMEM copy through proc #%d failed\n", i);
+      return 3;
+    }
+    veo_free_hmem(hm2);
+    veo_proc_destroy(p);
+    if (veo_get_proc_handle_from_hmem(hm2) != NULL) {
+      printf("destroyed proc #%d still found\n", i);
+      return 4;
+    }
+  }
+  stop = 1;
+  for (int i = 0; i < NTHREADS; i++)
+    pthread_join(th[i], NULL);
+  if (errors) {
+    printf("%d failed HMEM operations\n", errors);
+    return 5;
+  }
+  veo_free_hmem(hm);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
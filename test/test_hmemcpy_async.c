@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define N 16
+#define SIZE (256 * 1024)
+
+int
+main()
+{
+  void *ve;
+  uint64_t retval;
+  int i;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+  if (veo_alloc_hmem(proc, &ve, 2 * N * SIZE) != 0) {
+    printf("veo_alloc_hmem failed\n");
+    return 1;
+  }
+  char *src = (char *)malloc(N * SIZE);
+  char *dst = (char *)malloc(N * SIZE);
+  char *dst2 = (char *)malloc(N * SIZE);
+  for (i = 0; i < N * SIZE; i++)
+    src[i] = (char)(i * 5);
+  memset(dst, 0, N * SIZE);
+
+  // single copy
+  uint64_t req = veo_hmemcpy_async(ctx, ve, src, N * SIZE);
+  if (veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_hmemcpy_async failed\n");
+    return 2;
+  }
+
+  // batch mixing all directions: VE to VE, VE to VH, VH to VH
+  struct veo_hmemcpy_desc d[2 * N + 1];
+  for (i = 0; i < N; i++) {
+    d[i].dst = (char *)ve + N * SIZE + i * SIZE;
+    d[i].src = (char *)ve + i * SIZE;
+    d[i].size = SIZE;
+    d[N + i].dst = dst + i * SIZE;
+    d[N + i].src = (char *)ve + i * SIZE;
+    d[N + i].size = SIZE;
+  }
+  d[2 * N].dst = dst2;
+  d[2 * N].src = src;
+  d[2 * N].size = N * SIZE;
+  req = veo_hmemcpy_batch_async(ctx, d, 2 * N + 1);
+  if (veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_hmemcpy_batch_async failed\n");
+    return 3;
+  }
+  if (memcmp(src, dst, N * SIZE) != 0 || memcmp(src, dst2, N * SIZE) != 0) {
+    printf("data mismatch\n");
+    return 4;
+  }
+  memset(dst, 0, N * SIZE);
+  req = veo_hmemcpy_async(ctx, dst, (char *)ve + N * SIZE, N * SIZE);
+  if (veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK ||
+      memcmp(src, dst, N * SIZE) != 0) {
+    printf("VE to VE copies mismatch\n");
+    return 5;
+  }
+
+  veo_free_hmem(ve);
+  free(src);
+  free(dst);
+  free(dst2);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
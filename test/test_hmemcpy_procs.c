@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+#include <veo_hmem.h>
+
+#define LARGE (96 * 1024 * 1024)
+#define SMALL (1024 * 1024 + 3)
+
+static int
+copy_check(void *dst, void *src, char *vh, char *chk, size_t size,
+           const char *what)
+{
+  memset(chk, 0, size);
+  if (veo_hmemcpy(dst, src, size) != 0) {
+    printf("veo_hmemcpy (%s) failed\n", what);
+    return 1;
+  }
+  if (veo_hmemcpy(chk, dst, size) != 0 || memcmp(vh, chk, size) != 0) {
+    printf("data mismatch (%s)\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+int
+main()
+{
+  void *a, *b;
+  size_t i;
+
+  struct veo_proc_handle *p0 = veo_proc_create(-1);
+  struct veo_proc_handle *p1 = veo_proc_create(-1);
+  if (p0 == NULL || p1 == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  if (veo_alloc_hmem(p0, &a, LARGE) != 0 || veo_alloc_hmem(p1, &b, LARGE) != 0) {
+    printf("veo_alloc_hmem failed\n");
+    return 1;
+  }
+  char *vh = (char *)malloc(LARGE);
+  char *chk = (char *)malloc(LARGE);
+  for (i = 0; i < LARGE; i++)
+    vh[i] = (char)(i * 11);
+  if (veo_hmemcpy(a, vh, LARGE) != 0) {
+    printf("veo_hmemcpy (VH to VE) failed\n");
+    return 2;
+  }
+
+  // large copy, VESHM if possible
+  if (copy_check(b, a, vh, chk, LARGE, "large"))
+    return 3;
+  // small unaligned copy, staged through VH
+  if (copy_check((char *)a + 1, (char *)b + 1, vh + 1, chk, SMALL, "small"))
+    return 4;
+  // large copy forced through the staging ring
+  setenv("VEO_HMEMCPY_VESHM", "0", 1);
+  memset(chk, 0, LARGE);
+  if (veo_hmemcpy(b, chk, LARGE) != 0)
+    return 5;
+  if (copy_check(b, a, vh, chk, LARGE, "staged"))
+    return 6;
+
+  veo_free_hmem(a);
+  veo_free_hmem(b);
+  free(vh);
+  free(chk);
+  veo_proc_destroy(p1);
+  veo_proc_destroy(p0);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define NBUF 100
+#define BIGSZ (16 * 1024 * 1024)
+
+int
+main()
+{
+  struct veo_iovec wiov[NBUF + 1], riov[NBUF + 1];
+  uint64_t retval, vebuf, req;
+  size_t off = 0;
+  int ret;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  ret = veo_alloc_mem(proc, &vebuf, 2 * BIGSZ);
+  if (ret != 0) {
+    printf("veo_alloc_mem failed: %d\n", ret);
+    return 1;
+  }
+
+  // many small buffers of odd sizes at scattered VE addresses,
+  // and one buffer larger than a transfer fragment
+  for (int i = 0; i <= NBUF; i++) {
+    size_t sz = i < NBUF ? 1 + i * 37 : BIGSZ;
+    char *w = (char *)malloc(sz);
+    for (size_t j = 0; j < sz; j++)
+      w[j] = (char)(i + j);
+    wiov[i].vhaddr = w;
+    wiov[i].veaddr = vebuf + off;
+    wiov[i].size = sz;
+    riov[i].vhaddr = calloc(1, sz);
+    riov[i].veaddr = vebuf + off;
+    riov[i].size = sz;
+    off += sz + 13;
+  }
+
+  req = veo_async_writev(ctx, wiov, NBUF + 1);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_async_writev failed\n");
+    return 2;
+  }
+  req = veo_async_readv(ctx, riov, NBUF + 1);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_async_readv failed\n");
+    return 3;
+  }
+  for (int i = 0; i <= NBUF; i++) {
+    if (memcmp(wiov[i].vhaddr, riov[i].vhaddr, wiov[i].size) != 0) {
+      printf("buffer %d differs after writev/readv\n", i);
+      return 4;
+    }
+    free(wiov[i].vhaddr);
+    free(riov[i].vhaddr);
+  }
+
+  // an empty vector completes immediately
+  req = veo_async_writev(ctx, NULL, 0);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("empty veo_async_writev failed\n");
+    return 5;
+  }
+
+  veo_free_mem(proc, vebuf);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define NELEMS (1024 * 1024)
+
+// out: bytes at the start of p written by fn and read back after it
+static int
+call(struct veo_thr_ctxt *ctx, uint64_t handle, const char *fn, int *p,
+     size_t out)
+{
+  uint64_t rc = ~0UL;
+  struct veo_args *argp = veo_args_alloc();
+  enum veo_args_intent inout = out ? VEO_INTENT_OUT : VEO_INTENT_IN;
+  if (veo_args_set_managed_range(argp, 0, p, inout, 0, out) != 0) {
+    printf("veo_args_set_managed_range failed\n");
+    return -1;
+  }
+  veo_args_set_i32(argp, 1, NELEMS);
+  uint64_t id = veo_call_async_by_name(ctx, handle, fn, argp);
+  if (id == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, id, &rc) != VEO_COMMAND_OK)
+    rc = ~0UL;
+  veo_args_free(argp);
+  return rc == ~0UL ? -1 : 0;
+}
+
+int
+main()
+{
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+  uint64_t handle = veo_load_library(proc, "./libvealloc.so");
+
+  int *p = (int *)veo_alloc_managed(proc, NELEMS * sizeof(int));
+  if (p == NULL) {
+    printf("veo_alloc_managed failed\n");
+    return 1;
+  }
+  if (veo_managed_ve_addr(p) == 0 ||
+      veo_managed_ve_addr(p + 10) != veo_managed_ve_addr(p) + 10 * sizeof(int)) {
+    printf("wrong VE address of the managed buffer\n");
+    return 2;
+  }
+
+  // a new buffer is uploaded completely
+  for (int i = 0; i < NELEMS; i++)
+    p[i] = i;
+  if (call(ctx, handle, "check", p, 0) != 0) {
+    printf("VE does not see the initial contents\n");
+    return 3;
+  }
+  if (veo_managed_dirty_bytes(p) != 0) {
+    printf("%lu bytes dirty after the upload\n", veo_managed_dirty_bytes(p));
+    return 4;
+  }
+
+  // only the written page is dirty
+  p[NELEMS / 2] = -1;
+  size_t dirty = veo_managed_dirty_bytes(p);
+  if (dirty == 0 || dirty >= NELEMS * sizeof(int) / 2) {
+    printf("%lu bytes dirty after writing one element\n", dirty);
+    return 5;
+  }
+  if (call(ctx, handle, "check", p, 0) == 0) {
+    printf("VE does not see the modified element\n");
+    return 6;
+  }
+  p[NELEMS / 2] = NELEMS / 2;
+  if (call(ctx, handle, "check", p, 0) != 0) {
+    printf("VE does not see the restored element\n");
+    return 7;
+  }
+
+  // VE writes are pulled back without dirtying the buffer
+  memset(p, 0, NELEMS * sizeof(int));
+  if (call(ctx, handle, "init", p, 0) != 0 ||
+      veo_sync_managed_from_ve(p, 0, NELEMS * sizeof(int)) != 0) {
+    printf("init on VE failed\n");
+    return 8;
+  }
+  for (int i = 0; i < NELEMS; i++)
+    if (p[i] != i) {
+      printf("p[%d] = %d after pulling\n", i, p[i]);
+      return 9;
+    }
+  if (veo_managed_dirty_bytes(p) != 0) {
+    printf("pulled range is dirty\n");
+    return 10;
+  }
+
+  // a declared range is read back with the call, the rest is not
+  memset(p, 0, NELEMS * sizeof(int));
+  if (call(ctx, handle, "init", p, NELEMS / 2 * sizeof(int)) != 0) {
+    printf("init with read back failed\n");
+    return 11;
+  }
+  for (int i = 0; i < NELEMS; i++)
+    if (p[i] != (i < NELEMS / 2 ? i : 0)) {
+      printf("p[%d] = %d after the call\n", i, p[i]);
+      return 12;
+    }
+  if (veo_managed_dirty_bytes(p) != 0) {
+    printf("read back range is dirty\n");
+    return 13;
+  }
+
+  // arguments keep a freed buffer, calling them fails
+  struct veo_args *argp = veo_args_alloc();
+  veo_args_set_managed(argp, 0, p);
+  veo_args_set_i32(argp, 1, NELEMS);
+  if (veo_free_managed(p) != 0 || veo_free_managed(p) == 0) {
+    printf("veo_free_managed failed\n");
+    return 14;
+  }
+  uint64_t rc, id = veo_call_async_by_name(ctx, handle, "check", argp);
+  if (id != VEO_REQUEST_ID_INVALID &&
+      veo_call_wait_result(ctx, id, &rc) == VEO_COMMAND_OK) {
+    printf("call with a freed managed buffer succeeded\n");
+    return 15;
+  }
+  veo_args_free(argp);
+
+  // buffers left over are freed with the proc
+  if (veo_alloc_managed(proc, NELEMS) == NULL) {
+    printf("veo_alloc_managed failed\n");
+    return 16;
+  }
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
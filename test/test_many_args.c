@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ve_offload.h>
+
+#define NARGS 20	// more arguments than kept inline
+
+static long
+set_args(struct veo_args *arg, long base)
+{
+  // 7 is coprime to NARGS: starts with the last argument, then jumps
+  // back and forth across the inline slots
+  for (int k = 0; k < NARGS; k++) {
+    int i = (k * 7 + NARGS - 1) % NARGS;
+    long v = base - i;
+    switch (i) {
+    case 1: case 9: veo_args_set_i32(arg, i, (int32_t)v); break;
+    case 3: veo_args_set_double(arg, i, (double)v); break;
+    case 11: veo_args_set_float(arg, i, (float)v); break;
+    case 18: veo_args_set_i16(arg, i, (int16_t)v); break;
+    default: veo_args_set_i64(arg, i, v);
+    }
+  }
+  return NARGS * base - NARGS * (NARGS - 1) / 2;
+}
+
+int
+main()
+{
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+  uint64_t handle = veo_load_library(proc, "./libvestackargs.so");
+  uint64_t sym = veo_get_sym(proc, handle, "test_20_args");
+  struct veo_args *arg = veo_args_alloc();
+
+  // arguments are set in any order and reused after clearing
+  for (long base = 1; base < 1000; base += 111) {
+    uint64_t res;
+    veo_args_clear(arg);
+    long expect = set_args(arg, base);
+    uint64_t req = veo_call_async(ctx, sym, arg);
+    if (veo_call_wait_result(ctx, req, &res) != VEO_COMMAND_OK) {
+      printf("call with base %ld failed\n", base);
+      return 1;
+    }
+    if ((long)res != expect) {
+      printf("sum of arguments is %ld, expected %ld\n", (long)res, expect);
+      return 2;
+    }
+  }
+  if (veo_args_set_i64(arg, -1, 0) == 0) {
+    printf("negative argument number accepted\n");
+    return 3;
+  }
+  veo_args_free(arg);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define BUFSZ (64 * 1024 * 1024)
+#define NREQ 16
+
+int
+main()
+{
+  uint64_t retval, vebuf, req[NREQ];
+  size_t part = BUFSZ / NREQ;
+  int ret;
+
+  // hand read copies of 64KiB or more to 4 worker threads
+  setenv("VEO_RECV_COPY_THREADS", "4", 1);
+  setenv("VEO_RECV_COPY_MIN", "65536", 1);
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  char *src = (char *)malloc(BUFSZ);
+  char *dst = (char *)calloc(1, BUFSZ);
+  for (size_t i = 0; i < BUFSZ / sizeof(uint64_t); i++)
+    ((uint64_t *)src)[i] = i * 7 + 3;
+
+  ret = veo_alloc_mem(proc, &vebuf, BUFSZ);
+  if (ret != 0) {
+    printf("veo_alloc_mem failed: %d\n", ret);
+    return 1;
+  }
+  if (veo_write_mem(proc, vebuf, src, BUFSZ) != 0) {
+    printf("veo_write_mem failed\n");
+    return 2;
+  }
+
+  // one large synchronous read
+  if (veo_read_mem(proc, dst, vebuf, BUFSZ) != 0 ||
+      memcmp(src, dst, BUFSZ) != 0) {
+    printf("veo_read_mem with copy workers failed\n");
+    return 3;
+  }
+
+  // many reads in flight, small ones are copied by the progress thread
+  memset(dst, 0, BUFSZ);
+  for (int i = 0; i < NREQ; i++) {
+    size_t sz = i % 2 ? part : 4096;
+    req[i] = veo_async_read_mem(ctx, dst + i * part, vebuf + i * part, sz);
+  }
+  for (int i = 0; i < NREQ; i++) {
+    size_t sz = i % 2 ? part : 4096;
+    if (veo_call_wait_result(ctx, req[i], &retval) != VEO_COMMAND_OK ||
+        memcmp(src + i * part, dst + i * part, sz) != 0) {
+      printf("veo_async_read_mem #%d with copy workers failed\n", i);
+      return 4;
+    }
+  }
+
+  veo_free_mem(proc, vebuf);
+  free(src);
+  free(dst);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
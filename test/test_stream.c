@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define CHUNK (1024 * 1024)	// bytes
+#define NCHUNKS 64
+#define DEPTH 3
+
+static uint64_t
+expected(uint64_t *data, size_t n, uint64_t index)
+{
+  uint64_t sum = index;
+  for (size_t i = 0; i < n; i++)
+    sum += data[i];
+  return sum;
+}
+
+int
+main()
+{
+  size_t n = CHUNK / sizeof(uint64_t);
+  uint64_t index, result;
+  int i, rc, taken = 0;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  uint64_t libh = veo_load_library(proc, "./libvehello.so");
+  uint64_t sym = veo_get_sym(proc, libh, "sum_chunk");
+  if (sym == 0) {
+    printf("veo_get_sym failed\n");
+    return 1;
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  if (veo_stream_open(ctx, CHUNK, 1, sym) != NULL) {
+    printf("veo_stream_open accepted depth 1\n");
+    return 2;
+  }
+  struct veo_stream *s = veo_stream_open(ctx, CHUNK, DEPTH, sym);
+  if (s == NULL) {
+    printf("veo_stream_open failed\n");
+    return 3;
+  }
+  if (veo_stream_peek_result(s, &index, &result) != -1) {
+    printf("result returned from an empty stream\n");
+    return 4;
+  }
+  if (veo_stream_push(s, NULL, CHUNK + 1) != -1) {
+    printf("veo_stream_push accepted an oversized chunk\n");
+    return 5;
+  }
+
+  // the data of a chunk must stay valid until its result was taken
+  uint64_t *data = (uint64_t *)malloc((size_t)NCHUNKS * CHUNK);
+  for (i = 0; i < NCHUNKS * (int)n; i++)
+    data[i] = (uint64_t)i * 7;
+
+  for (i = 0; i < NCHUNKS; i++) {
+    // the last chunk is shorter than the buffers
+    size_t size = i == NCHUNKS - 1 ? CHUNK / 2 : CHUNK;
+    if (veo_stream_push(s, data + i * n, size) != i) {
+      printf("veo_stream_push of chunk %d failed\n", i);
+      return 6;
+    }
+    while ((rc = veo_stream_peek_result(s, &index, &result)) == VEO_COMMAND_OK) {
+      size_t cn = index == NCHUNKS - 1 ? n / 2 : n;
+      if (index != (uint64_t)taken ||
+          result != expected(data + index * n, cn, index)) {
+        printf("wrong result for chunk %lu\n", index);
+        return 7;
+      }
+      taken++;
+    }
+    if (rc != VEO_COMMAND_UNFINISHED && rc != -1) {
+      printf("veo_stream_peek_result failed: %d\n", rc);
+      return 8;
+    }
+  }
+  while ((rc = veo_stream_wait_result(s, &index, &result)) != -1) {
+    size_t cn = index == NCHUNKS - 1 ? n / 2 : n;
+    if (rc != VEO_COMMAND_OK || index != (uint64_t)taken ||
+        result != expected(data + index * n, cn, index)) {
+      printf("wrong result for chunk %lu\n", index);
+      return 9;
+    }
+    taken++;
+  }
+  if (taken != NCHUNKS) {
+    printf("got %d results instead of %d\n", taken, NCHUNKS);
+    return 10;
+  }
+
+  if (veo_stream_close(s) != 0) {
+    printf("veo_stream_close failed\n");
+    return 11;
+  }
+  free(data);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
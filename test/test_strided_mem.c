@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define NX 1024		// row length in doubles
+#define NY 2048		// rows per slice
+#define NZ 4		// slices
+
+static int
+check_block(double *a, double *b, size_t pitch, size_t slice,
+            size_t x0, size_t y0, size_t z0, size_t w, size_t h, size_t d)
+{
+  for (size_t z = z0; z < z0 + d; z++)
+    for (size_t y = y0; y < y0 + h; y++)
+      for (size_t x = x0; x < x0 + w; x++) {
+        size_t i = z * slice + y * pitch + x;
+        if (a[i] != b[i]) {
+          printf("mismatch at z=%lu y=%lu x=%lu: %f != %f\n", z, y, x, a[i], b[i]);
+          return 1;
+        }
+      }
+  return 0;
+}
+
+static int
+wait_req(struct veo_thr_ctxt *ctx, uint64_t req, const char *what)
+{
+  uint64_t retval;
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("%s failed\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+int
+main()
+{
+  size_t size = (size_t)NX * NY * NZ * sizeof(double);
+  size_t pitch = NX * sizeof(double);
+  uint64_t vebuf;
+  int ret;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  double *src = (double *)malloc(size);
+  double *dst = (double *)malloc(size);
+  for (size_t i = 0; i < (size_t)NX * NY * NZ; i++)
+    src[i] = (double)i;
+
+  ret = veo_alloc_mem(proc, &vebuf, size);
+  if (ret != 0) {
+    printf("veo_alloc_mem failed: %d\n", ret);
+    return 1;
+  }
+  memset(dst, 0, size);
+  if (veo_write_mem(proc, vebuf, dst, size) != 0) {
+    printf("veo_write_mem failed\n");
+    return 1;
+  }
+
+  // halo column: one double per row, all rows of slice 0
+  if (wait_req(ctx, veo_async_write_mem_2d(ctx, vebuf, pitch, src, pitch,
+                                           sizeof(double), NY),
+               "veo_async_write_mem_2d (column)"))
+    return 2;
+  // wide rows: interior block of slice 1
+  if (wait_req(ctx, veo_async_write_mem_2d(ctx, vebuf + (NX * NY + 8 * NX + 8) * sizeof(double),
+                                           pitch, src + NX * NY + 8 * NX + 8,
+                                           pitch, (NX - 16) * sizeof(double), NY - 16),
+               "veo_async_write_mem_2d (block)"))
+    return 3;
+  // 3D block spanning slices 2 and 3
+  if (wait_req(ctx, veo_async_write_mem_3d(ctx, vebuf + (2 * NX * NY + NX + 3) * sizeof(double),
+                                           pitch, NY, src + 2 * NX * NY + NX + 3,
+                                           pitch, NY, 100 * sizeof(double), 500, 2),
+               "veo_async_write_mem_3d"))
+    return 4;
+
+  if (veo_read_mem(proc, dst, vebuf, size) != 0) {
+    printf("veo_read_mem failed\n");
+    return 5;
+  }
+  if (check_block(src, dst, NX, NX * NY, 0, 0, 0, 1, NY, 1) ||
+      check_block(src, dst, NX, NX * NY, 8, 8, 1, NX - 16, NY - 16, 1) ||
+      check_block(src, dst, NX, NX * NY, 3, 1, 2, 100, 500, 2))
+    return 6;
+  if (dst[1] != 0.0 || dst[NX * NY + 7] != 0.0) {
+    printf("data written outside of the blocks\n");
+    return 7;
+  }
+
+  // read the same blocks back, packed on VH
+  if (veo_write_mem(proc, vebuf, src, size) != 0) {
+    printf("veo_write_mem failed\n");
+    return 8;
+  }
+  memset(dst, 0, size);
+  if (wait_req(ctx, veo_async_read_mem_2d(ctx, dst, pitch, vebuf, pitch,
+                                          sizeof(double), NY),
+               "veo_async_read_mem_2d (column)"))
+    return 9;
+  if (wait_req(ctx, veo_async_read_mem_3d(ctx, dst + 2 * NX * NY + NX + 3,
+                                          pitch, NY,
+                                          vebuf + (2 * NX * NY + NX + 3) * sizeof(double),
+                                          pitch, NY, 100 * sizeof(double), 500, 2),
+               "veo_async_read_mem_3d"))
+    return 10;
+  if (check_block(src, dst, NX, NX * NY, 0, 0, 0, 1, NY, 1) ||
+      check_block(src, dst, NX, NX * NY, 3, 1, 2, 100, 500, 2))
+    return 11;
+
+  veo_free_mem(proc, vebuf);
+  free(src);
+  free(dst);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ve_offload.h>
+#include <ve_offload.hpp>
+
+#ifndef NOCPP17
+int main()
+{
+  auto proc = veo_proc_create(-1);
+  if (proc == nullptr) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  auto ctx = veo_context_open(proc);
+  uint64_t handle = veo_load_library(proc, "./libvestackargs.so");
+
+  // doubles in registers and on the stack, the VE returns the bits of a double
+  uint64_t sym = veo_get_sym(proc, handle, "test_many_args");
+  auto sum = veo::call<double(double, double, double, double, double,
+                              double, double, double, double, double)>
+    (ctx, sym, 1.0, 2.0, 3.0, 4.0, 5, 6, 7, 8, 9, 10.0);
+  double d = sum.get();
+  if (d != 55.0) {
+    printf("test_many_args returned %f\n", d);
+    return 1;
+  }
+
+  // buffers on the stack in all directions
+  sym = veo_get_sym(proc, handle, "test_many_inout");
+  char in0[] = "Hello, world.";
+  int inout1 = 42;
+  float out2 = 0;
+  char out8[10] = {0};
+  auto rc = veo::call<int(char *, int *, float *, double, double, double,
+                          double, double, char *, int)>
+    (ctx, sym, veo::in(in0, sizeof(in0)), veo::inout(&inout1), veo::out(&out2),
+     1.0, 2.0, 3.0, 4.0, 5.0, veo::out(out8, sizeof(out8)), (int)sizeof(out8));
+  if (rc.get() != 1 || inout1 != 43 || out2 != 15.0f ||
+      strncmp(out8, "Hello, 89", 9) != 0) {
+    printf("test_many_inout: inout1=%d out2=%f out8=%.9s\n", inout1, out2, out8);
+    return 2;
+  }
+
+  // mixed integer sizes and a float beyond the registers
+  sym = veo_get_sym(proc, handle, "test_20_args");
+  auto s20 = veo::call<long(long, int, long, double, long, long, long, long,
+                            long, int, long, float, long, long, long, long,
+                            long, long, short, long)>
+    (ctx, sym, 1, -2, 3, 4.0, 5, 6, 7, 8, 9, -10, 11, 12.0f, 13, 14, 15, 16,
+     17, 18, -19, 20);
+  long r = s20.get();
+  if (r != 210 - 2 * (2 + 10 + 19)) {
+    printf("test_20_args returned %ld\n", r);
+    return 3;
+  }
+
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
+#else
+int main()
+{
+  printf("SKIPPED: the typed call API needs C++17\n");
+  return 0;
+}
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define MB (1024UL * 1024)
+#define NSIZES 5
+
+// sizes around the striping threshold, some not a multiple of the page size
+static const size_t sizes[NSIZES] = {
+  8 * MB, 8 * MB + 1, 12 * MB + 4095, 33 * MB + 7, 64 * MB - 3
+};
+
+static void
+fill(char *b, size_t sz, int seed)
+{
+  // position dependent, misplaced stripes do not compare equal
+  for (size_t j = 0; j < sz; j++)
+    b[j] = (char)(seed + j + (j >> 12) * 131);
+}
+
+static int
+check(const char *what, size_t sz, const char *w, const char *r)
+{
+  if (memcmp(w, r, sz) != 0) {
+    for (size_t j = 0; j < sz; j++) {
+      if (w[j] != r[j]) {
+        printf("%s of %lu bytes differs at offset %lu\n", what, sz, j);
+        break;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+int
+main()
+{
+  uint64_t vebuf, req, retval;
+  size_t maxsz = 64 * MB + 16;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  if (veo_set_xfer_channels(proc, 3) != 3 || veo_get_xfer_channels(proc) != 3) {
+    printf("veo_set_xfer_channels(3) failed\n");
+    return 1;
+  }
+  if (veo_alloc_mem(proc, &vebuf, maxsz) != 0) {
+    printf("veo_alloc_mem failed\n");
+    return 2;
+  }
+  char *w = (char *)malloc(maxsz);
+  char *r = (char *)malloc(maxsz);
+
+  for (int i = 0; i < NSIZES; i++) {
+    size_t sz = sizes[i];
+    // VE address off a page boundary, too
+    uint64_t dst = vebuf + (i & 1) * 8;
+
+    // synchronous write, asynchronous read
+    fill(w, sz, i);
+    memset(r, 0, sz);
+    if (veo_write_mem(proc, dst, w, sz) != 0) {
+      printf("veo_write_mem of %lu bytes failed\n", sz);
+      return 3;
+    }
+    req = veo_async_read_mem(ctx, r, dst, sz);
+    if (req == VEO_REQUEST_ID_INVALID ||
+        veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+      printf("veo_async_read_mem of %lu bytes failed\n", sz);
+      return 4;
+    }
+    if (check("VH -> VE", sz, w, r))
+      return 5;
+
+    // asynchronous write, synchronous read
+    fill(w, sz, i + 77);
+    memset(r, 0, sz);
+    req = veo_async_write_mem(ctx, dst, w, sz);
+    if (req == VEO_REQUEST_ID_INVALID ||
+        veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+      printf("veo_async_write_mem of %lu bytes failed\n", sz);
+      return 6;
+    }
+    if (veo_read_mem(proc, r, dst, sz) != 0) {
+      printf("veo_read_mem of %lu bytes failed\n", sz);
+      return 7;
+    }
+    if (check("VE -> VH", sz, w, r))
+      return 8;
+  }
+
+  free(w);
+  free(r);
+  veo_free_mem(proc, vebuf);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
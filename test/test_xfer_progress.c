@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ve_offload.h>
+
+#define SIZE (64 * 1024 * 1024)
+#define STEP (4 * 1024 * 1024)
+
+struct cb_state {
+  int calls;
+  int errors;
+  size_t last;
+};
+
+static void
+progress_cb(void *arg, size_t done, size_t total)
+{
+  struct cb_state *st = (struct cb_state *)arg;
+  if (done <= st->last || done > total)
+    st->errors++;
+  st->last = done;
+  st->calls++;
+}
+
+int
+main()
+{
+  uint64_t vebuf, retval, seen;
+  struct cb_state st = { 0, 0, 0 };
+  struct veo_xfer_progress prog;
+  int i, polls;
+
+  struct veo_proc_handle *proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    exit(1);
+  }
+  struct veo_thr_ctxt *ctx = veo_context_open(proc);
+
+  char *src = (char *)malloc(SIZE);
+  char *dst = (char *)malloc(SIZE);
+  for (i = 0; i < SIZE; i++)
+    src[i] = (char)(i * 3);
+  memset(dst, 0, SIZE);
+  if (veo_alloc_mem(proc, &vebuf, SIZE) != 0) {
+    printf("veo_alloc_mem failed\n");
+    return 1;
+  }
+
+  // write with a callback every STEP bytes
+  memset(&prog, 0, sizeof(prog));
+  prog.step = STEP;
+  prog.cb = progress_cb;
+  prog.arg = &st;
+  uint64_t req = veo_async_write_mem_progress(ctx, vebuf, src, SIZE, &prog);
+  if (req == VEO_REQUEST_ID_INVALID ||
+      veo_call_wait_result(ctx, req, &retval) != VEO_COMMAND_OK) {
+    printf("veo_async_write_mem_progress failed\n");
+    return 2;
+  }
+  if (prog.done != SIZE || st.last != SIZE || st.errors ||
+      st.calls < 2 || st.calls > SIZE / STEP + 1) {
+    printf("bad write progress: done=%lu last=%lu calls=%d errors=%d\n",
+           (size_t)prog.done, st.last, st.calls, st.errors);
+    return 3;
+  }
+
+  // read while polling the counter, the leading part must be in place
+  memset(&prog, 0, sizeof(prog));
+  req = veo_async_read_mem_progress(ctx, dst, vebuf, SIZE, &prog);
+  if (req == VEO_REQUEST_ID_INVALID) {
+    printf("veo_async_read_mem_progress failed\n");
+    return 4;
+  }
+  seen = 0;
+  polls = 0;
+  while (veo_call_peek_result(ctx, req, &retval) == VEO_COMMAND_UNFINISHED) {
+    uint64_t done = __atomic_load_n(&prog.done, __ATOMIC_ACQUIRE);
+    if (done < seen) {
+      printf("progress counter went backwards\n");
+      return 5;
+    }
+    if (done > 0 && memcmp(dst + seen, src + seen, done - seen) != 0) {
+      printf("data below %lu not in place\n", done);
+      return 6;
+    }
+    seen = done;
+    polls++;
+  }
+  if (prog.done != SIZE || memcmp(dst, src, SIZE) != 0) {
+    printf("read failed: done=%lu\n", (size_t)prog.done);
+    return 7;
+  }
+  printf("%d polls, last partial count %lu\n", polls, seen);
+
+  veo_free_mem(proc, vebuf);
+  free(src);
+  free(dst);
+  veo_context_close(ctx);
+  veo_proc_destroy(proc);
+  printf("PASSED\n");
+  return 0;
+}
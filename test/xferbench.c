@@ -0,0 +1,539 @@
+/*
+ * Transfer benchmark driver, replaces bandwidth, bandwidth_async and
+ * bandwidth_stackargs.
+ *
+ * Sweeps message sizes, directions, transfer modes, numbers of
+ * contexts and VH threads, transfer channels and fragment sizes. Each
+ * point is measured in several repetitions and reported as median,
+ * 99th percentile (reached by 99% of the repetitions) and maximum
+ * throughput plus VH CPU time per GB, as text table, CSV or JSON. Run
+ * with -h for the options.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <ve_offload.h>
+#include <urpc_time.h>
+
+#define MAX_LIST 64
+#define MAX_THREADS 64
+#define MAX_DEPTH 1024
+
+enum mode { MODE_SYNC, MODE_ASYNC, MODE_STACK, NMODES };
+enum dir { DIR_SEND, DIR_RECV, NDIRS };
+enum format { FMT_TEXT, FMT_CSV, FMT_JSON };
+
+static const char *mode_name[NMODES] = { "sync", "async", "stack" };
+static const char *dir_name[NDIRS] = { "send", "recv" };
+
+struct list {
+  int n;
+  long v[MAX_LIST];
+};
+
+/* one measured point of the sweep */
+struct point {
+  enum mode mode;
+  enum dir dir;
+  size_t size;
+  int threads;
+  int contexts;
+  int channels;
+  long frag;
+  int iters;
+};
+
+struct worker {
+  pthread_t tid;
+  pthread_barrier_t *bar;
+  struct veo_thr_ctxt *ctx;
+  const struct point *p;
+  uint64_t vebuf;
+  char *buf;
+  int rc;
+};
+
+static struct {
+  struct list sizes, threads, contexts, channels, frags;
+  int modes[NMODES];
+  int dirs[NDIRS];
+  int reps;
+  int iters;
+  int depth;
+  int verify;
+  enum format fmt;
+  const char *label;
+  const char *stacklib;
+} opt;
+
+static struct veo_proc_handle *proc;
+static struct veo_thr_ctxt *ctxs[MAX_THREADS];
+static int nctxs;
+static uint64_t stack_sym;
+static int nresults;
+
+static void
+usage(const char *prog)
+{
+  printf("Usage: %s [options]\n"
+         "  -s, --sizes LIST      message sizes, k/m/g suffixes, a:b for powers of 2\n"
+         "                        between a and b (default 1k:1g)\n"
+         "  -d, --dir LIST        send,recv (default both)\n"
+         "  -m, --mode LIST       sync,async,stack (default sync,async)\n"
+         "  -c, --contexts LIST   numbers of contexts (default 1)\n"
+         "  -t, --threads LIST    numbers of VH threads, spread over the contexts\n"
+         "                        (default: one per context)\n"
+         "  -x, --channels LIST   numbers of transfer channels (default: unchanged)\n"
+         "  -f, --frag LIST       fragment sizes, sets VEO_SENDFRAG / VEO_RECVFRAG\n"
+         "                        (default: unchanged)\n"
+         "  -r, --reps N          repetitions per point (default 11)\n"
+         "  -n, --iters N         transfers per repetition and thread (default:\n"
+         "                        16MB per repetition below 512k, else 1GB)\n"
+         "  -q, --depth N         requests in flight per thread in async mode\n"
+         "                        (default 16)\n"
+         "  -V, --verify          check the data of each size before measuring\n"
+         "  -o, --format FMT      text, csv or json (default text)\n"
+         "  -l, --label STR       label added to each result\n"
+         "  -L, --stacklib PATH   VE library for stack mode (./libvestackargs.so)\n"
+         "\n"
+         "sync: one request in flight per thread, async: --depth requests in\n"
+         "flight per thread, stack: buffer passed as stack argument of a call.\n"
+         "Several contexts need VE_OMP_NUM_THREADS=1.\n", prog);
+}
+
+static long
+parse_size(const char *s)
+{
+  char *end;
+  double v = strtod(s, &end);
+  switch (*end) {
+  case 'k': case 'K': v *= 1024; break;
+  case 'm': case 'M': v *= 1024 * 1024; break;
+  case 'g': case 'G': v *= 1024 * 1024 * 1024; break;
+  case '\0': break;
+  default:
+    fprintf(stderr, "bad size: %s\n", s);
+    exit(1);
+  }
+  return (long)v;
+}
+
+/* comma separated list, elements may be ranges a:b of powers of 2 */
+static void
+parse_list(const char *arg, struct list *l)
+{
+  char *s = strdup(arg), *save = NULL;
+  l->n = 0;
+  for (char *t = strtok_r(s, ",", &save); t; t = strtok_r(NULL, ",", &save)) {
+    char *colon = strchr(t, ':');
+    if (colon) {
+      *colon = '\0';
+      long a = parse_size(t), b = parse_size(colon + 1);
+      for (long v = a; v > 0 && v <= b && l->n < MAX_LIST; v *= 2)
+        l->v[l->n++] = v;
+    } else if (l->n < MAX_LIST) {
+      l->v[l->n++] = parse_size(t);
+    }
+  }
+  free(s);
+}
+
+static void
+parse_names(const char *arg, const char **names, int n, int *sel)
+{
+  char *s = strdup(arg), *save = NULL;
+  memset(sel, 0, n * sizeof(int));
+  for (char *t = strtok_r(s, ",", &save); t; t = strtok_r(NULL, ",", &save)) {
+    int i;
+    for (i = 0; i < n; i++)
+      if (strcmp(t, names[i]) == 0)
+        break;
+    if (i == n) {
+      fprintf(stderr, "unknown value: %s\n", t);
+      exit(1);
+    }
+    sel[i] = 1;
+  }
+  free(s);
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+ * Value below which a fraction q of the n sorted samples v lie,
+ * interpolated between neighbouring samples.
+ */
+static double
+percentile(const double *v, int n, double q)
+{
+  double x = q * (n - 1);
+  int i = (int)x;
+  if (i + 1 >= n)
+    return v[n - 1];
+  return v[i] + (x - i) * (v[i + 1] - v[i]);
+}
+
+static double
+cpu_seconds(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static uint64_t
+submit(struct worker *w, struct veo_args *args)
+{
+  const struct point *p = w->p;
+  if (p->mode == MODE_STACK)
+    return veo_call_async(w->ctx, stack_sym, args);
+  if (p->dir == DIR_SEND)
+    return veo_async_write_mem(w->ctx, w->vebuf, w->buf, p->size);
+  return veo_async_read_mem(w->ctx, w->buf, w->vebuf, p->size);
+}
+
+static void *
+worker_main(void *arg)
+{
+  struct worker *w = (struct worker *)arg;
+  const struct point *p = w->p;
+  int depth = p->mode == MODE_ASYNC ? opt.depth : 1;
+  uint64_t req[MAX_DEPTH], res;
+  struct veo_args *args = NULL;
+
+  if (p->mode == MODE_STACK) {
+    args = veo_args_alloc();
+    veo_args_set_stack(args, p->dir == DIR_SEND ? VEO_INTENT_IN : VEO_INTENT_OUT,
+                       0, w->buf, p->size);
+  }
+  pthread_barrier_wait(w->bar);
+  for (int i = 0; i < p->iters + depth; i++) {
+    // keep depth requests in flight, wait for the oldest one
+    if (i >= depth && veo_call_wait_result(w->ctx, req[i % depth], &res)
+                      != VEO_COMMAND_OK)
+      w->rc = -1;
+    if (i < p->iters) {
+      req[i % depth] = submit(w, args);
+      if (req[i % depth] == VEO_REQUEST_ID_INVALID) {
+        w->rc = -1;
+        break;
+      }
+    }
+  }
+  if (args)
+    veo_args_free(args);
+  return NULL;
+}
+
+static int
+verify(const struct point *p, struct worker *w)
+{
+  size_t n = p->size / sizeof(long);
+  long *b = (long *)w->buf;
+  for (size_t i = 0; i < n; i++)
+    b[i] = (long)(i ^ p->size);
+  if (veo_write_mem(proc, w->vebuf, w->buf, p->size) != 0)
+    return -1;
+  memset(w->buf, 0, p->size);
+  if (veo_read_mem(proc, w->buf, w->vebuf, p->size) != 0)
+    return -1;
+  for (size_t i = 0; i < n; i++)
+    if (b[i] != (long)(i ^ p->size))
+      return -1;
+  return 0;
+}
+
+static void
+print_header(void)
+{
+  if (opt.fmt == FMT_TEXT)
+    printf("%-5s %-4s %10s %3s %3s %3s %9s %7s %10s %10s %10s %9s %s\n",
+           "mode", "dir", "size", "thr", "ctx", "chn", "frag", "iters",
+           "med MB/s", "p99 MB/s", "max MB/s", "cpu s/GB", opt.label ? "label" : "");
+  else if (opt.fmt == FMT_CSV)
+    printf("label,mode,dir,size,threads,contexts,channels,frag,reps,iters,"
+           "median_MBps,p99_MBps,max_MBps,min_MBps,cpu_s_per_GB\n");
+  else {
+    char host[256] = "";
+    time_t now = time(NULL);
+    char date[64];
+    gethostname(host, sizeof(host) - 1);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    printf("{\n  \"veo_version\": \"%s\",\n  \"api_version\": %d,\n"
+           "  \"host\": \"%s\",\n  \"date\": \"%s\",\n  \"results\": [",
+           veo_version_string(), veo_api_version(), host, date);
+  }
+}
+
+static void
+print_footer(void)
+{
+  if (opt.fmt == FMT_JSON)
+    printf("\n  ]\n}\n");
+}
+
+static void
+print_result(const struct point *p, double *bw, double cpu_per_gb)
+{
+  double med = percentile(bw, opt.reps, 0.5);
+  // throughput reached by 99% of the repetitions
+  double p99 = percentile(bw, opt.reps, 0.01);
+  double max = bw[opt.reps - 1], min = bw[0];
+  const char *label = opt.label ? opt.label : "";
+
+  if (opt.fmt == FMT_TEXT)
+    printf("%-5s %-4s %10lu %3d %3d %3d %9ld %7d %10.0f %10.0f %10.0f %9.3f %s\n",
+           mode_name[p->mode], dir_name[p->dir], p->size, p->threads,
+           p->contexts, p->channels, p->frag, p->iters, med, p99, max,
+           cpu_per_gb, label);
+  else if (opt.fmt == FMT_CSV)
+    printf("%s,%s,%s,%lu,%d,%d,%d,%ld,%d,%d,%.1f,%.1f,%.1f,%.1f,%.4f\n",
+           label, mode_name[p->mode], dir_name[p->dir], p->size, p->threads,
+           p->contexts, p->channels, p->frag, opt.reps, p->iters,
+           med, p99, max, min, cpu_per_gb);
+  else
+    printf("%s\n    {\"label\": \"%s\", \"mode\": \"%s\", \"dir\": \"%s\", "
+           "\"size\": %lu, \"threads\": %d, \"contexts\": %d, \"channels\": %d, "
+           "\"frag\": %ld, \"reps\": %d, \"iters\": %d, \"median_MBps\": %.1f, "
+           "\"p99_MBps\": %.1f, \"max_MBps\": %.1f, \"min_MBps\": %.1f, "
+           "\"cpu_s_per_GB\": %.4f}",
+           nresults ? "," : "", label, mode_name[p->mode], dir_name[p->dir],
+           p->size, p->threads, p->contexts, p->channels, p->frag, opt.reps,
+           p->iters, med, p99, max, min, cpu_per_gb);
+  nresults++;
+  fflush(stdout);
+}
+
+/* measure one point: reps repetitions of iters transfers per thread */
+static int
+run_point(struct point *p)
+{
+  struct worker w[MAX_THREADS];
+  pthread_barrier_t bar;
+  double bw[opt.reps];
+  double cpu = 0;
+  int rc = 0, i, r;
+
+  if (p->iters == 0) {
+    size_t vol = p->size < 512 * 1024 ? 16UL << 20 : 1UL << 30;
+    p->iters = vol / p->size > 0 ? vol / p->size : 1;
+  }
+  for (i = 0; i < p->threads; i++) {
+    w[i].ctx = ctxs[i % p->contexts];
+    w[i].p = p;
+    w[i].bar = &bar;
+    w[i].buf = (char *)malloc(p->size);
+    memset(w[i].buf, 65, p->size);
+    w[i].vebuf = 0;
+    if (p->mode != MODE_STACK &&
+        veo_alloc_mem(proc, &w[i].vebuf, p->size) != 0) {
+      fprintf(stderr, "veo_alloc_mem of %lu bytes failed\n", p->size);
+      rc = -1;
+    }
+  }
+  if (rc == 0 && opt.verify && p->mode != MODE_STACK && verify(p, &w[0]) != 0) {
+    fprintf(stderr, "verify failed for size %lu\n", p->size);
+    rc = -1;
+  }
+
+  for (r = 0; r < opt.reps && rc == 0; r++) {
+    pthread_barrier_init(&bar, NULL, p->threads + 1);
+    for (i = 0; i < p->threads; i++) {
+      w[i].rc = 0;
+      pthread_create(&w[i].tid, NULL, worker_main, &w[i]);
+    }
+    double c0 = cpu_seconds();
+    pthread_barrier_wait(&bar);
+    long ts = get_time_us();
+    for (i = 0; i < p->threads; i++) {
+      pthread_join(w[i].tid, NULL);
+      if (w[i].rc)
+        rc = -1;
+    }
+    long te = get_time_us();
+    cpu += cpu_seconds() - c0;
+    pthread_barrier_destroy(&bar);
+    bw[r] = (double)p->size * p->iters * p->threads / (double)(te - ts);
+  }
+  if (rc == 0) {
+    qsort(bw, opt.reps, sizeof(double), cmp_double);
+    print_result(p, bw, cpu / ((double)p->size * p->iters * p->threads *
+                               opt.reps / 1e9));
+  } else {
+    fprintf(stderr, "%s %s of %lu bytes failed\n", mode_name[p->mode],
+            dir_name[p->dir], p->size);
+  }
+
+  for (i = 0; i < p->threads; i++) {
+    if (w[i].vebuf)
+      veo_free_mem(proc, w[i].vebuf);
+    free(w[i].buf);
+  }
+  return rc;
+}
+
+static int
+open_contexts(int n)
+{
+  for (; nctxs < n; nctxs++) {
+    ctxs[nctxs] = veo_context_open(proc);
+    if (ctxs[nctxs] == NULL) {
+      perror("veo_context_open");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const struct option lopts[] = {
+    { "sizes", required_argument, NULL, 's' },
+    { "dir", required_argument, NULL, 'd' },
+    { "mode", required_argument, NULL, 'm' },
+    { "contexts", required_argument, NULL, 'c' },
+    { "threads", required_argument, NULL, 't' },
+    { "channels", required_argument, NULL, 'x' },
+    { "frag", required_argument, NULL, 'f' },
+    { "reps", required_argument, NULL, 'r' },
+    { "iters", required_argument, NULL, 'n' },
+    { "depth", required_argument, NULL, 'q' },
+    { "verify", no_argument, NULL, 'V' },
+    { "format", required_argument, NULL, 'o' },
+    { "label", required_argument, NULL, 'l' },
+    { "stacklib", required_argument, NULL, 'L' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  static const char *fmt_name[] = { "text", "csv", "json" };
+  int fmt_sel[3], c, failed = 0;
+
+  parse_list("1k:1g", &opt.sizes);
+  parse_list("1", &opt.contexts);
+  opt.modes[MODE_SYNC] = opt.modes[MODE_ASYNC] = 1;
+  opt.dirs[DIR_SEND] = opt.dirs[DIR_RECV] = 1;
+  opt.reps = 11;
+  opt.depth = 16;
+  opt.stacklib = "./libvestackargs.so";
+
+  while ((c = getopt_long(argc, argv, "s:d:m:c:t:x:f:r:n:q:Vo:l:L:h",
+                          lopts, NULL)) != -1) {
+    switch (c) {
+    case 's': parse_list(optarg, &opt.sizes); break;
+    case 'd': parse_names(optarg, dir_name, NDIRS, opt.dirs); break;
+    case 'm': parse_names(optarg, mode_name, NMODES, opt.modes); break;
+    case 'c': parse_list(optarg, &opt.contexts); break;
+    case 't': parse_list(optarg, &opt.threads); break;
+    case 'x': parse_list(optarg, &opt.channels); break;
+    case 'f': parse_list(optarg, &opt.frags); break;
+    case 'r': opt.reps = atoi(optarg); break;
+    case 'n': opt.iters = atoi(optarg); break;
+    case 'q': opt.depth = atoi(optarg); break;
+    case 'V': opt.verify = 1; break;
+    case 'o':
+      parse_names(optarg, fmt_name, 3, fmt_sel);
+      opt.fmt = fmt_sel[FMT_JSON] ? FMT_JSON : fmt_sel[FMT_CSV] ? FMT_CSV : FMT_TEXT;
+      break;
+    case 'l': opt.label = optarg; break;
+    case 'L': opt.stacklib = optarg; break;
+    case 'h': usage(argv[0]); return 0;
+    default: usage(argv[0]); return 1;
+    }
+  }
+  if (opt.reps < 1 || opt.depth < 1 || opt.depth > MAX_DEPTH) {
+    fprintf(stderr, "reps must be >= 1, depth 1..%d\n", MAX_DEPTH);
+    return 1;
+  }
+  // without -t one thread per context
+  int threads_per_ctx = opt.threads.n == 0;
+  if (threads_per_ctx)
+    opt.threads.n = 1;
+  if (opt.channels.n == 0) {
+    opt.channels.n = 1;
+    opt.channels.v[0] = 0;
+  }
+  if (opt.frags.n == 0) {
+    opt.frags.n = 1;
+    opt.frags.v[0] = 0;
+  }
+
+  proc = veo_proc_create(-1);
+  if (proc == NULL) {
+    perror("veo_proc_create");
+    return 1;
+  }
+  if (opt.modes[MODE_STACK]) {
+    uint64_t lib = veo_load_library(proc, opt.stacklib);
+    stack_sym = lib ? veo_get_sym(proc, lib, "test_bandwidth") : 0;
+    if (stack_sym == 0) {
+      fprintf(stderr, "test_bandwidth not found in %s, skipping stack mode\n",
+              opt.stacklib);
+      opt.modes[MODE_STACK] = 0;
+    }
+  }
+
+  print_header();
+  for (int ic = 0; ic < opt.contexts.n; ic++)
+  for (int it = 0; it < opt.threads.n; it++)
+  for (int ix = 0; ix < opt.channels.n; ix++)
+  for (int ifr = 0; ifr < opt.frags.n; ifr++)
+  for (int m = 0; m < NMODES; m++)
+  for (int is = 0; is < opt.sizes.n; is++)
+  for (int d = 0; d < NDIRS; d++) {
+    struct point p;
+    if (!opt.modes[m] || !opt.dirs[d])
+      continue;
+    p.mode = (enum mode)m;
+    p.dir = (enum dir)d;
+    p.size = opt.sizes.v[is];
+    p.contexts = opt.contexts.v[ic];
+    p.threads = threads_per_ctx ? p.contexts : opt.threads.v[it];
+    p.frag = opt.frags.v[ifr];
+    p.iters = opt.iters;
+    if (p.contexts < 1 || p.contexts > MAX_THREADS ||
+        p.threads < 1 || p.threads > MAX_THREADS) {
+      fprintf(stderr, "contexts and threads must be 1..%d\n", MAX_THREADS);
+      return 1;
+    }
+    if (open_contexts(p.contexts) != 0)
+      return 1;
+    if (opt.channels.v[ix] > 0 &&
+        veo_set_xfer_channels(proc, opt.channels.v[ix]) < 0)
+      return 1;
+    p.channels = veo_get_xfer_channels(proc);
+    if (p.frag > 0) {
+      char s[32];
+      snprintf(s, sizeof(s), "%ld", p.frag);
+      setenv("VEO_SENDFRAG", s, 1);
+      setenv("VEO_RECVFRAG", s, 1);
+    } else {
+      // 0 is the default, do not keep the sizes of a previous point
+      unsetenv("VEO_SENDFRAG");
+      unsetenv("VEO_RECVFRAG");
+    }
+    if (run_point(&p) != 0)
+      failed++;
+  }
+  print_footer();
+
+  for (int i = nctxs - 1; i >= 0; i--)
+    veo_context_close(ctxs[i]);
+  veo_proc_destroy(proc);
+  return failed ? 2 : 0;
+}